@@ -10,12 +10,15 @@
 
 #include "assert.h"
 #include "trace.h"
+#include "power.h"
 
 /* application specific definitions */
 #define configUSE_PREEMPTION		  1
 #define configUSE_IDLE_HOOK			  0
 #define configUSE_TICK_HOOK			  0
 #define configCPU_CLOCK_HZ			  ((unsigned long)72000000)	
+/* systick is clocked by AHB/8 */
+#define configSYSTICK_CLOCK_HZ		  (configCPU_CLOCK_HZ / 8UL)
 #define configTICK_RATE_HZ			  ((TickType_t)1000)
 #define configMAX_PRIORITIES		  (5)
 #define configMINIMAL_STACK_SIZE	  ((unsigned short)128)
@@ -25,6 +28,20 @@
 #define configUSE_16_BIT_TICKS		  0
 #define configIDLE_SHOULD_YIELD		  1
 #define configUSE_MUTEXES             1
+#define configUSE_COUNTING_SEMAPHORES 1
+
+/* stop tick interrupt and sleep when no task is ready, sleep time is
+   recorded for power statistics, xTickCount is visible in tasks.c */
+#define configUSE_TICKLESS_IDLE       1
+#define traceLOW_POWER_IDLE_BEGIN()   power_sleep_begin(xTickCount)
+#define traceLOW_POWER_IDLE_END()     power_sleep_end(xTickCount)
+
+/* software timer definitions */
+#define configUSE_TIMERS              1
+#define configTIMER_TASK_PRIORITY     (configMAX_PRIORITIES - 1)
+#define configTIMER_QUEUE_LENGTH      (8)
+/* callbacks trace, flash work is deferred to flash task */
+#define configTIMER_TASK_STACK_DEPTH  (configMINIMAL_STACK_SIZE * 2)
 
 
 /* Co-routine definitions. */
@@ -38,10 +55,12 @@ to exclude the API function. */
 #define INCLUDE_uxTaskPriorityGet		        0
 #define INCLUDE_vTaskDelete				        1
 #define INCLUDE_vTaskCleanUpResources	        0
-#define INCLUDE_vTaskSuspend			        0
-#define INCLUDE_vTaskDelayUntil			        0
+#define INCLUDE_vTaskSuspend			        1
+#define INCLUDE_vTaskDelayUntil			        1
 #define INCLUDE_vTaskDelay				        1
 #define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_xTimerPendFunctionCall          1
+#define INCLUDE_xTaskGetSchedulerState          1
 
 /* value can be 0(highest) to 15(lowest)*/
 #define configKERNEL_INTERRUPT_PRIORITY 		(15)
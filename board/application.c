@@ -23,6 +23,11 @@
 #include "license.h"
 #include "modeswitch.h"
 #include "flash.h"
+#include "slot_sensor.h"
+#include "selftest.h"
+#include "watchdog.h"
+#include "crc32.h"
+#include "flash_page.h"
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[init]"
@@ -120,6 +125,22 @@ static bool init_m26()
     return TRUE;
 }
 
+/**
+ * @brief initialize network module selected by mode
+ * @return initialize status
+ */
+static bool init_module(void)
+{
+    if (MODE_NET_WIFI == mode_net())
+    {
+        return init_esp8266();
+    }
+    else
+    {
+        return init_m26();
+    }
+}
+
 /**
  * @brief network initialize task
  * @param pvParameter - task parameter
@@ -133,7 +154,7 @@ static void vInitNetwork(void *pvParameters)
         if (!init_esp8266())
         {
             TRACE("initialize network failed\r\n");
-            led_net_set_action("LED_ERROR", on);
+            led_net_set_code(LED_ID_ERROR, LED_CODE_NETWORK);
         }
     }
     else
@@ -141,7 +162,7 @@ static void vInitNetwork(void *pvParameters)
         if (!init_m26())
         {
             TRACE("initialize network failed\r\n");
-            led_net_set_action("LED_ERROR", on);
+            led_net_set_code(LED_ID_ERROR, LED_CODE_NETWORK);
         }
     }
     
@@ -168,6 +189,7 @@ static void vInitSystem(void *pvParameters)
     led_motor_init();
     led_net_init();
     ir_init();
+    slot_sensor_init();
     motor_init();
     network_init();
     modeswitch_init();
@@ -176,12 +198,17 @@ static void vInitSystem(void *pvParameters)
 }
 
 /**
- * @brief initialize system
+ * @brief self test system, report is published after mqtt connected
  * @param pvParameters - task parameter
  */
 static void vTestSystem(void *pvParameters)
 {
     TRACE("startup test...\r\n");
+    TRACE("version = %s\r\n", VERSION);
+    led_motor_init();
+    led_net_init();
+    motor_test_init();
+    selftest_run(init_module);
 
     vTaskDelete(NULL);
 }
@@ -191,6 +218,10 @@ static void vTestSystem(void *pvParameters)
  */
 void ApplicationStartup()
 {
+    watchdog_init();
+    flash_page_init();
+    crc32_init();
+    flash_init();
     mode_init();
     license_init();
     if (MODE_WORK_NORMAL == mode_work())
@@ -200,8 +231,8 @@ void ApplicationStartup()
     }
     else
     {
-        xTaskCreate(vTestSystem, "Test", INIT_SYSTEM_STACK_SIZE, NULL, 
-                    INIT_SYSTEM_PRIORITY, NULL);
+        xTaskCreate(vTestSystem, "Test", TEST_SYSTEM_STACK_SIZE, NULL, 
+                    TEST_SYSTEM_PRIORITY, NULL);
     }
     
     /* Start the scheduler. */
@@ -12,10 +12,12 @@
 #include "pinconfig.h"
 #include "dbgserial.h"
 #include "trace.h"
+#include "ota_layout.h"
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE   "[board]"
 
+static void vector_init(void);
 static void clock_init(void);
 
 /* init function */
@@ -24,6 +26,7 @@ typedef void (*init_fuc)(void);
 /* init sequence */
 init_fuc init_sequence[] = 
 {
+    vector_init,
     clock_init,
     pin_init,
     dbg_serial_setup,
@@ -45,6 +48,16 @@ void board_init(void)
     return;
 }
 
+/**
+ * @brief use vector table of application, bootloader owns the one at
+ *        start of flash
+ */
+static void vector_init(void)
+{
+    VectTable table = {OTA_APP_ADDR >> 9, CODE};
+    SCB_SetVectTableConfig(table);
+}
+
 /**
  * @brief board clock init
  */
@@ -0,0 +1,221 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "cabinet.h"
+#include "assert.h"
+#include "trace.h"
+#include "pinconfig.h"
+#include "stm32f10x_cfg.h"
+#ifdef CABINET_DRIVER_HC595
+#include "hc595.h"
+#endif
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[cabinet]"
+
+/* slot table */
+#if (CABINET_TYPE == CABINET_10)
+const cabinet_slot cabinet_slots[MOTOR_NUM] = 
+{
+    {0, 0, PIN_CH1_DET}, {0, 1, PIN_CH2_DET}, {0, 2, PIN_CH3_DET}, 
+    {0, 3, PIN_CH4_DET}, {1, 0, PIN_CH5_DET}, {1, 1, PIN_CH6_DET}, 
+    {1, 2, PIN_CH7_DET}, {1, 3, PIN_CH8_DET}, {2, 0, PIN_CH9_DET}, 
+    {2, 1, PIN_CH10_DET},
+};
+#elif (CABINET_TYPE == CABINET_60)
+/* first ten slots have sensors, others are not monitored */
+#define CABINET_ROW(row)  {row, 0, PIN_NONE}, {row, 1, PIN_NONE}, \
+                          {row, 2, PIN_NONE}, {row, 3, PIN_NONE}, \
+                          {row, 4, PIN_NONE}, {row, 5, PIN_NONE}, \
+                          {row, 6, PIN_NONE}, {row, 7, PIN_NONE}
+const cabinet_slot cabinet_slots[MOTOR_NUM] = 
+{
+    {0, 0, PIN_CH1_DET}, {0, 1, PIN_CH2_DET}, {0, 2, PIN_CH3_DET}, 
+    {0, 3, PIN_CH4_DET}, {0, 4, PIN_CH5_DET}, {0, 5, PIN_CH6_DET}, 
+    {0, 6, PIN_CH7_DET}, {0, 7, PIN_CH8_DET}, {1, 0, PIN_CH9_DET}, 
+    {1, 1, PIN_CH10_DET}, {1, 2, PIN_NONE}, {1, 3, PIN_NONE}, 
+    {1, 4, PIN_NONE}, {1, 5, PIN_NONE}, {1, 6, PIN_NONE}, {1, 7, PIN_NONE},
+    CABINET_ROW(2), CABINET_ROW(3), CABINET_ROW(4), CABINET_ROW(5), 
+    CABINET_ROW(6), 
+    {7, 0, PIN_NONE}, {7, 1, PIN_NONE}, {7, 2, PIN_NONE}, 
+    {7, 3, PIN_NONE},
+};
+#endif
+
+#ifdef CABINET_DRIVER_GPIO
+static const pin_id cabinet_rows[MOTOR_ROWS] = {PIN_CON_L1, PIN_CON_L2,
+                                                PIN_CON_L3, PIN_CON_L4};
+static const pin_id cabinet_cols[MOTOR_COLS] = {PIN_CON_R1, PIN_CON_R2,
+                                                PIN_CON_R3, PIN_CON_R4};
+/* resolved row and column pins */
+static pin_handle cabinet_row_pins[MOTOR_ROWS];
+static pin_handle cabinet_col_pins[MOTOR_COLS];
+#endif
+
+#ifdef CABINET_ROW_PWM
+/* 20kHz pwm on TIM3 full remap pins */
+#define CABINET_PWM_TIMER     TIM3
+#define CABINET_PWM_PERIOD    (3600)
+static const uint8_t cabinet_row_channels[MOTOR_ROWS] = 
+{
+    TIM_CHANNEL4, TIM_CHANNEL3, TIM_CHANNEL2, TIM_CHANNEL1
+};
+static uint8_t cabinet_level = CABINET_LEVEL_FULL;
+static uint16_t cabinet_rows_on = 0;
+
+/**
+ * @brief get compare value of current row level
+ * @return compare value
+ */
+static __INLINE uint16_t cabinet_duty(void)
+{
+    return (CABINET_PWM_PERIOD / CABINET_LEVEL_FULL) * cabinet_level;
+}
+
+/**
+ * @brief initialize row pwm timer
+ */
+static void cabinet_pwm_init(void)
+{
+    RCC_APB1PeriphReset(RCC_APB1_RESET_TIM3, TRUE);
+    RCC_APB1PeriphReset(RCC_APB1_RESET_TIM3, FALSE);
+    RCC_APB1PeripClockEnable(RCC_APB1_ENABLE_TIM3, TRUE);
+    /* swj bits read as zero, write them again or jtag pins come back */
+    GPIO_PinRemap(SWJ_JTAG_DISABLE | TIM3_FULL_REMAP, TRUE);
+
+    TIM_SetCounterMode(CABINET_PWM_TIMER, TIM_COUNTER_UP);
+    TIM_SetPrescaler(CABINET_PWM_TIMER, 0);
+    TIM_SetAutoReload(CABINET_PWM_TIMER, CABINET_PWM_PERIOD - 1);
+    TIM_EnableAutoReloadPreload(CABINET_PWM_TIMER, TRUE);
+    for (int i = 0; i < MOTOR_ROWS; ++i)
+    {
+        TIM_SetOutputCompareMode(CABINET_PWM_TIMER, cabinet_row_channels[i],
+                                 TIM_OC_PWM1, TRUE);
+        TIM_SetCompare(CABINET_PWM_TIMER, cabinet_row_channels[i], 0);
+        TIM_EnableChannel(CABINET_PWM_TIMER, cabinet_row_channels[i], TRUE);
+    }
+    TIM_GenerateUpdate(CABINET_PWM_TIMER);
+    TIM_Enable(CABINET_PWM_TIMER, TRUE);
+}
+#endif
+
+#ifdef CABINET_DRIVER_HC595
+static hc595_chain driver_chain;
+static uint32_t driver_status[(CABINET_DRIVER_BITS + 31) >> 5];
+
+/**
+ * @brief set driver output
+ * @param bit - output bit of driver chain
+ * @param on - output status
+ */
+static void cabinet_output(uint8_t bit, bool on)
+{
+    if (on)
+    {
+        driver_status[bit >> 5] |= (1ul << (bit & 0x1f));
+    }
+    else
+    {
+        driver_status[bit >> 5] &= ~(1ul << (bit & 0x1f));
+    }
+    hc595_write(&driver_chain, driver_status, CABINET_DRIVER_BITS);
+}
+#endif
+
+/**
+ * @brief initialize motor driver outputs
+ */
+void cabinet_init(void)
+{
+    TRACE("initialize cabinet: %d slots, %d x %d matrix\r\n", MOTOR_NUM,
+          MOTOR_ROWS, MOTOR_COLS);
+#ifdef CABINET_DRIVER_GPIO
+#ifdef CABINET_ROW_PWM
+    cabinet_pwm_init();
+#endif
+    for (int i = 0; i < MOTOR_ROWS; ++i)
+    {
+        pin_resolve(cabinet_rows[i], &cabinet_row_pins[i]);
+        cabinet_row(i, TRUE);
+    }
+    for (int i = 0; i < MOTOR_COLS; ++i)
+    {
+        pin_resolve(cabinet_cols[i], &cabinet_col_pins[i]);
+        cabinet_col(i, TRUE);
+    }
+#elif defined(CABINET_DRIVER_SPI)
+    hc595_init_spi(&driver_chain, CABINET_DRIVER_SPI, PIN_DRV_ST, FALSE);
+    hc595_write(&driver_chain, driver_status, CABINET_DRIVER_BITS);
+#else
+    hc595_init(&driver_chain, PIN_DRV_DATA, PIN_DRV_ST, PIN_DRV_SH, FALSE);
+    hc595_write(&driver_chain, driver_status, CABINET_DRIVER_BITS);
+#endif
+}
+
+/**
+ * @brief switch row line of motor matrix
+ * @param row - row line
+ * @param on - line status
+ */
+void cabinet_row(uint8_t row, bool on)
+{
+    assert_param(row < MOTOR_ROWS);
+#ifdef CABINET_ROW_PWM
+    if (on)
+    {
+        cabinet_rows_on |= (1 << row);
+    }
+    else
+    {
+        cabinet_rows_on &= ~(1 << row);
+    }
+    TIM_SetCompare(CABINET_PWM_TIMER, cabinet_row_channels[row], 
+                   on ? cabinet_duty() : 0);
+#elif defined(CABINET_DRIVER_GPIO)
+    pin_handle_write(&cabinet_row_pins[row], on);
+#else
+    cabinet_output(row, on);
+#endif
+}
+
+/**
+ * @brief switch column line of motor matrix
+ * @param col - column line
+ * @param on - line status
+ */
+void cabinet_col(uint8_t col, bool on)
+{
+    assert_param(col < MOTOR_COLS);
+#ifdef CABINET_DRIVER_GPIO
+    pin_handle_write(&cabinet_col_pins[col], on);
+#else
+    cabinet_output(MOTOR_ROWS + col, on);
+#endif
+}
+
+/**
+ * @brief set level of row lines, motors are driven by pwm on row lines
+ * @param level - row level(percent)
+ */
+void cabinet_row_level(uint8_t level)
+{
+    assert_param(level <= CABINET_LEVEL_FULL);
+#ifdef CABINET_ROW_PWM
+    cabinet_level = level;
+    for (int i = 0; i < MOTOR_ROWS; ++i)
+    {
+        if (0 != (cabinet_rows_on & (1 << i)))
+        {
+            TIM_SetCompare(CABINET_PWM_TIMER, cabinet_row_channels[i], 
+                           cabinet_duty());
+        }
+    }
+#else
+    UNUSED(level);
+#endif
+}
+
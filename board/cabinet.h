@@ -0,0 +1,117 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _CABINET_H_
+  #define _CABINET_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* supported cabinets */
+#define CABINET_10       (0)
+#define CABINET_60       (1)
+
+#ifndef CABINET_TYPE
+  #define CABINET_TYPE   CABINET_10
+#endif
+
+/* motors are driven by a row line and a column line */
+#if (CABINET_TYPE == CABINET_10)
+  #define MOTOR_ROWS           (4)
+  #define MOTOR_COLS           (4)
+  #define MOTOR_NUM            (10)
+  /* row and column lines connect to gpio directly */
+  #define CABINET_DRIVER_GPIO
+  /* row lines are TIM3 remapped pwm outputs, motors start and stop softly */
+  //#define CABINET_ROW_PWM
+  /* bits of motor led shift register chain */
+  #define CABINET_LED_BITS     (16)
+#elif (CABINET_TYPE == CABINET_60)
+  #define MOTOR_ROWS           (8)
+  #define MOTOR_COLS           (8)
+  #define MOTOR_NUM            (60)
+  /* row and column lines connect to 74hc595 chain, rows first */
+  #define CABINET_DRIVER_HC595
+  #define CABINET_DRIVER_BITS  (16)
+  /* driver chain shift clock and serial data are SPI2 SCK and MOSI, comment
+     out to bit-bang them */
+  #define CABINET_DRIVER_SPI   SPI2
+  #define CABINET_LED_BITS     (64)
+#else
+  #error "unknown cabinet type"
+#endif
+
+#if ((MOTOR_ROWS > 16) || (MOTOR_COLS > 16))
+  #error "motor rows or columns exceed 16"
+#endif
+#if (MOTOR_NUM > MOTOR_ROWS * MOTOR_COLS)
+  #error "motor number exceeds matrix size"
+#endif
+#if defined(CABINET_ROW_PWM) && !defined(CABINET_DRIVER_GPIO)
+  #error "row pwm needs row lines on gpio"
+#endif
+#if (MOTOR_NUM > CABINET_LED_BITS)
+  #error "motor led chain is too short"
+#endif
+
+/* row line level(percent) */
+#define CABINET_LEVEL_FULL    (100)
+
+/* words of slot bitmap */
+#define SLOT_WORDS    ((MOTOR_NUM + 31) >> 5)
+
+/* slot position in motor matrix */
+typedef struct
+{
+    uint8_t row;
+    uint8_t col;
+    /* slot detect pin id, PIN_NONE if slot has no sensor */
+    uint8_t det;
+}cabinet_slot;
+
+extern const cabinet_slot cabinet_slots[MOTOR_NUM];
+
+void cabinet_init(void);
+void cabinet_row(uint8_t row, bool on);
+void cabinet_col(uint8_t col, bool on);
+void cabinet_row_level(uint8_t level);
+
+/**
+ * @brief check slot bit in bitmap
+ * @param map - slot bitmap
+ * @param num - slot number
+ * @return TRUE if bit is set
+ */
+static __INLINE bool slot_test(const uint32_t *map, uint8_t num)
+{
+    return (0 != (map[num >> 5] & (1ul << (num & 0x1f))));
+}
+
+/**
+ * @brief set slot bit in bitmap
+ * @param map - slot bitmap
+ * @param num - slot number
+ */
+static __INLINE void slot_set(uint32_t *map, uint8_t num)
+{
+    map[num >> 5] |= (1ul << (num & 0x1f));
+}
+
+/**
+ * @brief clear slot bit in bitmap
+ * @param map - slot bitmap
+ * @param num - slot number
+ */
+static __INLINE void slot_clear(uint32_t *map, uint8_t num)
+{
+    map[num >> 5] &= ~(1ul << (num & 0x1f));
+}
+
+END_DECLS
+
+#endif /* _CABINET_H_ */
@@ -0,0 +1,329 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <string.h>
+#include "crc32.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "assert.h"
+#include "cm3_core.h"
+#include "global.h"
+#include "stm32f10x_cfg.h"
+#include "ota_layout.h"
+
+/* crc unit computes crc-32/mpeg-2 of words, msb first. crc32_calc feeds
+   bit reversed little endian words and reverses result, which gives the
+   common crc-32 of bytes(zip, ethernet). crc32_words is the raw crc of
+   words, used by flash records and update images. crc32_words_update
+   gives the same crc word by word by software, for words that are built
+   on the fly */
+
+/* no peripheral request of dma1 channel 2 is enabled, it is used as
+   memory to crc transfer */
+#define CRC32_DMA_CHANNEL    DMA1_Channel2
+#define CRC32_DMA_IRQ        DMAChannel2_IRQChannel
+/* blocks of this many words or more are fed by dma */
+#define CRC32_DMA_MIN        (256)
+#define CRC32_DMA_MAX        (0xffff)
+#define CRC32_DMA_WAIT       (100 / portTICK_PERIOD_MS)
+
+/* benchmark runs every path over start of application */
+#define CRC32_BENCH_ROUNDS   (8)
+#define CRC32_BENCH_SIZE     (16 * 1024)
+
+/* reflected polynomial 0xedb88320, one entry per nibble */
+static const uint32_t crc32_table[16] =
+{
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+/* polynomial 0x04c11db7 of crc unit, one entry per nibble */
+static const uint32_t crc32_table_words[16] =
+{
+    0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9,
+    0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005,
+    0x2608edb8, 0x22c9f00f, 0x2f8ad6d6, 0x2b4bcb61,
+    0x350c9b64, 0x31cd86d3, 0x3c8ea00a, 0x384fbdbd,
+};
+
+static xSemaphoreHandle xCrcMutex = NULL;
+static xSemaphoreHandle xCrcDone = NULL;
+
+/**
+ * @brief lock crc unit, records are checked before scheduler starts
+ */
+static __INLINE void crc32_lock(void)
+{
+    if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+    {
+        xSemaphoreTake(xCrcMutex, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief unlock crc unit
+ */
+static __INLINE void crc32_unlock(void)
+{
+    if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+    {
+        xSemaphoreGive(xCrcMutex);
+    }
+}
+
+/**
+ * dma transfer complete handler
+ */
+void DMAChannel2_IRQHandler(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    DMA_ClrFlag(CRC32_DMA_CHANNEL, DMA_FLAG_GL);
+    xSemaphoreGiveFromISR(xCrcDone, &xHigherPriorityTaskWoken);
+    /* check if there is any higher priority task need to wakeup */
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief update reflected crc by software
+ * @param crc - crc register
+ * @param data - data
+ * @param len - data length
+ * @return crc register
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+    while (len--)
+    {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0f];
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0f];
+    }
+
+    return crc;
+}
+
+/**
+ * @brief feed words to crc unit by cpu, should be called with lock held
+ * @param words - words
+ * @param count - word count
+ * @return crc
+ */
+static uint32_t crc32_words_cpu(const uint32_t *words, uint32_t count)
+{
+    CRC_ResetDR();
+    return CRC_CalBlock((uint32_t *)words, count);
+}
+
+/**
+ * @brief feed words to crc unit by dma, task sleeps until transfer is
+ *        done. should be called with lock held
+ * @param words - words
+ * @param count - word count
+ * @return crc
+ */
+static uint32_t crc32_words_dma(const uint32_t *words, uint32_t count)
+{
+    uint16_t block = 0;
+
+    CRC_ResetDR();
+    while (count > 0)
+    {
+        block = MIN(count, CRC32_DMA_MAX);
+        DMA_Enable(CRC32_DMA_CHANNEL, FALSE);
+        DMA_ClrFlag(CRC32_DMA_CHANNEL, DMA_FLAG_GL);
+        DMA_SetAddress(CRC32_DMA_CHANNEL, CRC_DataAddress(),
+                       (uint32_t)words);
+        DMA_SetCount(CRC32_DMA_CHANNEL, block);
+        /* drop completion of timed out transfer */
+        xSemaphoreTake(xCrcDone, 0);
+        DMA_Enable(CRC32_DMA_CHANNEL, TRUE);
+        if (pdTRUE != xSemaphoreTake(xCrcDone, CRC32_DMA_WAIT))
+        {
+            /* never expected, finish block by cpu */
+            block -= DMA_GetCount(CRC32_DMA_CHANNEL);
+            DMA_Enable(CRC32_DMA_CHANNEL, FALSE);
+            CRC_CalBlock((uint32_t *)words + block, count - block);
+            break;
+        }
+        words += block;
+        count -= block;
+    }
+    DMA_Enable(CRC32_DMA_CHANNEL, FALSE);
+
+    return CRC_GetDR();
+}
+
+/**
+ * @brief get time of benchmark path
+ * @param start - path start tick
+ * @return us per KB
+ */
+static uint16_t crc32_bench_time(TickType_t start)
+{
+    return (uint16_t)((xTaskGetTickCount() - start) * portTICK_PERIOD_MS *
+                      1000 / (CRC32_BENCH_ROUNDS * (CRC32_BENCH_SIZE >> 10)));
+}
+
+/**
+ * @brief initialize crc unit and its dma channel, should be called before
+ *        scheduler starts
+ */
+void crc32_init(void)
+{
+    DMA_Config dmaConfig;
+
+    xCrcMutex = xSemaphoreCreateMutex();
+    xCrcDone = xSemaphoreCreateBinary();
+    assert_param((NULL != xCrcMutex) && (NULL != xCrcDone));
+
+    RCC_AHBPeripClockEnable(RCC_AHB_ENABLE_DMA1, TRUE);
+    DMA_Enable(CRC32_DMA_CHANNEL, FALSE);
+    DMA_StructInit(&dmaConfig);
+    dmaConfig.periphSize = DMA_SIZE_32BITS;
+    dmaConfig.memorySize = DMA_SIZE_32BITS;
+    dmaConfig.mem2mem = TRUE;
+    DMA_Setup(CRC32_DMA_CHANNEL, &dmaConfig);
+    DMA_EnableInt(CRC32_DMA_CHANNEL, DMA_IT_TC, TRUE);
+
+    NVIC_Config nvicConfig = {CRC32_DMA_IRQ, CRC_DMA_PRIORITY, 0, TRUE};
+    NVIC_Init(&nvicConfig);
+}
+
+/**
+ * @brief calculate crc-32 of bytes by hardware, tail bytes are done by
+ *        software
+ * @param data - data, any alignment
+ * @param len - data length
+ * @return crc
+ */
+uint32_t crc32_calc(const void *data, uint32_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t word = 0;
+    uint32_t crc = 0;
+    assert_param((NULL != data) || (0 == len));
+
+    crc32_lock();
+    CRC_ResetDR();
+    for (; len >= 4; len -= 4, bytes += 4)
+    {
+        memcpy(&word, bytes, 4);
+        CRC_Cal(__RBIT(word));
+    }
+    crc = __RBIT(CRC_GetDR());
+    crc32_unlock();
+
+    return crc32_update(crc, bytes, len) ^ 0xffffffff;
+}
+
+/**
+ * @brief calculate crc-32 of bytes by software
+ * @param data - data
+ * @param len - data length
+ * @return crc
+ */
+uint32_t crc32_soft(const void *data, uint32_t len)
+{
+    assert_param((NULL != data) || (0 == len));
+    return crc32_update(0xffffffff, (const uint8_t *)data, len) ^ 0xffffffff;
+}
+
+/**
+ * @brief calculate hardware crc of words, large block is fed by dma after
+ *        scheduler starts
+ * @param words - words
+ * @param count - word count
+ * @return crc
+ */
+uint32_t crc32_words(const uint32_t *words, uint32_t count)
+{
+    uint32_t crc = 0;
+    assert_param((NULL != words) || (0 == count));
+
+    crc32_lock();
+    if ((count >= CRC32_DMA_MIN) &&
+        (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState()))
+    {
+        crc = crc32_words_dma(words, count);
+    }
+    else
+    {
+        crc = crc32_words_cpu(words, count);
+    }
+    crc32_unlock();
+
+    return crc;
+}
+
+/**
+ * @brief update raw crc of words by software, crc starts from 0xffffffff
+ *        like crc unit after reset
+ * @param crc - crc of previous words
+ * @param word - next word
+ * @return crc
+ */
+uint32_t crc32_words_update(uint32_t crc, uint32_t word)
+{
+    crc ^= word;
+    for (int i = 0; i < 8; ++i)
+    {
+        crc = (crc << 4) ^ crc32_table_words[crc >> 28];
+    }
+
+    return crc;
+}
+
+/**
+ * @brief compare every path over start of application
+ * @param result - time of every path
+ */
+void crc32_bench(crc32_bench_result *result)
+{
+    const uint32_t *image = (const uint32_t *)OTA_APP_ADDR;
+    uint32_t soft = 0;
+    uint32_t bytes = 0;
+    uint32_t words = 0;
+    uint32_t dma = 0;
+    TickType_t start = 0;
+    assert_param(NULL != result);
+
+    start = xTaskGetTickCount();
+    for (int i = 0; i < CRC32_BENCH_ROUNDS; ++i)
+    {
+        soft = crc32_soft(image, CRC32_BENCH_SIZE);
+    }
+    result->soft = crc32_bench_time(start);
+
+    start = xTaskGetTickCount();
+    for (int i = 0; i < CRC32_BENCH_ROUNDS; ++i)
+    {
+        bytes = crc32_calc(image, CRC32_BENCH_SIZE);
+    }
+    result->bytes = crc32_bench_time(start);
+
+    crc32_lock();
+    start = xTaskGetTickCount();
+    for (int i = 0; i < CRC32_BENCH_ROUNDS; ++i)
+    {
+        words = crc32_words_cpu(image, CRC32_BENCH_SIZE >> 2);
+    }
+    result->words = crc32_bench_time(start);
+
+    start = xTaskGetTickCount();
+    for (int i = 0; i < CRC32_BENCH_ROUNDS; ++i)
+    {
+        dma = crc32_words_dma(image, CRC32_BENCH_SIZE >> 2);
+    }
+    result->dma = crc32_bench_time(start);
+    crc32_unlock();
+
+    result->match = (soft == bytes) && (words == dma);
+}
@@ -0,0 +1,35 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _CRC32_H_
+  #define _CRC32_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* time of every path(us per KB), hardware results are checked against
+   software result */
+typedef struct
+{
+    uint16_t soft;
+    uint16_t bytes;
+    uint16_t words;
+    uint16_t dma;
+    bool match;
+}crc32_bench_result;
+
+void crc32_init(void);
+uint32_t crc32_calc(const void *data, uint32_t len);
+uint32_t crc32_soft(const void *data, uint32_t len);
+uint32_t crc32_words(const uint32_t *words, uint32_t count);
+uint32_t crc32_words_update(uint32_t crc, uint32_t word);
+void crc32_bench(crc32_bench_result *result);
+
+END_DECLS
+
+#endif /* _CRC32_H_ */
@@ -13,6 +13,7 @@
 #include "esp8266.h"
 #include "serial.h"
 #include "global.h"
+#include "watchdog.h"
 #include "trace.h"
 #include "pinconfig.h"
 #include "dbgserial.h"
@@ -26,6 +27,9 @@
 static esp8266_driver g_driver;
 
 static TaskHandle_t task_esp8266 = NULL;
+/* parser is idle at most this time between lines */
+#define RESPONSE_WDG_DEADLINE  (10000 / portTICK_PERIOD_MS)
+static uint8_t esp8266_wdg = WATCHDOG_NONE;
 
 /* esp8266 work in block mode */
 static struct
@@ -394,9 +398,11 @@ static void vESP8266Response(void *pvParameters)
     uint16_t tcp_size = 0;
     char data;
     TickType_t xDelay = 50 / portTICK_PERIOD_MS;
+    esp8266_wdg = watchdog_register("ESP8266Response", RESPONSE_WDG_DEADLINE);
     for (;;)
     {
-        if (serial_getchar(pserial, &data, portMAX_DELAY))
+        watchdog_checkin(esp8266_wdg);
+        if (serial_getchar(pserial, &data, WATCHDOG_CHECKIN_TIME))
         {
             g_curmode = mode_at;
             link_id = 0;
@@ -469,10 +475,10 @@ static void vESP8266Response(void *pvParameters)
 bool esp8266_init(void)
 {
     TRACE("initialize esp8266...\r\n");
-    pin_set("WIFI_RST");
-    pin_reset("WIFI_EN");
+    pin_set(PIN_WIFI_RST);
+    pin_reset(PIN_WIFI_EN);
     vTaskDelay(100 / portTICK_PERIOD_MS);
-    pin_set("WIFI_EN");
+    pin_set(PIN_WIFI_EN);
     vTaskDelay(2000 / portTICK_PERIOD_MS);
     
     g_serial = serial_request(COM2);
@@ -836,6 +842,7 @@ void esp8266_shutdown(void)
 {
     if (NULL != task_esp8266)
     {
+        watchdog_unregister(esp8266_wdg);
         vTaskDelete(task_esp8266);
         task_esp8266 = NULL;
     }
@@ -9,56 +9,524 @@
 #include "flash.h"
 #include "assert.h"
 #include "trace.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+#include "timers.h"
+#include "global.h"
 #include "stm32f10x_cfg.h"
+#include "kvstore.h"
+#include "flash_page.h"
+#include "journal.h"
 
-/* 0x800F400, 1K */
+/* configure of old layout, 0x800F400, 1K. it is moved to key value store
+   at first start of new firmware, then migrated marker is stored and page
+   is erased and taken by journal */
 #define FLASH_ADDR   0x800F400
 #define SSID_OFFSET   8
 #define PWD_OFFSET    40
+#define MODE_OFFSET   72
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[flash]"
 
+/* old configure layout */
+typedef struct
+{
+    char init[SSID_OFFSET];
+    char ssid[PWD_OFFSET - SSID_OFFSET];
+    char pwd[MODE_OFFSET - PWD_OFFSET];
+    /* MODE_MAGIC if mode is saved */
+    uint16_t mode_magic;
+    uint16_t reserved;
+    mode_config mode;
+}flash_config;
+#define MODE_MAGIC    (0x4d4f)
+
+/* configure keys, ssid and password are one value so they are updated
+   together */
+#define FLASH_KEY_AP      (1)
+#define FLASH_KEY_MODE    (2)
+/* old configure page is released, value is not used */
+#define FLASH_KEY_MIGRATED  (3)
+
+#define FLASH_SSID_LEN    (PWD_OFFSET - SSID_OFFSET)
+#define FLASH_PWD_LEN     (MODE_OFFSET - PWD_OFFSET)
+
+/* configure is cached in ram and served from there. changes are
+   committed together when no more change comes for FLASH_COMMIT_DELAY, so
+   a burst of settings costs one write */
+#define FLASH_COMMIT_DELAY  (2000 / portTICK_PERIOD_MS)
+#define FLASH_DIRTY_AP      (0x01)
+#define FLASH_DIRTY_MODE    (0x02)
+/* failed commit is tried again after commit delay, then changes are kept
+   in ram until next change or sync */
+#define FLASH_COMMIT_RETRY  (3)
+
+/* flash work is queued by timer callbacks, they must not block */
+#define FLASH_WORK_NUM      (4)
+
+typedef struct
+{
+    flash_work work;
+    uint32_t arg;
+}flash_job;
+
+typedef struct
+{
+    char ssid[FLASH_SSID_LEN];
+    char pwd[FLASH_PWD_LEN];
+    mode_config mode;
+    bool ap_saved;
+    bool mode_saved;
+}flash_cache;
+
+static flash_cache flash_ram;
+static uint8_t flash_dirty = 0;
+static uint16_t flash_changes = 0;
+static uint16_t flash_commits = 0;
+static uint8_t flash_retries = 0;
+/* ap value, ssid and terminator, then password without terminator */
+static char flash_ap[FLASH_SSID_LEN + FLASH_PWD_LEN];
+static xSemaphoreHandle xFlashMutex = NULL;
+static TimerHandle_t xFlashCommit = NULL;
+static xQueueHandle xFlashWork = NULL;
+
+/**
+ * @brief lock configure cache, configure is loaded before scheduler starts
+ */
+static __INLINE void flash_lock(void)
+{
+    if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+    {
+        xSemaphoreTake(xFlashMutex, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief unlock configure cache
+ */
+static __INLINE void flash_unlock(void)
+{
+    if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+    {
+        xSemaphoreGive(xFlashMutex);
+    }
+}
+
+/**
+ * @brief set ap of cache
+ * @param ssid - ap ssid
+ * @param pwd - ap password
+ */
+static void flash_cache_ap(const char *ssid, const char *pwd)
+{
+    assert_param(strlen(ssid) < FLASH_SSID_LEN);
+    assert_param(strlen(pwd) < FLASH_PWD_LEN);
+    strcpy(flash_ram.ssid, ssid);
+    strcpy(flash_ram.pwd, pwd);
+    flash_ram.ap_saved = TRUE;
+}
+
+/**
+ * @brief write dirty configure to store, should be called with lock held.
+ *        configure which is not stored stays dirty
+ * @return TRUE if anything is written
+ */
+static bool flash_commit(void)
+{
+    uint8_t ssid_len = 0;
+    uint8_t pwd_len = 0;
+    uint8_t written = 0;
+    bool ret = FALSE;
+
+    if (0 != (flash_dirty & FLASH_DIRTY_AP))
+    {
+        if (flash_ram.ap_saved)
+        {
+            ssid_len = strlen(flash_ram.ssid);
+            pwd_len = strlen(flash_ram.pwd);
+            memcpy(flash_ap, flash_ram.ssid, ssid_len + 1);
+            memcpy(flash_ap + ssid_len + 1, flash_ram.pwd, pwd_len);
+            ret = kv_set(FLASH_KEY_AP, flash_ap, ssid_len + 1 + pwd_len);
+        }
+        else
+        {
+            ret = kv_delete(FLASH_KEY_AP);
+        }
+
+        if (ret)
+        {
+            written |= FLASH_DIRTY_AP;
+        }
+    }
+
+    if ((0 != (flash_dirty & FLASH_DIRTY_MODE)) &&
+        kv_set(FLASH_KEY_MODE, &flash_ram.mode, sizeof(mode_config)))
+    {
+        written |= FLASH_DIRTY_MODE;
+    }
+
+    if (0 == written)
+    {
+        return FALSE;
+    }
+
+    flash_dirty &= ~written;
+    flash_commits ++;
+    return TRUE;
+}
+
+/**
+ * @brief show endurance use after commit
+ */
+static void flash_show_commit(void)
+{
+    flash_stat stat;
+    flash_get_stat(&stat);
+    TRACE("%d changes in %d commits, %d/%d bytes used, pages erased %d "
+          "times\r\n", stat.changes, stat.commits, stat.used, stat.size,
+          stat.erases);
+}
+
+/**
+ * @brief commit changes in flash task, failed commit is tried again
+ * @param arg - unused
+ */
+static void flash_commit_work(uint32_t arg)
+{
+    bool committed = FALSE;
+    bool retry = FALSE;
+
+    flash_lock();
+    committed = flash_commit();
+    if (0 == flash_dirty)
+    {
+        flash_retries = 0;
+    }
+    else if (flash_retries < FLASH_COMMIT_RETRY)
+    {
+        flash_retries ++;
+        retry = TRUE;
+        xTimerReset(xFlashCommit, 0);
+    }
+    flash_unlock();
+
+    if (committed)
+    {
+        flash_show_commit();
+    }
+
+    if (0 != flash_dirty)
+    {
+        TRACE("commit failed, %s\r\n", retry ? "retry" : "keep in ram");
+    }
+}
+
+/**
+ * @brief commit timer, no change came for commit delay. it runs in timer
+ *        task, commit is written by flash task
+ * @param xTimer - timer handle
+ */
+static void vFlashCommit(TimerHandle_t xTimer)
+{
+    /* work queue is full, try again after commit delay */
+    if (!flash_defer(flash_commit_work, 0))
+    {
+        xTimerReset(xTimer, 0);
+    }
+}
+
+/**
+ * @brief run queued flash work
+ * @param pvParameters - task parameter
+ */
+static void vFlashWork(void *pvParameters)
+{
+    flash_job job;
+
+    for (;;)
+    {
+        if (xQueueReceive(xFlashWork, &job, portMAX_DELAY))
+        {
+            job.work(job.arg);
+        }
+    }
+}
+
+/**
+ * @brief mark configure changed and restart commit delay, should be
+ *        called with lock held
+ * @param dirty - changed configure
+ */
+static void flash_changed(uint8_t dirty)
+{
+    flash_dirty |= dirty;
+    flash_changes ++;
+    flash_retries = 0;
+    xTimerReset(xFlashCommit, 0);
+}
+
+/**
+ * @brief store migrated marker, old configure page may be taken by 
+ *        journal after it is stored
+ * @return TRUE if marker is stored
+ */
+static bool flash_mark_migrated(void)
+{
+    uint8_t done = 1;
+    return kv_set(FLASH_KEY_MIGRATED, &done, sizeof(done));
+}
+
+/**
+ * @brief move configure of old layout to key value store, runs before
+ *        scheduler starts so nothing is traced
+ */
+static void flash_migrate(void)
+{
+    const flash_config *config = (const flash_config *)FLASH_ADDR;
+    bool used = FALSE;
+
+    if (kv_exists(FLASH_KEY_MIGRATED))
+    {
+        return ;
+    }
+
+    /* configure in store is newer, journal records are not configure */
+    if (!flash_ram.ap_saved && !flash_ram.mode_saved && 
+        !journal_owns(FLASH_ADDR))
+    {
+        if (0 == strncmp(config->init, "INIT", 4))
+        {
+            flash_cache_ap(config->ssid, config->pwd);
+            flash_dirty |= FLASH_DIRTY_AP;
+            used = TRUE;
+        }
+
+        if (MODE_MAGIC == config->mode_magic)
+        {
+            flash_ram.mode = config->mode;
+            flash_ram.mode_saved = TRUE;
+            flash_dirty |= FLASH_DIRTY_MODE;
+            used = TRUE;
+        }
+
+        /* old page is kept if store failed, it is tried again at next 
+           start */
+        if (used && (!flash_commit() || (0 != flash_dirty)))
+        {
+            return ;
+        }
+    }
+
+    /* page is released only when marker is stored */
+    if (flash_mark_migrated() && !journal_owns(FLASH_ADDR))
+    {
+        flash_page_erase(FLASH_ADDR);
+    }
+}
+
+/**
+ * @brief load configure from store
+ */
+static void flash_load(void)
+{
+    uint8_t len = kv_get(FLASH_KEY_AP, flash_ap, sizeof(flash_ap));
+    const char *end = memchr(flash_ap, 0x00, len);
+
+    memset(&flash_ram, 0, sizeof(flash_ram));
+    if (NULL != end)
+    {
+        strcpy(flash_ram.ssid, flash_ap);
+        len = MIN(len - (end + 1 - flash_ap), FLASH_PWD_LEN - 1);
+        memcpy(flash_ram.pwd, end + 1, len);
+        flash_ram.ap_saved = TRUE;
+    }
+
+    flash_ram.mode_saved = (sizeof(mode_config) ==
+                            kv_get(FLASH_KEY_MODE, &flash_ram.mode,
+                                   sizeof(mode_config)));
+}
+
+/**
+ * @brief initialize configure store and load configure, should be called
+ *        before scheduler starts
+ */
+void flash_init(void)
+{
+    xFlashMutex = xSemaphoreCreateMutex();
+    xFlashCommit = xTimerCreate("flash", FLASH_COMMIT_DELAY, pdFALSE, NULL,
+                                vFlashCommit);
+    xFlashWork = xQueueCreate(FLASH_WORK_NUM, sizeof(flash_job));
+    assert_param((NULL != xFlashMutex) && (NULL != xFlashCommit) &&
+                 (NULL != xFlashWork));
+    xTaskCreate(vFlashWork, "FlashWork", FLASH_WORK_STACK_SIZE, NULL,
+                FLASH_WORK_PRIORITY, NULL);
+
+    kv_init();
+    flash_load();
+    flash_migrate();
+}
+
+/**
+ * @brief check if old configure page is released, journal may take it
+ * @return TRUE if configure is migrated
+ */
+bool flash_migrated(void)
+{
+    return kv_exists(FLASH_KEY_MIGRATED);
+}
+
 /**
  * @brief check system init status
  */
 bool flash_first_start(void)
 {
-    uint8_t buf[8];
-    FLASH_Read(FLASH_ADDR, buf, 8);
-    return (0 != strncmp((const char *)buf, "INIT", 4));
+    return !flash_ram.ap_saved;
 }
 
 /**
  * @brief get ssid and password
- * @param ssid - ap ssid
- * @param pwd - ap password
+ * @param ssid - ap ssid, FLASH_SSID_LEN bytes
+ * @param pwd - ap password, FLASH_PWD_LEN bytes
  */
 void flash_get_ssid_pwd(char *ssid, char *pwd)
 {
-    FLASH_Read(FLASH_ADDR + SSID_OFFSET, (uint8_t *)ssid, 32);
-    FLASH_Read(FLASH_ADDR + PWD_OFFSET, (uint8_t *)pwd, 32);
+    flash_lock();
+    strcpy(ssid, flash_ram.ssid);
+    strcpy(pwd, flash_ram.pwd);
+    flash_unlock();
     TRACE("get ssid(%s), pwd(%s)\r\n", ssid, pwd);
 }
 
 /**
- * @brief set ap ssid and password
+ * @brief set ap ssid and password, mode is kept
  * @param ssid - ap ssid
  * @param pwd - ap password
  */
 void flash_set_ssid_pwd(const char *ssid, const char *pwd)
 {
-    FLASH_ErasePage(FLASH_ADDR);
-    FLASH_Write(FLASH_ADDR, "INIT", 4);
-    FLASH_Write(FLASH_ADDR + SSID_OFFSET, (uint8_t *)ssid, strlen(ssid) + 1);
-    FLASH_Write(FLASH_ADDR + PWD_OFFSET, (uint8_t *)pwd, strlen(pwd) + 1);
+    flash_lock();
+    flash_cache_ap(ssid, pwd);
+    flash_changed(FLASH_DIRTY_AP);
+    flash_unlock();
     TRACE("update ssid(%s), pwd(%s)\r\n", ssid, pwd);
 }
 
 /**
- * @brief restore to configure
+ * @brief get saved mode
+ * @param mode - saved mode
+ * @return FALSE if mode is never saved
+ */
+bool flash_get_mode(mode_config *mode)
+{
+    bool saved = FALSE;
+
+    flash_lock();
+    saved = flash_ram.mode_saved;
+    *mode = flash_ram.mode;
+    flash_unlock();
+
+    return saved;
+}
+
+/**
+ * @brief save mode, network configure is kept
+ * @param mode - mode to save
+ */
+void flash_set_mode(const mode_config *mode)
+{
+    flash_lock();
+    flash_ram.mode = *mode;
+    flash_ram.mode_saved = TRUE;
+    flash_changed(FLASH_DIRTY_MODE);
+    flash_unlock();
+    TRACE("update mode\r\n");
+}
+
+/**
+ * @brief restore network configure, mode is kept
  */
 void flash_restore(void)
 {
-    FLASH_ErasePage(FLASH_ADDR);
-}
\ No newline at end of file
+    flash_lock();
+    memset(flash_ram.ssid, 0, sizeof(flash_ram.ssid));
+    memset(flash_ram.pwd, 0, sizeof(flash_ram.pwd));
+    flash_ram.ap_saved = FALSE;
+    flash_changed(FLASH_DIRTY_AP);
+    flash_unlock();
+}
+
+/**
+ * @brief erase all configure
+ */
+void flash_clear(void)
+{
+    flash_lock();
+    xTimerStop(xFlashCommit, 0);
+    memset(&flash_ram, 0, sizeof(flash_ram));
+    flash_dirty = 0;
+    kv_clear();
+    /* old configure page is released already */
+    flash_mark_migrated();
+    flash_unlock();
+}
+
+/**
+ * @brief commit pending changes now, should be called before reset. it
+ *        blocks on flash, so it is not called in timer callbacks
+ */
+void flash_sync(void)
+{
+    bool committed = FALSE;
+
+    flash_lock();
+    xTimerStop(xFlashCommit, 0);
+    committed = flash_commit();
+    flash_unlock();
+
+    if (committed)
+    {
+        flash_show_commit();
+    }
+
+    if (0 != flash_dirty)
+    {
+        TRACE("commit failed, changes are lost\r\n");
+    }
+}
+
+/**
+ * @brief queue work to flash task, called from timer callbacks which must
+ *        not block
+ * @param work - work, it may block on flash
+ * @param arg - work argument
+ * @return FALSE if work queue is full
+ */
+bool flash_defer(flash_work work, uint32_t arg)
+{
+    flash_job job = {work, arg};
+    assert_param(NULL != work);
+
+    return (pdPASS == xQueueSend(xFlashWork, &job, 0));
+}
+
+/**
+ * @brief get configure write statistics
+ * @param stat - write statistics
+ */
+void flash_get_stat(flash_stat *stat)
+{
+    kv_info info;
+    assert_param(NULL != stat);
+
+    kv_get_info(&info);
+    flash_lock();
+    stat->changes = flash_changes;
+    stat->commits = flash_commits;
+    flash_unlock();
+    stat->erases = info.erases;
+    stat->used = info.used;
+    stat->size = info.size;
+}
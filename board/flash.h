@@ -9,11 +9,36 @@
   #define _FLASH_H_
 
 #include "types.h"
+#include "mode.h"
 
+/* configure write statistics */
+typedef struct
+{
+    /* page erases of store since first start */
+    uint32_t erases;
+    /* changes and flash commits since startup */
+    uint16_t changes;
+    uint16_t commits;
+    /* bytes used in active page and page size */
+    uint16_t used;
+    uint16_t size;
+}flash_stat;
+
+/* work which may block on flash, it runs in flash task */
+typedef void (*flash_work)(uint32_t arg);
+
+void flash_init(void);
 bool flash_first_start(void);
+bool flash_migrated(void);
 void flash_restore(void);
+void flash_clear(void);
 void flash_get_ssid_pwd(char *ssid, char *pwd);
 void flash_set_ssid_pwd(const char *ssid, const char *pwd);
+bool flash_get_mode(mode_config *mode);
+void flash_set_mode(const mode_config *mode);
+void flash_sync(void);
+void flash_get_stat(flash_stat *stat);
+bool flash_defer(flash_work work, uint32_t arg);
 
 
 #endif
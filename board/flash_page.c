@@ -0,0 +1,269 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "flash_page.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "assert.h"
+#include "global.h"
+#include "stm32f10x_cfg.h"
+
+/* page erase takes 20ms to 40ms */
+#define FLASH_ERASE_WAIT     (100 / portTICK_PERIOD_MS)
+
+#define FLASH_US_PER_TICK    (1000000 / configTICK_RATE_HZ)
+/* systick runs on port clock, not core clock */
+#define FLASH_COUNTS_PER_US  (configSYSTICK_CLOCK_HZ / 1000000)
+
+static xSemaphoreHandle xFlashMutex = NULL;
+static xSemaphoreHandle xFlashDone = NULL;
+static flash_page_stat flash_stat;
+
+/**
+ * @brief check if scheduler runs, flash is used before it starts
+ * @return TRUE if scheduler runs
+ */
+static __INLINE bool flash_page_scheduled(void)
+{
+    return (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState());
+}
+
+/**
+ * @brief get time since startup, systick counts down in every tick
+ * @return time(us)
+ */
+static uint32_t flash_page_now(void)
+{
+    TickType_t tick = 0;
+    uint32_t count = 0;
+
+    do
+    {
+        tick = xTaskGetTickCount();
+        count = SYSTICK_GetCounter();
+    } while (tick != xTaskGetTickCount());
+
+    return tick * FLASH_US_PER_TICK +
+           (SYSTICK_GetReload() - count) / FLASH_COUNTS_PER_US;
+}
+
+/**
+ * @brief update time statistics
+ * @param last - last time
+ * @param max - longest time
+ * @param start - start time(us)
+ */
+static void flash_page_time(uint16_t *last, uint16_t *max, uint32_t start)
+{
+    *last = (uint16_t)MIN(flash_page_now() - start, 0xffff);
+    if (*last > *max)
+    {
+        *max = *last;
+    }
+}
+
+/**
+ * @brief check if page is erased
+ * @param addr - page address
+ * @return TRUE if all bits are set
+ */
+static bool flash_page_blank(uint32_t addr)
+{
+    const uint32_t *words = (const uint32_t *)addr;
+    for (int i = 0; i < FLASH_PAGE_SIZE / 4; ++i)
+    {
+        if (0xffffffff != words[i])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * flash interrupt handler, end of erase
+ */
+void FLASH_IRQHandler(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    FLASH_EnableInt(FLASH_IT_EOP | FLASH_IT_ERR, FALSE);
+    FLASH_ClrFlag(FLAH_FLAG_EOP);
+    xSemaphoreGiveFromISR(xFlashDone, &xHigherPriorityTaskWoken);
+    /* check if there is any higher priority task need to wakeup */
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief erase page, task sleeps until eop interrupt. should be called
+ *        with lock held
+ * @param addr - page address
+ * @return TRUE if page is erased
+ */
+static bool flash_page_do_erase(uint32_t addr)
+{
+    uint32_t start = 0;
+    bool ret = FALSE;
+
+    if (!flash_page_scheduled())
+    {
+        FLASH_ErasePage(addr);
+        return flash_page_blank(addr);
+    }
+
+    start = flash_page_now();
+    /* drop interrupt of timed out erase */
+    xSemaphoreTake(xFlashDone, 0);
+    FLASH_EnableInt(FLASH_IT_EOP | FLASH_IT_ERR, TRUE);
+    FLASH_StartErasePage(addr);
+    /* single bank flash stalls fetches until erase is done, other tasks
+       run as soon as it is */
+    xSemaphoreTake(xFlashDone, FLASH_ERASE_WAIT);
+    FLASH_EnableInt(FLASH_IT_EOP | FLASH_IT_ERR, FALSE);
+    ret = FLASH_FinishErase() && flash_page_blank(addr);
+
+    flash_stat.erases ++;
+    flash_page_time(&flash_stat.erase_last, &flash_stat.erase_max, start);
+
+    return ret;
+}
+
+/**
+ * @brief program data in one sequence with other tasks held off, interrupts
+ *        are served between half words. should be called with lock held
+ * @param addr - start address
+ * @param data - data
+ * @param len - data length
+ * @return TRUE if data is programmed and verified
+ */
+static bool flash_page_do_program(uint32_t addr, const void *data,
+                                  uint32_t len)
+{
+    bool ret = FALSE;
+
+    if (!flash_page_scheduled())
+    {
+        return FLASH_Program(addr, (const uint8_t *)data, len);
+    }
+
+    vTaskSuspendAll();
+    ret = FLASH_Program(addr, (const uint8_t *)data, len);
+    xTaskResumeAll();
+
+    return ret;
+}
+
+/**
+ * @brief initialize flash page access, should be called before scheduler
+ *        starts
+ */
+void flash_page_init(void)
+{
+    xFlashMutex = xSemaphoreCreateMutex();
+    xFlashDone = xSemaphoreCreateBinary();
+    assert_param((NULL != xFlashMutex) && (NULL != xFlashDone));
+
+    NVIC_Config nvicConfig = {FLASH_IRQChannel, FLASH_PRIORITY, 0, TRUE};
+    NVIC_Init(&nvicConfig);
+}
+
+/**
+ * @brief erase page
+ * @param addr - page address
+ * @return TRUE if page is erased
+ */
+bool flash_page_erase(uint32_t addr)
+{
+    bool ret = FALSE;
+    assert_param(0 == (addr % FLASH_PAGE_SIZE));
+
+    if (flash_page_scheduled())
+    {
+        xSemaphoreTake(xFlashMutex, portMAX_DELAY);
+    }
+    ret = flash_page_do_erase(addr);
+    if (flash_page_scheduled())
+    {
+        xSemaphoreGive(xFlashMutex);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief program data in one page
+ * @param addr - start address, half word aligned
+ * @param data - data, any alignment
+ * @param len - data length, odd tail byte is padded with 0xff
+ * @return TRUE if data is programmed and verified
+ */
+bool flash_page_program(uint32_t addr, const void *data, uint32_t len)
+{
+    bool ret = FALSE;
+    assert_param(0 == (addr & 0x01));
+    assert_param((len > 0) && ((addr % FLASH_PAGE_SIZE) + len <=
+                               FLASH_PAGE_SIZE));
+
+    if (flash_page_scheduled())
+    {
+        xSemaphoreTake(xFlashMutex, portMAX_DELAY);
+    }
+    ret = flash_page_do_program(addr, data, len);
+    if (flash_page_scheduled())
+    {
+        xSemaphoreGive(xFlashMutex);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief erase page and program prepared image from page start
+ * @param addr - page address
+ * @param image - page image
+ * @param len - image length
+ * @return TRUE if image is programmed and verified
+ */
+bool flash_page_write(uint32_t addr, const void *image, uint32_t len)
+{
+    uint32_t start = 0;
+    bool ret = FALSE;
+    assert_param(0 == (addr % FLASH_PAGE_SIZE));
+    assert_param(len <= FLASH_PAGE_SIZE);
+
+    if (!flash_page_scheduled())
+    {
+        return flash_page_do_erase(addr) &&
+               ((0 == len) || flash_page_do_program(addr, image, len));
+    }
+
+    xSemaphoreTake(xFlashMutex, portMAX_DELAY);
+    ret = flash_page_do_erase(addr);
+    if (ret && (len > 0))
+    {
+        start = flash_page_now();
+        ret = flash_page_do_program(addr, image, len);
+        flash_stat.pages ++;
+        flash_page_time(&flash_stat.page_last, &flash_stat.page_max, start);
+    }
+    xSemaphoreGive(xFlashMutex);
+
+    return ret;
+}
+
+/**
+ * @brief get flash timing
+ * @param stat - flash timing
+ */
+void flash_page_get_stat(flash_page_stat *stat)
+{
+    assert_param(NULL != stat);
+    taskENTER_CRITICAL();
+    *stat = flash_stat;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,38 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _FLASH_PAGE_H_
+  #define _FLASH_PAGE_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+#define FLASH_PAGE_SIZE      (1024)
+
+/* flash timing since startup */
+typedef struct
+{
+    uint16_t erases;
+    uint16_t pages;
+    /* last and longest erase time(us) */
+    uint16_t erase_last;
+    uint16_t erase_max;
+    /* last and longest program time of page image(us) */
+    uint16_t page_last;
+    uint16_t page_max;
+}flash_page_stat;
+
+void flash_page_init(void);
+bool flash_page_erase(uint32_t addr);
+bool flash_page_program(uint32_t addr, const void *data, uint32_t len);
+bool flash_page_write(uint32_t addr, const void *image, uint32_t len);
+void flash_page_get_stat(flash_page_stat *stat);
+
+END_DECLS
+
+#endif /* _FLASH_PAGE_H_ */
@@ -11,8 +11,8 @@
 #include "FreeRTOS.h"
 
 /* task priority definition */
-#define LICENSE_PRIORITY             (tskIDLE_PRIORITY + 1)
 #define INIT_SYSTEM_PRIORITY         (tskIDLE_PRIORITY + 1)
+#define TEST_SYSTEM_PRIORITY         (tskIDLE_PRIORITY + 1)
 #define INIT_NETWORK_PRIORITY        (tskIDLE_PRIORITY + 1)
 #define HTTP_PRIORITY                (tskIDLE_PRIORITY + 3)
 #define AP_PRIORITY                  (tskIDLE_PRIORITY + 1)
@@ -20,29 +20,44 @@
 #define M26_PRIORITY                 (tskIDLE_PRIORITY + 4)
 #define MOTOR_PRIORITY               (tskIDLE_PRIORITY + 1)
 #define MQTT_PRIORITY                (tskIDLE_PRIORITY + 2)
-#define IR_PRIORITY                  (tskIDLE_PRIORITY + 1)
-#define MODESWITCH_PRIORITY          (tskIDLE_PRIORITY + 1)
 #define MOTOR_STATE_PRIORITY         (tskIDLE_PRIORITY + 1)
-#define LED_PRIORITY                 (tskIDLE_PRIORITY)
+#define SLOT_SENSOR_PRIORITY         (tskIDLE_PRIORITY + 1)
+#define WATCHDOG_PRIORITY            (tskIDLE_PRIORITY + 4)
+#define FLASH_WORK_PRIORITY          (tskIDLE_PRIORITY + 1)
 
 /* task stack definition */
-#define LICENSE_STACK_SIZE           (configMINIMAL_STACK_SIZE)
 #define INIT_SYSTEM_STACK_SIZE       (configMINIMAL_STACK_SIZE)
+#define TEST_SYSTEM_STACK_SIZE       (configMINIMAL_STACK_SIZE * 2)
 #define INIT_NETWORK_STACK_SIZE      (configMINIMAL_STACK_SIZE)
 #define HTTP_STACK_SIZE              (configMINIMAL_STACK_SIZE)
 #define AP_STACK_SIZE                (configMINIMAL_STACK_SIZE)
 #define ESP8266_STACK_SIZE           (configMINIMAL_STACK_SIZE * 2)
 #define M26_STACK_SIZE               (configMINIMAL_STACK_SIZE)
-#define MOTOR_STACK_SIZE             (configMINIMAL_STACK_SIZE)
+#define MOTOR_STACK_SIZE             (configMINIMAL_STACK_SIZE * 2)
 #define MQTT_STACK_SIZE              (configMINIMAL_STACK_SIZE)
-#define IR_STACK_SIZE                (configMINIMAL_STACK_SIZE)
-#define MODESWITCH_STACK_SIZE        (configMINIMAL_STACK_SIZE)
+#define MQTT_RECV_STACK_SIZE         (configMINIMAL_STACK_SIZE * 2)
 #define MOTOR_STATE_STACK_SIZE       (configMINIMAL_STACK_SIZE * 2)
-#define LED_STACK_SIZE               (configMINIMAL_STACK_SIZE)
+#define SLOT_SENSOR_STACK_SIZE       (configMINIMAL_STACK_SIZE)
+#define WATCHDOG_STACK_SIZE          (configMINIMAL_STACK_SIZE)
+#define FLASH_WORK_STACK_SIZE        (configMINIMAL_STACK_SIZE * 2)
 
 /* interrupt priority */
 #define USART1_PRIORITY        (13)
+/* motor detect, pulse timer and current sense interrupts must share one 
+   priority, motor pulse state is not protected between them */
 #define EXTI3_PRIORITY         (14)
+#define MOTOR_TIMER_PRIORITY   (14)
+#define ADC_PRIORITY           (14)
+#define EXTI2_PRIORITY         (14)
+#define EXTI9_5_PRIORITY       (14)
+/* latches 74hc595 chain after dma transfer */
+#define HC595_DMA_PRIORITY     (14)
+/* wakes task waiting crc of large block */
+#define CRC_DMA_PRIORITY       (14)
+/* wakes task waiting page erase */
+#define FLASH_PRIORITY         (14)
+/* led frame timer is masked in critical section when frame is written */
+#define LED_TIMER_PRIORITY     (15)
 
 
 #endif /* _GLOBAL_H_ */
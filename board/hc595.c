@@ -0,0 +1,282 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "hc595.h"
+#include "assert.h"
+#include "cm3_core.h"
+#include "global.h"
+#include "stm32f10x_cfg.h"
+
+/* chains of this length or longer are sent by dma */
+#define HC595_DMA_BYTES    (4)
+
+/* spi1 and spi2 tx requests are routed to dma1 */
+#define HC595_DMA_SPI_NUM  (2)
+static const DMA_Channel hc595_dma_channels[HC595_DMA_SPI_NUM] =
+{
+    DMA1_Channel3,
+    DMA1_Channel5,
+};
+static const uint8_t hc595_dma_irqs[HC595_DMA_SPI_NUM] =
+{
+    DMAChannel3_IRQChannel,
+    DMAChannel5_IRQChannel,
+};
+static hc595_chain *hc595_dma_chains[HC595_DMA_SPI_NUM];
+
+/**
+ * @brief shift register transition
+ * @param chain - shift register chain
+ */
+static __INLINE void sh_transition(const hc595_chain *chain)
+{
+    pin_handle_reset(&chain->sh);
+    __NOP();
+    __NOP();
+    pin_handle_set(&chain->sh);
+    __NOP();
+    __NOP();
+}
+
+/**
+ * @brief storage register transition
+ * @param chain - shift register chain
+ */
+static __INLINE void st_transition(const hc595_chain *chain)
+{
+    pin_handle_reset(&chain->st);
+    __NOP();
+    __NOP();
+    pin_handle_set(&chain->st);
+    __NOP();
+    __NOP();
+}
+
+/**
+ * @brief get byte of chain, byte 0 holds output 0 to 7 of the first chip
+ * @param chain - shift register chain
+ * @param bits - data bitmap
+ * @param index - byte index
+ * @return byte to send
+ */
+static __INLINE uint8_t hc595_byte(const hc595_chain *chain,
+                                   const uint32_t *bits, uint8_t index)
+{
+    uint8_t val = (uint8_t)(bits[index >> 2] >> ((index & 0x03) << 3));
+    return chain->invert ? (uint8_t)~val : val;
+}
+
+/**
+ * @brief wait spi shifting out all data and latch outputs
+ * @param chain - shift register chain
+ */
+static void hc595_spi_latch(hc595_chain *chain)
+{
+    while (!SPI_IsFlagOn(chain->spi, SPI_Flag_TXE));
+    while (SPI_IsFlagOn(chain->spi, SPI_Flag_BSY));
+    st_transition(chain);
+    chain->pending = FALSE;
+}
+
+/**
+ * @brief finish dma transfer in flight, frame can be reused after this
+ * @param chain - shift register chain
+ */
+static void hc595_spi_flush(hc595_chain *chain)
+{
+    if (chain->pending)
+    {
+        while (0 != DMA_GetCount(hc595_dma_channels[chain->spi]));
+        /* latching twice is harmless if interrupt is faster */
+        hc595_spi_latch(chain);
+    }
+}
+
+/**
+ * @brief dma transfer complete handler
+ * @param spi - spi group
+ */
+static void hc595_dma_complete(SPI_Group spi)
+{
+    DMA_Channel channel = hc595_dma_channels[spi];
+    hc595_chain *chain = hc595_dma_chains[spi];
+
+    DMA_ClrFlag(channel, DMA_FLAG_GL);
+    /* a new transfer may be started before this interrupt is served */
+    if ((NULL != chain) && chain->pending && (0 == DMA_GetCount(channel)))
+    {
+        hc595_spi_latch(chain);
+    }
+}
+
+/**
+ * spi1 tx dma interrupt handler
+ */
+void DMAChannel3_IRQHandler(void)
+{
+    hc595_dma_complete(SPI1);
+}
+
+/**
+ * spi2 tx dma interrupt handler
+ */
+void DMAChannel5_IRQHandler(void)
+{
+    hc595_dma_complete(SPI2);
+}
+
+/**
+ * @brief resolve pins of 74hc595 chain
+ * @param chain - shift register chain
+ * @param data - serial data pin
+ * @param st - storage clock pin
+ * @param sh - shift clock pin
+ * @param invert - output is low when bit is set
+ */
+void hc595_init(hc595_chain *chain, pin_id data, pin_id st, pin_id sh,
+                bool invert)
+{
+    assert_param(NULL != chain);
+    pin_resolve(data, &chain->data);
+    pin_resolve(st, &chain->st);
+    pin_resolve(sh, &chain->sh);
+    chain->invert = invert;
+    chain->use_spi = FALSE;
+    chain->pending = FALSE;
+}
+
+/**
+ * @brief initialize 74hc595 chain on spi, shift clock and serial data
+ *        should be configured as sck and mosi alternate function
+ * @param chain - shift register chain
+ * @param spi - spi group
+ * @param st - storage clock pin
+ * @param invert - output is low when bit is set
+ */
+void hc595_init_spi(hc595_chain *chain, SPI_Group spi, pin_id st,
+                    bool invert)
+{
+    assert_param(NULL != chain);
+    assert_param(spi < SPI_Count);
+    pin_resolve(st, &chain->st);
+    chain->invert = invert;
+    chain->use_spi = TRUE;
+    chain->spi = spi;
+    chain->pending = FALSE;
+
+    /* 74hc595 shifts at rising edge, output only, 18MHz on spi1 and 9MHz
+       on spi2 */
+    SPI_Config config;
+    SPI_StructInit(&config);
+    config.subMode = SPI_SubMode_BiDirection_Write;
+    config.polarity = SPI_Polarity_Low;
+    config.phase = SPI_Phase_FirstClk;
+    config.clock = SPI_Clk_Divided_4;
+    if (SPI1 == spi)
+    {
+        RCC_APB2PeriphReset(RCC_APB2_RESET_SPI1, TRUE);
+        RCC_APB2PeriphReset(RCC_APB2_RESET_SPI1, FALSE);
+        RCC_APB2PeripClockEnable(RCC_APB2_ENABLE_SPI1, TRUE);
+    }
+    else if (SPI2 == spi)
+    {
+        RCC_APB1PeriphReset(RCC_APB1_RESET_SPI2, TRUE);
+        RCC_APB1PeriphReset(RCC_APB1_RESET_SPI2, FALSE);
+        RCC_APB1PeripClockEnable(RCC_APB1_ENABLE_SPI2, TRUE);
+    }
+    SPI_Setup(spi, &config);
+
+    if (spi < HC595_DMA_SPI_NUM)
+    {
+        DMA_Channel channel = hc595_dma_channels[spi];
+        DMA_Config dmaConfig;
+        RCC_AHBPeripClockEnable(RCC_AHB_ENABLE_DMA1, TRUE);
+        DMA_Enable(channel, FALSE);
+        DMA_StructInit(&dmaConfig);
+        DMA_Setup(channel, &dmaConfig);
+        DMA_EnableInt(channel, DMA_IT_TC, TRUE);
+        hc595_dma_chains[spi] = chain;
+        SPI_EnableTxDMA(spi, TRUE);
+
+        NVIC_Config nvicConfig = {hc595_dma_irqs[spi], HC595_DMA_PRIORITY,
+                                  0, TRUE};
+        NVIC_Init(&nvicConfig);
+    }
+
+    SPI_Enable(spi, TRUE);
+}
+
+/**
+ * @brief send data to 74hc595 chain through spi, chains long enough are
+ *        sent by dma and latched in interrupt
+ * @param chain - shift register chain
+ * @param bits - data bitmap
+ * @param bytes - byte count of chain
+ */
+static void hc595_write_spi(hc595_chain *chain, const uint32_t *bits,
+                            uint8_t bytes)
+{
+    hc595_spi_flush(chain);
+
+    /* last byte is shifted out first, msb first */
+    if ((bytes >= HC595_DMA_BYTES) && (chain->spi < HC595_DMA_SPI_NUM))
+    {
+        DMA_Channel channel = hc595_dma_channels[chain->spi];
+        for (uint8_t i = 0; i < bytes; ++i)
+        {
+            chain->frame[i] = hc595_byte(chain, bits, bytes - 1 - i);
+        }
+
+        DMA_Enable(channel, FALSE);
+        DMA_ClrFlag(channel, DMA_FLAG_GL);
+        DMA_SetAddress(channel, SPI_DataAddress(chain->spi),
+                       (uint32_t)chain->frame);
+        DMA_SetCount(channel, bytes);
+        chain->pending = TRUE;
+        DMA_Enable(channel, TRUE);
+    }
+    else
+    {
+        for (int i = bytes - 1; i >= 0; --i)
+        {
+            SPI_WriteDataSync(chain->spi, hc595_byte(chain, bits, i));
+        }
+        hc595_spi_latch(chain);
+    }
+}
+
+/**
+ * @brief send data to 74hc595 chain, bit 0 is output 0 of the first chip
+ * @param chain - shift register chain
+ * @param bits - data bitmap
+ * @param count - bit count of chain
+ */
+void hc595_write(hc595_chain *chain, const uint32_t *bits, uint8_t count)
+{
+    bool set = FALSE;
+    const pin_handle *data = &chain->data;
+    assert_param(NULL != chain);
+    assert_param(NULL != bits);
+    assert_param(count <= HC595_MAX_BITS);
+
+    if (chain->use_spi)
+    {
+        assert_param(0 == (count & 0x07));
+        hc595_write_spi(chain, bits, count >> 3);
+        return ;
+    }
+
+    /* last bit is shifted out first */
+    for (int i = count - 1; i >= 0; --i)
+    {
+        set = (0 != (bits[i >> 5] & (1ul << (i & 0x1f))));
+        pin_handle_write(data, set != chain->invert);
+        sh_transition(chain);
+    }
+    st_transition(chain);
+}
+
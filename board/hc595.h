@@ -0,0 +1,45 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _HC595_H_
+  #define _HC595_H_
+
+#include "types.h"
+#include "pinconfig.h"
+#include "stm32f10x_spi.h"
+
+BEGIN_DECLS
+
+/* longest chain in bits */
+#define HC595_MAX_BITS     (64)
+
+/* daisy-chained 74hc595 shift registers */
+typedef struct
+{
+    pin_handle data;
+    pin_handle st;
+    pin_handle sh;
+    /* output is low when bit is set */
+    bool invert;
+    /* shift and data lines are spi sck and mosi */
+    bool use_spi;
+    SPI_Group spi;
+    /* dma transfer is not latched yet */
+    volatile bool pending;
+    uint8_t frame[HC595_MAX_BITS >> 3];
+}hc595_chain;
+
+void hc595_init(hc595_chain *chain, pin_id data, pin_id st, pin_id sh,
+                bool invert);
+void hc595_init_spi(hc595_chain *chain, SPI_Group spi, pin_id st,
+                    bool invert);
+void hc595_write(hc595_chain *chain, const uint32_t *bits, uint8_t count);
+
+END_DECLS
+
+
+#endif /* _HC595_H_ */
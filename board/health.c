@@ -0,0 +1,342 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "health.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "assert.h"
+#include "trace.h"
+#include "motorctl.h"
+#include "stm32f10x_cfg.h"
+#include "flash_page.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[health]"
+
+/* 0x800FC00 and 0x800DC00, 1K each. checkpoints are appended to one page,
+   when it is full the other page is erased and takes the next checkpoint,
+   so last checkpoint survives power loss during erase */
+#define HEALTH_PAGES         (2)
+#define HEALTH_SIZE          1024
+static const uint32_t health_pages[HEALTH_PAGES] = {0x800FC00, 0x800DC00};
+
+/* checkpoint of all slots, check sum is programmed last, so record with bad
+   sum is a broken write. latest checkpoint has the newest sequence */
+typedef struct
+{
+    uint16_t seq;
+    uint16_t erases;
+    health_slot slots[MOTOR_NUM];
+    /* learned run time of slots(ms) */
+    uint16_t learned[MOTOR_NUM];
+    uint16_t sum;
+    uint16_t reserved;
+}health_snapshot;
+#define HEALTH_RECORDS       (HEALTH_SIZE / sizeof(health_snapshot))
+#define HEALTH_ERASED        (0xffff)
+
+/* seq, erases and sum take 8 bytes, every slot takes 12 bytes and 2 bytes
+   of learned run time */
+#if ((MOTOR_NUM * 14 + 8) > HEALTH_SIZE)
+  #error "health checkpoint exceeds flash page"
+#endif
+
+/* a page is erased at most once a day, about 25 years for 10k cycles. dirty
+   statistics are saved once per interval, less often when less records
+   fit in page */
+#define HEALTH_ERASE_PERIOD  (12ul * 60 * 60 * 1000 / portTICK_PERIOD_MS)
+#define HEALTH_SAVE_INTERVAL (HEALTH_ERASE_PERIOD / HEALTH_RECORDS)
+
+static health_snapshot health_stat;
+/* page of last checkpoint and its next free record */
+static uint8_t health_page = 0;
+static uint16_t health_tail = 0;
+static uint16_t health_dirty = 0;
+static TickType_t health_saved = 0;
+static xSemaphoreHandle xHealthMutex = NULL;
+
+/**
+ * @brief calculate check sum of snapshot
+ * @param snapshot - health snapshot
+ * @return check sum
+ */
+static uint16_t health_sum(const health_snapshot *snapshot)
+{
+    const uint16_t *data = (const uint16_t *)snapshot;
+    uint16_t sum = 0;
+
+    for (int i = 0; i < offsetof(health_snapshot, sum) / 2; ++i)
+    {
+        sum += data[i];
+    }
+
+    return ~sum;
+}
+
+/**
+ * @brief check if sequence is newer, sequence wraps at 15 bits
+ * @param seq - sequence
+ * @param than - sequence to compare with
+ * @return TRUE if seq is newer
+ */
+static __INLINE bool health_newer(uint16_t seq, uint16_t than)
+{
+    uint16_t diff = (seq - than) & 0x7fff;
+    return (diff > 0) && (diff < 0x4000);
+}
+
+/**
+ * @brief save statistics to flash, failed write is tried again after save
+ *        interval
+ * @return TRUE if checkpoint is written
+ */
+static bool health_save(void)
+{
+    uint8_t page = health_page;
+    uint16_t tail = health_tail;
+    uint32_t addr = 0;
+
+    health_saved = xTaskGetTickCount();
+    if (tail >= HEALTH_RECORDS)
+    {
+        page = (page + 1) % HEALTH_PAGES;
+        tail = 0;
+        if (!flash_page_erase(health_pages[page]))
+        {
+            TRACE("erase page %d failed\r\n", page);
+            return FALSE;
+        }
+        health_stat.erases ++;
+    }
+
+    /* erased sequence marks free record */
+    health_stat.seq = (health_stat.seq + 1) & 0x7fff;
+    health_stat.sum = health_sum(&health_stat);
+    addr = health_pages[page] + tail * sizeof(health_snapshot);
+    /* half words are programmed in order, check sum goes last */
+    if (!flash_page_program(addr, &health_stat,
+                            offsetof(health_snapshot, sum) +
+                            sizeof(health_stat.sum)))
+    {
+        /* record may be half written, next checkpoint goes to the other
+           page and last checkpoint is kept */
+        TRACE("checkpoint %d write failed\r\n", health_stat.seq);
+        health_tail = HEALTH_RECORDS;
+        return FALSE;
+    }
+
+    health_page = page;
+    health_tail = tail + 1;
+    health_dirty = 0;
+    TRACE("checkpoint %d saved, pages erased %d times\r\n", health_stat.seq,
+          health_stat.erases);
+    return TRUE;
+}
+
+/**
+ * @brief initialize health statistics, load latest checkpoint of both
+ *        pages
+ */
+void health_init(void)
+{
+    const health_snapshot *snapshot = NULL;
+    const health_snapshot *last = NULL;
+    uint16_t tails[HEALTH_PAGES];
+
+    TRACE("initialize health...\r\n");
+    xHealthMutex = xSemaphoreCreateMutex();
+    memset(&health_stat, 0, sizeof(health_stat));
+    for (int page = 0; page < HEALTH_PAGES; ++page)
+    {
+        snapshot = (const health_snapshot *)health_pages[page];
+        tails[page] = HEALTH_RECORDS;
+        for (int i = 0; i < HEALTH_RECORDS; ++i, ++snapshot)
+        {
+            if (HEALTH_ERASED == snapshot->seq)
+            {
+                tails[page] = i;
+                break;
+            }
+
+            if ((snapshot->sum == health_sum(snapshot)) &&
+                ((NULL == last) || health_newer(snapshot->seq, last->seq)))
+            {
+                last = snapshot;
+                health_page = page;
+            }
+        }
+    }
+
+    health_tail = tails[health_page];
+    if (NULL != last)
+    {
+        health_stat = *last;
+    }
+    TRACE("health: checkpoint %d, pages erased %d times\r\n",
+          health_stat.seq, health_stat.erases);
+}
+
+/**
+ * @brief record one vend cycle
+ * @param slot - slot number
+ * @param time - vend run time(ms)
+ * @param result - vend result
+ */
+void health_record(uint8_t slot, uint16_t time, uint8_t result)
+{
+    health_slot *stat = NULL;
+    assert_param(slot < MOTOR_NUM);
+
+    xSemaphoreTake(xHealthMutex, portMAX_DELAY);
+    stat = &health_stat.slots[slot];
+    stat->vends ++;
+    switch (result)
+    {
+    case MOTOR_VEND_OK:
+        stat->avg_time = (0 == stat->avg_time) ? time :
+                         ((stat->avg_time * 7 + time) >> 3);
+        stat->peak_time = MAX(stat->peak_time, time);
+        break;
+    case MOTOR_VEND_TIMEOUT:
+        stat->timeouts ++;
+        break;
+    case MOTOR_VEND_JAM:
+        stat->jams ++;
+        break;
+    default:
+        break;
+    }
+    health_dirty ++;
+    xSemaphoreGive(xHealthMutex);
+    
+    health_poll();
+}
+
+/**
+ * @brief get statistics of slot
+ * @param slot - slot number
+ * @param stat - slot statistics
+ */
+void health_get(uint8_t slot, health_slot *stat)
+{
+    assert_param(slot < MOTOR_NUM);
+    xSemaphoreTake(xHealthMutex, portMAX_DELAY);
+    *stat = health_stat.slots[slot];
+    xSemaphoreGive(xHealthMutex);
+}
+
+/**
+ * @brief update learned run time of slot, saved with statistics
+ * @param slot - slot number
+ * @param time - learned run time(ms)
+ */
+void health_learn(uint8_t slot, uint16_t time)
+{
+    assert_param(slot < MOTOR_NUM);
+    xSemaphoreTake(xHealthMutex, portMAX_DELAY);
+    if (health_stat.learned[slot] != time)
+    {
+        health_stat.learned[slot] = time;
+        health_dirty ++;
+    }
+    xSemaphoreGive(xHealthMutex);
+}
+
+/**
+ * @brief get saved learned run time of slot
+ * @param slot - slot number
+ * @return learned run time(ms), 0 if not learned
+ */
+uint16_t health_learned(uint8_t slot)
+{
+    uint16_t time = 0;
+    assert_param(slot < MOTOR_NUM);
+    xSemaphoreTake(xHealthMutex, portMAX_DELAY);
+    time = health_stat.learned[slot];
+    xSemaphoreGive(xHealthMutex);
+
+    return time;
+}
+
+/**
+ * @brief clear statistics of all slots, page erase count and learned run
+ *        time are kept
+ */
+void health_clear(void)
+{
+    TRACE("clear statistics\r\n");
+    xSemaphoreTake(xHealthMutex, portMAX_DELAY);
+    memset(health_stat.slots, 0, sizeof(health_stat.slots));
+    /* start a fresh page */
+    health_tail = HEALTH_RECORDS;
+    if (!health_save())
+    {
+        /* saved when interval elapses */
+        health_dirty ++;
+    }
+    xSemaphoreGive(xHealthMutex);
+}
+
+/**
+ * @brief save dirty statistics when save interval elapsed
+ */
+void health_poll(void)
+{
+    xSemaphoreTake(xHealthMutex, portMAX_DELAY);
+    if ((health_dirty > 0) && 
+        ((xTaskGetTickCount() - health_saved) >= HEALTH_SAVE_INTERVAL))
+    {
+        health_save();
+    }
+    xSemaphoreGive(xHealthMutex);
+}
+
+/**
+ * @brief format statistics of used slots as "slot,vends,avg,peak,timeouts,
+ *        jams;" entries
+ * @param slot - first slot to format, updated to next slot
+ * @param buf - output buffer
+ * @param len - buffer length
+ * @return formatted slot count
+ */
+uint8_t health_format(uint8_t *slot, char *buf, uint16_t len)
+{
+    char entry[32];
+    uint16_t used = 0;
+    uint8_t count = 0;
+    const health_slot *stat = NULL;
+
+    buf[0] = 0x00;
+    xSemaphoreTake(xHealthMutex, portMAX_DELAY);
+    for (; *slot < MOTOR_NUM; ++(*slot))
+    {
+        stat = &health_stat.slots[*slot];
+        if (0 == stat->vends)
+        {
+            continue;
+        }
+
+        sprintf(entry, "%d,%lu,%d,%d,%d,%d;", *slot, 
+                (unsigned long)stat->vends, stat->avg_time, stat->peak_time,
+                stat->timeouts, stat->jams);
+        if (used + strlen(entry) >= len)
+        {
+            break;
+        }
+        strcpy(buf + used, entry);
+        used += strlen(entry);
+        count ++;
+    }
+    xSemaphoreGive(xHealthMutex);
+
+    return count;
+}
+
@@ -0,0 +1,38 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _HEALTH_H_
+  #define _HEALTH_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* wear statistics of one slot */
+typedef struct
+{
+    /* motor cycles */
+    uint32_t vends;
+    /* average and peak run time of successful vends(ms) */
+    uint16_t avg_time;
+    uint16_t peak_time;
+    uint16_t timeouts;
+    uint16_t jams;
+}health_slot;
+
+void health_init(void);
+void health_record(uint8_t slot, uint16_t time, uint8_t result);
+void health_get(uint8_t slot, health_slot *stat);
+void health_learn(uint8_t slot, uint16_t time);
+uint16_t health_learned(uint8_t slot);
+void health_poll(void);
+void health_clear(void);
+uint8_t health_format(uint8_t *slot, char *buf, uint16_t len);
+
+END_DECLS
+
+#endif /* _HEALTH_H_ */
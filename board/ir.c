@@ -8,64 +8,241 @@
 #include "ir.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "timers.h"
+#include "assert.h"
 #include "trace.h"
 #include "pinconfig.h"
 #include "global.h"
 #include "stm32f10x_cfg.h"
 #include "led_motor.h"
+#include "mode.h"
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[ir]"
 
-#define MAX_OFF_COUNT    (10)
+#define IR_PIN           PIN_IR_IN
+
+/* input is stable for this time after last edge */
+#define IR_DEBOUNCE_TIME (20 / portTICK_PERIOD_MS)
+/* wait time of mode command */
+#define IR_CMD_WAIT      (10 / portTICK_PERIOD_MS)
+
+/* led fade time(ms) */
+#define IR_FADE_IN       (300)
+#define IR_FADE_OUT      (2000)
+
+static uint8_t ir_line = 0;
+static TimerHandle_t xIrDebounce = NULL;
+static TimerHandle_t xIrHold = NULL;
+/* leds stay on for this time after human leaved */
+static TickType_t ir_hold = 0;
+
+/* presence state, only changed in timer task */
+static bool ir_present = FALSE;
+static TickType_t ir_approach_tick = 0;
+static TickType_t ir_leave_tick = 0;
+
+/* statistics window */
+static TickType_t ir_window_start = 0;
+static TickType_t ir_occupied = 0;
+static TickType_t ir_dwell_sum = 0;
+static TickType_t ir_dwell_max = 0;
+static uint16_t ir_approaches = 0;
+static uint16_t ir_leaves = 0;
+
+/**
+ * @brief get start of occupied time in current window
+ * @return start tick
+ */
+static __INLINE TickType_t ir_occupy_start(void)
+{
+    return ((int32_t)(ir_approach_tick - ir_window_start) > 0) ?
+           ir_approach_tick : ir_window_start;
+}
+
+/**
+ * @brief get occupied time in current window
+ * @param end - end tick of presence
+ * @return occupied ticks, nothing if presence ended before window start
+ */
+static __INLINE TickType_t ir_occupy_time(TickType_t end)
+{
+    TickType_t start = ir_occupy_start();
+    return ((int32_t)(end - start) > 0) ? (end - start) : 0;
+}
+
+/**
+ * ir input interrupt handler
+ */
+void EXTI2_IRQHandler(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    EXTI_ClrPending(ir_line);
+    xTimerResetFromISR(xIrDebounce, &xHigherPriorityTaskWoken);
+    /* check if there is any higher priority task need to wakeup */
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
 
 /**
- * @brief motor control task
- * @param pvParameter - parameters pass to task
+ * @brief human leaved for hold time
+ * @param xTimer - timer handle
  */
-static void vIRCtl(void *pvParameters)
+static void vIrHold(TimerHandle_t xTimer)
 {
-    uint8_t count = 0;
-    bool led_off = TRUE;
-    for (;;)
+    TickType_t dwell = ir_leave_tick - ir_approach_tick;
+
+    TRACE("human leaved\r\n");
+    if (MODE_LED_IR == mode_led())
     {
-        if (is_pinset("IR_IN"))
-        {
-            /* no human */
-            count ++;
-            if (count > MAX_OFF_COUNT)
-            {
-                count = MAX_OFF_COUNT;
-                if (!led_off)
-                {
-                    led_off = TRUE;
-                    TRACE("human leaved, turn off leds\r\n");
-                    led_motor_all_off();
-                }
-            }
-        }
-        else
+        led_motor_all_level(0, IR_FADE_OUT);
+    }
+
+    taskENTER_CRITICAL();
+    ir_present = FALSE;
+    ir_occupied += ir_occupy_time(ir_leave_tick);
+    ir_dwell_sum += dwell;
+    if (dwell > ir_dwell_max)
+    {
+        ir_dwell_max = dwell;
+    }
+    ir_leaves ++;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief input is stable after edges
+ * @param xTimer - timer handle
+ */
+static void vIrDebounce(TimerHandle_t xTimer)
+{
+    /* input is low when human is detected */
+    if (!is_pinset(IR_PIN))
+    {
+        xTimerStop(xIrHold, 0);
+        if (!ir_present)
         {
-            count = 0;
-            if (led_off)
+            TRACE("human detected\r\n");
+            if (MODE_LED_IR == mode_led())
             {
-                led_off = FALSE;
-                TRACE("human detected, turn on leds\r\n");
-                led_motor_all_on();
+                led_motor_all_level(LED_MOTOR_LEVEL_MAX, IR_FADE_IN);
             }
+            taskENTER_CRITICAL();
+            ir_present = TRUE;
+            ir_approach_tick = xTaskGetTickCount();
+            ir_approaches ++;
+            taskEXIT_CRITICAL();
         }
-        
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+    else if (ir_present)
+    {
+        ir_leave_tick = xTaskGetTickCount();
+        xTimerChangePeriod(xIrHold, ir_hold, 0);
     }
 }
 
 /**
- * @brief initialize motor control
+ * @brief apply led policy and hold time of mode, called in timer task
+ *        except at initialize
+ * @param pvParameter1 - not used
+ * @param ulParameter2 - not used
+ */
+static void ir_apply(void *pvParameter1, uint32_t ulParameter2)
+{
+    bool on = FALSE;
+
+    ir_hold = (TickType_t)mode_ir_hold() * 1000 / portTICK_PERIOD_MS;
+    switch (mode_led())
+    {
+    case MODE_LED_ON:
+        on = TRUE;
+        break;
+    case MODE_LED_OFF:
+        on = FALSE;
+        break;
+    default:
+        on = ir_present;
+        break;
+    }
+
+    if (on)
+    {
+        led_motor_all_level(LED_MOTOR_LEVEL_MAX, IR_FADE_IN);
+    }
+    else
+    {
+        led_motor_all_level(0, IR_FADE_OUT);
+    }
+}
+
+/**
+ * @brief initialize ir presence detection
  */
 void ir_init(void)
 {
     TRACE("initialize ir...\r\n");
 
-    xTaskCreate(vIRCtl, "IRCtl", IR_STACK_SIZE, 
-                NULL, IR_PRIORITY, NULL);
-}
\ No newline at end of file
+    ir_window_start = xTaskGetTickCount();
+    ir_apply(NULL, 0);
+    xIrDebounce = xTimerCreate("irdeb", IR_DEBOUNCE_TIME, pdFALSE, NULL,
+                               vIrDebounce);
+    xIrHold = xTimerCreate("irhold", ir_hold, pdFALSE, NULL, vIrHold);
+    assert_param((NULL != xIrDebounce) && (NULL != xIrHold));
+
+    ir_line = pin_num(IR_PIN);
+    EXTI_ClrPending(ir_line);
+    GPIO_EXTIConfig(pin_group(IR_PIN), ir_line);
+    EXTI_SetTrigger(ir_line, 
+                    (Trigger_Edge)(Trigger_Rising | Trigger_Falling));
+    NVIC_Config nvicConfig = {EXTI2_IRQChannel, EXTI2_PRIORITY, 0, TRUE};
+    NVIC_Init(&nvicConfig);
+    EXTI_EnableLine_INT(ir_line, TRUE);
+
+    /* human may be there already */
+    xTimerStart(xIrDebounce, 0);
+}
+
+/**
+ * @brief apply changed led policy and hold time of mode
+ */
+void ir_apply_mode(void)
+{
+    xTimerPendFunctionCall(ir_apply, NULL, 0, IR_CMD_WAIT);
+}
+
+/**
+ * @brief get occupancy statistics and start a new window
+ * @param stat - occupancy statistics
+ */
+void ir_take_stat(ir_stat *stat)
+{
+    assert_param(NULL != stat);
+    TickType_t now = xTaskGetTickCount();
+    TickType_t window = 0;
+    TickType_t occupied = 0;
+
+    taskENTER_CRITICAL();
+    window = MAX(now - ir_window_start, 1);
+    occupied = ir_occupied;
+    if (ir_present)
+    {
+        /* human leaved already if hold time is running */
+        occupied += ir_occupy_time(xTimerIsTimerActive(xIrHold) ?
+                                   ir_leave_tick : now);
+    }
+    stat->approaches = ir_approaches;
+    stat->rate = (uint32_t)((uint64_t)ir_approaches * 3600000 /
+                            portTICK_PERIOD_MS / window);
+    stat->avg_dwell = (0 == ir_leaves) ? 0 :
+                      ir_dwell_sum * portTICK_PERIOD_MS / ir_leaves / 1000;
+    stat->max_dwell = ir_dwell_max * portTICK_PERIOD_MS / 1000;
+    stat->occupied = (uint64_t)occupied * 100 / window;
+
+    ir_window_start = now;
+    ir_occupied = 0;
+    ir_dwell_sum = 0;
+    ir_dwell_max = 0;
+    ir_approaches = 0;
+    ir_leaves = 0;
+    taskEXIT_CRITICAL();
+}
+
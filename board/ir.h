@@ -10,7 +10,26 @@
 
 #include "types.h"
 
+BEGIN_DECLS
+
+/* occupancy statistics since last taken */
+typedef struct
+{
+    uint16_t approaches;
+    /* approaches per hour */
+    uint16_t rate;
+    /* average and longest dwell time(s) */
+    uint16_t avg_dwell;
+    uint16_t max_dwell;
+    /* occupied time(percent) */
+    uint8_t occupied;
+}ir_stat;
+
 void ir_init(void);
+void ir_apply_mode(void);
+void ir_take_stat(ir_stat *stat);
+
+END_DECLS
 
 
-#endif
\ No newline at end of file
+#endif
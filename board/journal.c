@@ -0,0 +1,433 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <string.h>
+#include "journal.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "assert.h"
+#include "trace.h"
+#include "stm32f10x_cfg.h"
+#include "flash_page.h"
+#include "flash.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[journal]"
+
+/* journal takes two pages, 0x800F800 and 0x800F400 which held configure of
+   old layout. compact copies open transactions to the other page, page
+   head at the end of page is programmed last, so records of old page are
+   kept until copy is complete. newer sequence wins if both pages are
+   valid, page without head is replayed as page 0. 0x800F400 is used only
+   after configure is migrated from it, till then page 0 is compacted in
+   place */
+#define JOURNAL_SIZE         FLASH_PAGE_SIZE
+static const uint32_t journal_pages[2] = {0x800F800, 0x800F400};
+
+typedef struct
+{
+    uint16_t seq;
+    uint16_t magic;
+}journal_head;
+#define JOURNAL_MAGIC        (0x4a4c)
+#define JOURNAL_HEAD(page)   ((const journal_head *)(journal_pages[page] + \
+                              JOURNAL_SIZE - sizeof(journal_head)))
+
+/* record is two half words, transaction id first, then state and slot. 
+   state half word is programmed last, so record with erased state is a 
+   broken write and ignored */
+typedef struct
+{
+    uint16_t id;
+    uint16_t state;
+}journal_record;
+#define JOURNAL_RECORDS      ((JOURNAL_SIZE - sizeof(journal_head)) / \
+                              sizeof(journal_record))
+#define JOURNAL_ERASED       (0xffff)
+#define RECORD_STATE(state, result, slot)  \
+    ((uint16_t)((((result) << 4) | (state)) << 8) | (slot))
+
+/* open transactions */
+#define JOURNAL_OPEN_MAX     (32)
+static journal_entry journal_open[JOURNAL_OPEN_MAX];
+static uint8_t journal_open_count = 0;
+
+/* max records programmed in one sequence */
+#define JOURNAL_BATCH_MAX    (8)
+
+/* active page and its sequence, pages in use */
+static uint8_t journal_page = 0;
+static uint8_t journal_page_count = 2;
+static uint16_t journal_seq = 0;
+/* next free record */
+static uint16_t journal_tail = 0;
+/* next transaction id, ids of open transactions are skipped */
+static uint16_t journal_next = 1;
+static xSemaphoreHandle xJournalMutex = NULL;
+
+/**
+ * @brief find open transaction
+ * @param id - transaction id
+ * @param slot - slot number
+ * @return entry index, -1 if not found
+ */
+static int journal_find(uint16_t id, uint8_t slot)
+{
+    for (int i = 0; i < journal_open_count; ++i)
+    {
+        if ((journal_open[i].id == id) && (journal_open[i].slot == slot))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief check if transaction id can be given to new transaction
+ * @param id - transaction id
+ * @return TRUE if id is not used by open transaction
+ */
+static bool journal_id_free(uint16_t id)
+{
+    if ((JOURNAL_NO_ID == id) || (JOURNAL_ERASED == id))
+    {
+        return FALSE;
+    }
+
+    for (int i = 0; i < journal_open_count; ++i)
+    {
+        if (journal_open[i].id == id)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief apply record to open transactions
+ * @param id - transaction id
+ * @param state - state byte
+ * @param slot - slot number
+ */
+static void journal_apply(uint16_t id, uint8_t state, uint8_t slot)
+{
+    int index = journal_find(id, slot);
+
+    if ((state & 0x0f) == JOURNAL_REPORTED)
+    {
+        if (index >= 0)
+        {
+            journal_open_count --;
+            journal_open[index] = journal_open[journal_open_count];
+        }
+        return ;
+    }
+
+    if (index < 0)
+    {
+        if (journal_open_count >= JOURNAL_OPEN_MAX)
+        {
+            return ;
+        }
+        index = journal_open_count++;
+        journal_open[index].id = id;
+        journal_open[index].slot = slot;
+    }
+    journal_open[index].state = (state & 0x0f);
+    journal_open[index].result = (state >> 4);
+}
+
+/**
+ * @brief copy open transactions to the other page and make it active, 
+ *        records are built in ram and programmed in one sequence
+ * @return TRUE if journal is compacted
+ */
+static bool journal_compact(void)
+{
+    journal_record image[JOURNAL_OPEN_MAX];
+    uint8_t page = (journal_page + 1) % journal_page_count;
+    journal_head head = {journal_seq + 1, JOURNAL_MAGIC};
+    
+    TRACE("compact journal: %d open transactions\r\n", journal_open_count);
+    for (int i = 0; i < journal_open_count; ++i)
+    {
+        image[i].id = journal_open[i].id;
+        image[i].state = RECORD_STATE(journal_open[i].state, 
+                                      journal_open[i].result, 
+                                      journal_open[i].slot);
+    }
+
+    if (!flash_page_write(journal_pages[page], image, 
+                          journal_open_count * sizeof(journal_record)) ||
+        !flash_page_program((uint32_t)JOURNAL_HEAD(page), &head, 
+                            sizeof(head)))
+    {
+        TRACE("compact journal failed\r\n");
+        return FALSE;
+    }
+
+    journal_page = page;
+    journal_seq ++;
+    journal_tail = journal_open_count;
+    return TRUE;
+}
+
+/**
+ * @brief append records in one flash program sequence
+ * @param records - records to append
+ * @param count - record count
+ * @return TRUE if records are written
+ */
+static bool journal_append(journal_record *records, uint8_t count)
+{
+    if ((journal_tail + count > JOURNAL_RECORDS) && !journal_compact())
+    {
+        return FALSE;
+    }
+    assert_param(journal_tail + count <= JOURNAL_RECORDS);
+
+    if (!flash_page_program(journal_pages[journal_page] + 
+                            journal_tail * sizeof(journal_record), 
+                            records, count * sizeof(journal_record)))
+    {
+        /* broken records are skipped by replay */
+        TRACE("append journal failed\r\n");
+        journal_tail += count;
+        return FALSE;
+    }
+    journal_tail += count;
+    
+    for (int i = 0; i < count; ++i)
+    {
+        journal_apply(records[i].id, records[i].state >> 8, 
+                      records[i].state & 0xff);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief append same state for slots of one transaction
+ * @param id - transaction id
+ * @param state - transaction state
+ * @param result - transaction result
+ * @param slots - slot numbers
+ * @param count - slot count
+ * @return TRUE if all records are written
+ */
+static bool journal_append_slots(uint16_t id, uint8_t state, uint8_t result,
+                                 const uint8_t *slots, uint8_t count)
+{
+    journal_record records[JOURNAL_BATCH_MAX];
+    uint8_t num = 0;
+    bool ret = TRUE;
+    
+    while (count > 0)
+    {
+        num = MIN(count, JOURNAL_BATCH_MAX);
+        for (int i = 0; i < num; ++i)
+        {
+            records[i].id = id;
+            records[i].state = RECORD_STATE(state, result, slots[i]);
+        }
+        ret = journal_append(records, num) && ret;
+        slots += num;
+        count -= num;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief initialize journal, replay records of active page
+ */
+void journal_init(void)
+{
+    const journal_record *record = NULL;
+    const journal_head *head[2] = {JOURNAL_HEAD(0), JOURNAL_HEAD(1)};
+    bool valid[2];
+
+    TRACE("initialize journal...\r\n");
+    xJournalMutex = xSemaphoreCreateMutex();
+    journal_page_count = flash_migrated() ? 2 : 1;
+    for (int i = 0; i < 2; ++i)
+    {
+        valid[i] = (i < journal_page_count) &&
+                   (JOURNAL_MAGIC == head[i]->magic);
+    }
+
+    if (valid[0] && valid[1])
+    {
+        journal_page = ((int16_t)(head[1]->seq - head[0]->seq) > 0) ? 1 : 0;
+    }
+    else
+    {
+        journal_page = valid[1] ? 1 : 0;
+    }
+    journal_seq = valid[journal_page] ? head[journal_page]->seq : 0;
+
+    record = (const journal_record *)journal_pages[journal_page];
+    journal_open_count = 0;
+    journal_tail = JOURNAL_RECORDS;
+    for (int i = 0; i < JOURNAL_RECORDS; ++i, ++record)
+    {
+        if ((JOURNAL_ERASED == record->id) && 
+            (JOURNAL_ERASED == record->state))
+        {
+            journal_tail = i;
+            break;
+        }
+
+        if (JOURNAL_ERASED != record->state)
+        {
+            journal_apply(record->id, record->state >> 8, 
+                          record->state & 0xff);
+            journal_next = record->id + 1;
+        }
+    }
+    TRACE("journal: page %d of %d, %d records, %d open transactions\r\n", 
+          journal_page, journal_page_count, journal_tail, journal_open_count);
+}
+
+/**
+ * @brief check if page is taken by journal
+ * @param addr - page address
+ * @return TRUE if page is journal page with valid head
+ */
+bool journal_owns(uint32_t addr)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        if ((journal_pages[i] == addr) && 
+            (JOURNAL_MAGIC == JOURNAL_HEAD(i)->magic))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * @brief record received transaction with new transaction id, must be 
+ *        called before transaction is acknowledged
+ * @param slots - slot numbers
+ * @param count - slot count
+ * @param id - transaction id, JOURNAL_NO_ID if nothing is recorded
+ * @return TRUE if transaction is recorded
+ */
+bool journal_receive(const uint8_t *slots, uint8_t count, uint16_t *id)
+{
+    bool ret = FALSE;
+    assert_param(NULL != id);
+    
+    *id = JOURNAL_NO_ID;
+    xSemaphoreTake(xJournalMutex, portMAX_DELAY);
+    if (journal_open_count + count <= JOURNAL_OPEN_MAX)
+    {
+        while (!journal_id_free(journal_next))
+        {
+            journal_next ++;
+        }
+        *id = journal_next++;
+        ret = journal_append_slots(*id, JOURNAL_RECEIVED, 0, slots, count);
+    }
+    xSemaphoreGive(xJournalMutex);
+
+    return ret;
+}
+
+/**
+ * @brief record started slots, must be called before motor runs
+ * @param id - transaction id
+ * @param slots - slot numbers
+ * @param count - slot count
+ */
+void journal_start(uint16_t id, const uint8_t *slots, uint8_t count)
+{
+    if (JOURNAL_NO_ID == id)
+    {
+        return ;
+    }
+    
+    xSemaphoreTake(xJournalMutex, portMAX_DELAY);
+    journal_append_slots(id, JOURNAL_STARTED, 0, slots, count);
+    xSemaphoreGive(xJournalMutex);
+}
+
+/**
+ * @brief record completed slot
+ * @param id - transaction id
+ * @param slot - slot number
+ * @param result - vend result
+ * @return TRUE if slot is recorded, entry is kept otherwise
+ */
+bool journal_complete(uint16_t id, uint8_t slot, uint8_t result)
+{
+    bool ret = FALSE;
+
+    if (JOURNAL_NO_ID == id)
+    {
+        return TRUE;
+    }
+    
+    xSemaphoreTake(xJournalMutex, portMAX_DELAY);
+    ret = journal_append_slots(id, JOURNAL_COMPLETED, result, &slot, 1);
+    xSemaphoreGive(xJournalMutex);
+
+    return ret;
+}
+
+/**
+ * @brief record reported slot, transaction is closed
+ * @param id - transaction id
+ * @param slot - slot number
+ * @return TRUE if slot is recorded, entry is kept otherwise
+ */
+bool journal_report(uint16_t id, uint8_t slot)
+{
+    bool ret = FALSE;
+
+    if (JOURNAL_NO_ID == id)
+    {
+        return TRUE;
+    }
+    
+    xSemaphoreTake(xJournalMutex, portMAX_DELAY);
+    ret = journal_append_slots(id, JOURNAL_REPORTED, 0, &slot, 1);
+    xSemaphoreGive(xJournalMutex);
+
+    return ret;
+}
+
+/**
+ * @brief get open transactions in specified state
+ * @param state - transaction state
+ * @param entries - entries buffer
+ * @param max - max entries
+ * @return entry count
+ */
+uint8_t journal_pending(uint8_t state, journal_entry *entries, uint8_t max)
+{
+    uint8_t count = 0;
+    
+    xSemaphoreTake(xJournalMutex, portMAX_DELAY);
+    for (int i = 0; (i < journal_open_count) && (count < max); ++i)
+    {
+        if (journal_open[i].state == state)
+        {
+            entries[count++] = journal_open[i];
+        }
+    }
+    xSemaphoreGive(xJournalMutex);
+
+    return count;
+}
+
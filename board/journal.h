@@ -0,0 +1,43 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _JOURNAL_H_
+  #define _JOURNAL_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* transaction without journal */
+#define JOURNAL_NO_ID        (0)
+
+/* transaction state */
+#define JOURNAL_RECEIVED     (0x01)
+#define JOURNAL_STARTED      (0x02)
+#define JOURNAL_COMPLETED    (0x03)
+#define JOURNAL_REPORTED     (0x04)
+
+/* open transaction of one slot */
+typedef struct
+{
+    uint16_t id;
+    uint8_t slot;
+    uint8_t state;
+    uint8_t result;
+}journal_entry;
+
+void journal_init(void);
+bool journal_owns(uint32_t addr);
+bool journal_receive(const uint8_t *slots, uint8_t count, uint16_t *id);
+void journal_start(uint16_t id, const uint8_t *slots, uint8_t count);
+bool journal_complete(uint16_t id, uint8_t slot, uint8_t result);
+bool journal_report(uint16_t id, uint8_t slot);
+uint8_t journal_pending(uint8_t state, journal_entry *entries, uint8_t max);
+
+END_DECLS
+
+#endif /* _JOURNAL_H_ */
@@ -0,0 +1,401 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <string.h>
+#include "kvstore.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "assert.h"
+#include "trace.h"
+#include "stm32f10x_cfg.h"
+#include "crc32.h"
+#include "flash_page.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[kv]"
+
+/* 0x800E800 and 0x800EC00, 1K each. records are appended to active page,
+   live records are copied to the other page when it is full */
+#define KV_ADDR              0x800E800
+#define KV_PAGE_SIZE         1024
+#define KV_PAGE_ADDR(page)   (KV_ADDR + (page) * KV_PAGE_SIZE)
+
+/* page header is programmed after live records are copied, page without
+   header is a broken collection and ignored. old page is not erased after
+   collection, so every collection costs one erase. newer sequence wins if
+   both pages are valid */
+typedef struct
+{
+    uint32_t seq;
+    uint16_t version;
+    uint16_t magic;
+}kv_page_head;
+#define KV_MAGIC             (0x4b56)
+#define KV_VERSION           (1)
+
+/* record is head, value padded to word and crc of them. crc is programmed
+   last, so record with bad crc is a broken write and skipped */
+typedef struct
+{
+    uint8_t key;
+    /* value length, 0 deletes key */
+    uint8_t len;
+    uint16_t reserved;
+}kv_head;
+#define KV_ERASED            (0xff)
+#define KV_WORDS(len)        ((sizeof(kv_head) + (len) + 3) >> 2)
+#define KV_SIZE(len)         ((KV_WORDS(len) + 1) << 2)
+
+typedef union
+{
+    kv_head head;
+    uint32_t words[KV_WORDS(KV_VALUE_MAX) + 1];
+}kv_record;
+
+static uint8_t kv_page = 0;
+static uint32_t kv_seq = 0;
+/* offset of next free record in active page */
+static uint16_t kv_tail = 0;
+/* offset of latest record of key, 0 if key is not stored */
+static uint16_t kv_index[KV_KEY_MAX];
+static xSemaphoreHandle xKvMutex = NULL;
+
+/**
+ * @brief lock store, configure is loaded before scheduler starts
+ */
+static __INLINE void kv_lock(void)
+{
+    if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+    {
+        xSemaphoreTake(xKvMutex, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief unlock store
+ */
+static __INLINE void kv_unlock(void)
+{
+    if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+    {
+        xSemaphoreGive(xKvMutex);
+    }
+}
+
+/**
+ * @brief get record in active page
+ * @param offset - record offset
+ * @return record head
+ */
+static __INLINE const kv_head *kv_at(uint16_t offset)
+{
+    return (const kv_head *)(KV_PAGE_ADDR(kv_page) + offset);
+}
+
+/**
+ * @brief calculate crc of record head and value by hardware
+ * @param words - record words
+ * @param count - word count
+ * @return crc
+ */
+static __INLINE uint32_t kv_crc(const uint32_t *words, uint8_t count)
+{
+    return crc32_words(words, count);
+}
+
+/**
+ * @brief check crc of record in flash
+ * @param head - record head
+ * @return TRUE if record is complete
+ */
+static bool kv_valid(const kv_head *head)
+{
+    const uint32_t *words = (const uint32_t *)head;
+    uint8_t count = KV_WORDS(head->len);
+    return (words[count] == kv_crc(words, count));
+}
+
+/**
+ * @brief erase page and program page header
+ * @param page - page number
+ * @param seq - page sequence
+ */
+static void kv_format(uint8_t page, uint32_t seq)
+{
+    kv_page_head head = {seq, KV_VERSION, KV_MAGIC};
+    flash_page_erase(KV_PAGE_ADDR(page));
+    flash_page_program(KV_PAGE_ADDR(page), &head, sizeof(head));
+}
+
+/**
+ * @brief build index of active page, find free record
+ */
+static void kv_scan(void)
+{
+    const kv_head *head = NULL;
+    uint16_t offset = sizeof(kv_page_head);
+
+    memset(kv_index, 0, sizeof(kv_index));
+    while (offset + KV_SIZE(0) <= KV_PAGE_SIZE)
+    {
+        head = kv_at(offset);
+        if ((KV_ERASED == head->key) && (KV_ERASED == head->len))
+        {
+            break;
+        }
+
+        /* garbage head, page is collected at next write */
+        if ((0 == head->key) || (head->key >= KV_KEY_MAX) ||
+            (head->len > KV_VALUE_MAX) ||
+            (offset + KV_SIZE(head->len) > KV_PAGE_SIZE))
+        {
+            offset = KV_PAGE_SIZE;
+            break;
+        }
+
+        if (kv_valid(head))
+        {
+            kv_index[head->key] = (0 == head->len) ? 0 : offset;
+        }
+        offset += KV_SIZE(head->len);
+    }
+    kv_tail = offset;
+}
+
+/**
+ * @brief copy live records to the other page and make it active
+ * @return free bytes of new active page
+ */
+static uint16_t kv_collect(void)
+{
+    uint8_t page = kv_page ^ 1;
+    uint32_t addr = KV_PAGE_ADDR(page) + sizeof(kv_page_head);
+    uint16_t index[KV_KEY_MAX];
+    const kv_head *head = NULL;
+    kv_page_head page_head = {kv_seq + 1, KV_VERSION, KV_MAGIC};
+
+    flash_page_erase(KV_PAGE_ADDR(page));
+    memset(index, 0, sizeof(index));
+    for (int key = 1; key < KV_KEY_MAX; ++key)
+    {
+        if (0 != kv_index[key])
+        {
+            head = kv_at(kv_index[key]);
+            index[key] = addr - KV_PAGE_ADDR(page);
+            flash_page_program(addr, head, KV_SIZE(head->len));
+            addr += KV_SIZE(head->len);
+        }
+    }
+    flash_page_program(KV_PAGE_ADDR(page), &page_head, sizeof(page_head));
+
+    kv_page = page;
+    kv_seq ++;
+    kv_tail = addr - KV_PAGE_ADDR(page);
+    memcpy(kv_index, index, sizeof(index));
+    TRACE("collected to page %d, %d bytes used\r\n", kv_page, kv_tail);
+
+    return KV_PAGE_SIZE - kv_tail;
+}
+
+/**
+ * @brief append record to active page, should be called with lock held
+ * @param key - key
+ * @param value - value
+ * @param len - value length, 0 deletes key
+ * @return TRUE if record is written
+ */
+static bool kv_append(uint8_t key, const void *value, uint8_t len)
+{
+    kv_record record;
+    uint8_t count = KV_WORDS(len);
+    uint16_t offset = 0;
+
+    if ((KV_PAGE_SIZE - kv_tail < KV_SIZE(len)) &&
+        (kv_collect() < KV_SIZE(len)))
+    {
+        TRACE("no space for key %d\r\n", key);
+        return FALSE;
+    }
+
+    memset(&record, 0xff, sizeof(record));
+    record.head.key = key;
+    record.head.len = len;
+    if (len > 0)
+    {
+        memcpy(&record.words[1], value, len);
+    }
+    record.words[count] = kv_crc(record.words, count);
+
+    offset = kv_tail;
+    kv_tail += KV_SIZE(len);
+    if (!flash_page_program(KV_PAGE_ADDR(kv_page) + offset, &record,
+                            KV_SIZE(len)))
+    {
+        TRACE("verify key %d failed\r\n", key);
+        return FALSE;
+    }
+
+    kv_index[key] = (0 == len) ? 0 : offset;
+    return TRUE;
+}
+
+/**
+ * @brief initialize store, find active page and build index. should be
+ *        called before scheduler starts
+ */
+void kv_init(void)
+{
+    const kv_page_head *head[2] =
+    {
+        (const kv_page_head *)KV_PAGE_ADDR(0),
+        (const kv_page_head *)KV_PAGE_ADDR(1),
+    };
+    bool valid[2];
+
+    xKvMutex = xSemaphoreCreateMutex();
+    assert_param(NULL != xKvMutex);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        valid[i] = (KV_MAGIC == head[i]->magic) &&
+                   (KV_VERSION == head[i]->version);
+    }
+
+    if (valid[0] && valid[1])
+    {
+        kv_page = ((int32_t)(head[1]->seq - head[0]->seq) > 0) ? 1 : 0;
+    }
+    else if (valid[0] || valid[1])
+    {
+        kv_page = valid[0] ? 0 : 1;
+    }
+    else
+    {
+        kv_page = 0;
+        kv_format(0, 0);
+    }
+
+    kv_seq = head[kv_page]->seq;
+    kv_scan();
+}
+
+/**
+ * @brief get value of key
+ * @param key - key
+ * @param value - value buffer
+ * @param size - buffer size
+ * @return value length copied, 0 if key is not stored
+ */
+uint8_t kv_get(uint8_t key, void *value, uint8_t size)
+{
+    const kv_head *head = NULL;
+    uint8_t len = 0;
+    assert_param((key > 0) && (key < KV_KEY_MAX));
+
+    kv_lock();
+    if (0 != kv_index[key])
+    {
+        head = kv_at(kv_index[key]);
+        len = MIN(head->len, size);
+        memcpy(value, head + 1, len);
+    }
+    kv_unlock();
+
+    return len;
+}
+
+/**
+ * @brief check if key is stored
+ * @param key - key
+ * @return TRUE if key is stored
+ */
+bool kv_exists(uint8_t key)
+{
+    assert_param((key > 0) && (key < KV_KEY_MAX));
+    return (0 != kv_index[key]);
+}
+
+/**
+ * @brief set value of key, same value is not written again
+ * @param key - key
+ * @param value - value
+ * @param len - value length, 1 to KV_VALUE_MAX
+ * @return TRUE if value is stored
+ */
+bool kv_set(uint8_t key, const void *value, uint8_t len)
+{
+    const kv_head *head = NULL;
+    bool ret = TRUE;
+    assert_param((key > 0) && (key < KV_KEY_MAX));
+    assert_param((len > 0) && (len <= KV_VALUE_MAX));
+
+    kv_lock();
+    if (0 != kv_index[key])
+    {
+        head = kv_at(kv_index[key]);
+        if ((head->len == len) && (0 == memcmp(head + 1, value, len)))
+        {
+            kv_unlock();
+            return TRUE;
+        }
+    }
+    ret = kv_append(key, value, len);
+    kv_unlock();
+
+    return ret;
+}
+
+/**
+ * @brief delete key
+ * @param key - key
+ * @return TRUE if key is deleted
+ */
+bool kv_delete(uint8_t key)
+{
+    bool ret = TRUE;
+    assert_param((key > 0) && (key < KV_KEY_MAX));
+
+    kv_lock();
+    if (0 != kv_index[key])
+    {
+        ret = kv_append(key, NULL, 0);
+    }
+    kv_unlock();
+
+    return ret;
+}
+
+/**
+ * @brief delete all keys
+ */
+void kv_clear(void)
+{
+    kv_lock();
+    /* empty page with newer sequence replaces active page */
+    kv_seq ++;
+    kv_page ^= 1;
+    kv_format(kv_page, kv_seq);
+    kv_tail = sizeof(kv_page_head);
+    memset(kv_index, 0, sizeof(kv_index));
+    kv_unlock();
+}
+
+/**
+ * @brief get usage of store
+ * @param info - store usage
+ */
+void kv_get_info(kv_info *info)
+{
+    assert_param(NULL != info);
+    kv_lock();
+    /* page is erased once at format and once every collection */
+    info->erases = kv_seq + 1;
+    info->used = kv_tail;
+    info->size = KV_PAGE_SIZE;
+    kv_unlock();
+}
@@ -0,0 +1,39 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _KVSTORE_H_
+  #define _KVSTORE_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* keys are 1 to KV_KEY_MAX - 1 */
+#define KV_KEY_MAX       (16)
+#define KV_VALUE_MAX     (64)
+
+/* store usage */
+typedef struct
+{
+    /* page erases since first start */
+    uint32_t erases;
+    /* bytes used in active page and page size */
+    uint16_t used;
+    uint16_t size;
+}kv_info;
+
+void kv_init(void);
+uint8_t kv_get(uint8_t key, void *value, uint8_t size);
+bool kv_exists(uint8_t key);
+bool kv_set(uint8_t key, const void *value, uint8_t len);
+bool kv_delete(uint8_t key);
+void kv_clear(void);
+void kv_get_info(kv_info *info);
+
+END_DECLS
+
+#endif /* _KVSTORE_H_ */
@@ -5,67 +5,216 @@
 *
 * See the COPYING file for the terms of usage and distribution.
 */
+#include <string.h>
 #include "led_motor.h"
+#include "FreeRTOS.h"
+#include "task.h"
 #include "assert.h"
 #include "trace.h"
-#include "cm3_core.h"
-#include "pinconfig.h"
+#include "global.h"
+#include "stm32f10x_cfg.h"
+#include "cabinet.h"
+#include "hc595.h"
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[led_motor]"
 
-#define LED_NUM 10
+#define LED_NUM     MOTOR_NUM
+#define LED_WORDS   ((CABINET_LED_BITS + 31) >> 5)
 
-/* led status */
-static uint16_t led_status = 0;
+/* binary code modulation, bit plane n is shown for 2^n time units. TIM4
+   clock is 72MHz and counts at 1MHz, 63 units of 79us make a frame of about
+   5ms(200Hz) */
+#define LED_TIMER           TIM4
+#define LED_UNIT_US         (79)
+#define LED_FRAME_HZ        (1000000 / (LED_UNIT_US * LED_MOTOR_LEVEL_MAX))
+
+/* level is 8.8 fixed point for slow fades */
+#define LED_LEVEL_SHIFT     (8)
+
+/* highlighted led breathes between 1/8 and full level in one second */
+#define LED_BREATH_FRAMES   (LED_FRAME_HZ)
+#define LED_BREATH_MIN      (LED_MOTOR_LEVEL_MAX >> 3)
+
+/* frame written by application */
+static uint16_t led_level[LED_NUM];
+static uint16_t led_step[LED_NUM];
+static uint8_t led_target[LED_NUM];
+static uint32_t led_highlight[LED_WORDS];
+
+/* bit planes, one buffer is shown while the other one is rendered */
+static uint32_t led_planes[2][LED_MOTOR_LEVEL_BITS][LED_WORDS];
+static uint8_t led_front = 0;
+static bool led_back_ready = FALSE;
+/* rendered frame needs timer to show */
+static bool led_back_active = FALSE;
+static uint8_t led_plane = 0;
+static uint16_t led_frame = 0;
+static bool led_running = FALSE;
+
+static hc595_chain led_chain;
 
 
 /**
- * @brief shift register transition
+ * @brief move fading leds one frame toward target level
  */
-static __INLINE void sh_transition(void)
+static void led_animate(void)
 {
-    pin_reset("LED_SH");
-    __NOP();
-    __NOP();
-    pin_set("LED_SH");
-    __NOP();
-    __NOP();
+    uint16_t target = 0;
+    for (int i = 0; i < LED_NUM; ++i)
+    {
+        target = (uint16_t)led_target[i] << LED_LEVEL_SHIFT;
+        if (led_level[i] < target)
+        {
+            led_level[i] = MIN(led_level[i] + led_step[i], target);
+        }
+        else if (led_level[i] > target)
+        {
+            led_level[i] = (led_level[i] - target > led_step[i]) ?
+                           (led_level[i] - led_step[i]) : target;
+        }
+    }
 }
 
 /**
- * @brief storage register transition
+ * @brief get breathing level of highlighted led
+ * @return current level
  */
-static __INLINE void st_transition(void)
+static uint8_t led_breath(void)
 {
-    pin_reset("LED_ST");
-    __NOP();
-    __NOP();
-    pin_set("LED_ST");
-    __NOP();
-    __NOP();
+    uint16_t phase = led_frame % LED_BREATH_FRAMES;
+    if (phase > (LED_BREATH_FRAMES >> 1))
+    {
+        phase = LED_BREATH_FRAMES - phase;
+    }
+
+    return LED_BREATH_MIN + (LED_MOTOR_LEVEL_MAX - LED_BREATH_MIN) * phase /
+           (LED_BREATH_FRAMES >> 1);
 }
 
 /**
- * @brief send data to 74hc595
- * @param data - data to send
+ * @brief render frame into bit planes
+ * @param planes - bit planes to render
+ * @return TRUE: frame needs timer to show, FALSE: all bit planes are same
  */
-static void hc595_senddata(uint16_t data)
+static bool led_render(uint32_t planes[][LED_WORDS])
 {
-    for (int i = 0; i < 16; ++i)
+    bool active = FALSE;
+    uint8_t level = 0;
+    uint8_t breath = led_breath();
+
+    memset(planes, 0, sizeof(led_planes[0]));
+    for (int i = 0; i < LED_NUM; ++i)
     {
-        if (0 != (data & 0x8000))
+        if (slot_test(led_highlight, i))
         {
-            pin_reset("LED_DATA");
+            level = breath;
+            active = TRUE;
         }
         else
         {
-            pin_set("LED_DATA");
+            level = led_level[i] >> LED_LEVEL_SHIFT;
+            if ((led_level[i] !=
+                 ((uint16_t)led_target[i] << LED_LEVEL_SHIFT)) ||
+                ((0 != level) && (LED_MOTOR_LEVEL_MAX != level)))
+            {
+                active = TRUE;
+            }
+        }
+
+        for (int n = 0; n < LED_MOTOR_LEVEL_BITS; ++n)
+        {
+            if (0 != (level & (1 << n)))
+            {
+                slot_set(planes[n], i);
+            }
         }
-        data <<= 1;
-        sh_transition();
     }
-    st_transition();
+
+    return active;
+}
+
+/**
+ * led frame timer interrupt handler
+ */
+void TIM4_IRQHandler(void)
+{
+    TIM_ClrFlag(LED_TIMER, TIM_FLAG_UPDATE);
+
+    if (0 == led_plane)
+    {
+        if (led_back_ready)
+        {
+            led_front ^= 1;
+            led_back_ready = FALSE;
+        }
+
+        if (!led_back_active)
+        {
+            /* static frame, all bit planes are same */
+            hc595_write(&led_chain, led_planes[led_front][0],
+                        CABINET_LED_BITS);
+            TIM_Enable(LED_TIMER, FALSE);
+            led_running = FALSE;
+            return ;
+        }
+    }
+
+    hc595_write(&led_chain, led_planes[led_front][led_plane],
+                CABINET_LED_BITS);
+    TIM_SetAutoReload(LED_TIMER, (LED_UNIT_US << led_plane) - 1);
+
+    if (++led_plane >= LED_MOTOR_LEVEL_BITS)
+    {
+        /* render next frame while the longest plane is shown */
+        led_plane = 0;
+        led_frame ++;
+        led_animate();
+        led_back_active = led_render(led_planes[led_front ^ 1]);
+        led_back_ready = TRUE;
+    }
+}
+
+/**
+ * @brief render frame changed by application into back buffer and start
+ *        timer if stopped, should be called in critical section
+ */
+static void led_refresh(void)
+{
+    led_back_active = led_render(led_planes[led_front ^ 1]);
+    led_back_ready = TRUE;
+    if (!led_running)
+    {
+        led_plane = 0;
+        led_running = TRUE;
+        TIM_SetCounter(LED_TIMER, 0);
+        TIM_SetAutoReload(LED_TIMER, LED_UNIT_US - 1);
+        TIM_Enable(LED_TIMER, TRUE);
+    }
+}
+
+/**
+ * @brief set target level of led
+ * @param num - led number
+ * @param level - target level
+ * @param frames - fade frames, 0 means immediately
+ */
+static void led_set_target(uint8_t num, uint8_t level, uint16_t frames)
+{
+    uint16_t target = (uint16_t)level << LED_LEVEL_SHIFT;
+    uint16_t diff = 0;
+
+    led_target[num] = level;
+    if (0 == frames)
+    {
+        led_level[num] = target;
+    }
+    else
+    {
+        diff = (led_level[num] > target) ? (led_level[num] - target) :
+               (target - led_level[num]);
+        led_step[num] = MAX(diff / frames, 1);
+    }
 }
 
 /**
@@ -74,32 +223,50 @@ static void hc595_senddata(uint16_t data)
 void led_motor_init(void)
 {
     TRACE("initialieze motor led...\r\n");
-    led_status = 0;
-    hc595_senddata(led_status);
+    /* leds are on when output is low */
+    hc595_init(&led_chain, PIN_LED_DATA, PIN_LED_ST, PIN_LED_SH, TRUE);
+    memset(led_level, 0, sizeof(led_level));
+    memset(led_target, 0, sizeof(led_target));
+    memset(led_highlight, 0, sizeof(led_highlight));
+    memset(led_planes, 0, sizeof(led_planes));
+    hc595_write(&led_chain, led_planes[0][0], CABINET_LED_BITS);
+
+    RCC_APB1PeriphReset(RCC_APB1_RESET_TIM4, TRUE);
+    RCC_APB1PeriphReset(RCC_APB1_RESET_TIM4, FALSE);
+    RCC_APB1PeripClockEnable(RCC_APB1_ENABLE_TIM4, TRUE);
+    TIM_SetCounterMode(LED_TIMER, TIM_COUNTER_UP);
+    TIM_SetPrescaler(LED_TIMER, 71);
+    TIM_SetAutoReload(LED_TIMER, LED_UNIT_US - 1);
+    /* load prescaler */
+    TIM_EnableUpdateOnlyOverflow(LED_TIMER, TRUE);
+    TIM_GenerateUpdate(LED_TIMER);
+    TIM_ClrFlag(LED_TIMER, TIM_FLAG_UPDATE);
+    TIM_EnableInt(LED_TIMER, TIM_IT_UPDATE, TRUE);
+
+    NVIC_Config nvicConfig = {TIM4_IRQChannel, LED_TIMER_PRIORITY, 0, TRUE};
+    NVIC_Init(&nvicConfig);
 }
 
 /**
  * @brief turn on led
- * @param num - led number(0-15)
+ * @param num - led number
  */
 void led_motor_turn_on(uint8_t num)
 {
     assert_param(num < LED_NUM);
     TRACE("turn on led: %d\r\n", num);
-    led_status |= (1 << num);
-    hc595_senddata(led_status);
+    led_motor_set_level(num, LED_MOTOR_LEVEL_MAX, 0);
 }
 
 /**
  * @brief turn off led
- * @param num - led number(0-15)
+ * @param num - led number
  */
 void led_motor_turn_off(uint8_t num)
 {
     assert_param(num < LED_NUM);
     TRACE("turn off led: %d\r\n", num);
-    led_status &= ~(1 << num);
-    hc595_senddata(led_status);
+    led_motor_set_level(num, 0, 0);
 }
 
 /**
@@ -108,8 +275,7 @@ void led_motor_turn_off(uint8_t num)
 void led_motor_all_on(void)
 {
     TRACE("turn on all led\r\n");
-    led_status = 0xffff;
-    hc595_senddata(led_status);
+    led_motor_all_level(LED_MOTOR_LEVEL_MAX, 0);
 }
 
 /**
@@ -118,6 +284,65 @@ void led_motor_all_on(void)
 void led_motor_all_off(void)
 {
     TRACE("turn off all led\r\n");
-    led_status = 0;
-    hc595_senddata(led_status);
+    led_motor_all_level(0, 0);
+}
+
+/**
+ * @brief set led brightness, shown from next frame
+ * @param num - led number
+ * @param level - brightness level
+ * @param fade - fade time(ms), 0 means immediately
+ */
+void led_motor_set_level(uint8_t num, uint8_t level, uint16_t fade)
+{
+    assert_param(num < LED_NUM);
+    assert_param(level <= LED_MOTOR_LEVEL_MAX);
+    uint16_t frames = (uint32_t)fade * LED_FRAME_HZ / 1000;
+
+    taskENTER_CRITICAL();
+    led_set_target(num, level, frames);
+    led_refresh();
+    taskEXIT_CRITICAL();
 }
+
+/**
+ * @brief set all led brightness, shown from next frame
+ * @param level - brightness level
+ * @param fade - fade time(ms), 0 means immediately
+ */
+void led_motor_all_level(uint8_t level, uint16_t fade)
+{
+    assert_param(level <= LED_MOTOR_LEVEL_MAX);
+    uint16_t frames = (uint32_t)fade * LED_FRAME_HZ / 1000;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < LED_NUM; ++i)
+    {
+        led_set_target(i, level, frames);
+    }
+    led_refresh();
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief highlight led by breathing, used for selected slot
+ * @param num - led number
+ * @param on - highlight or not
+ */
+void led_motor_highlight(uint8_t num, bool on)
+{
+    assert_param(num < LED_NUM);
+
+    taskENTER_CRITICAL();
+    if (on)
+    {
+        slot_set(led_highlight, num);
+    }
+    else
+    {
+        slot_clear(led_highlight, num);
+    }
+    led_refresh();
+    taskEXIT_CRITICAL();
+}
+
@@ -12,14 +12,20 @@
 
 BEGIN_DECLS
 
+/* brightness level of motor led */
+#define LED_MOTOR_LEVEL_BITS    (6)
+#define LED_MOTOR_LEVEL_MAX     ((1 << LED_MOTOR_LEVEL_BITS) - 1)
+
 void led_motor_init(void);
 void led_motor_turn_on(uint8_t num);
 void led_motor_turn_off(uint8_t num);
 void led_motor_all_on(void);
 void led_motor_all_off(void);
+void led_motor_set_level(uint8_t num, uint8_t level, uint16_t fade);
+void led_motor_all_level(uint8_t level, uint16_t fade);
+void led_motor_highlight(uint8_t num, bool on);
 
 END_DECLS
 
 
 #endif /* _LED_MOTOR_H_ */
-
@@ -5,61 +5,135 @@
 *
 * See the COPYING file for the terms of usage and distribution.
 */
-#include <string.h>
 #include "led_net.h"
 #include "FreeRTOS.h"
-#include "task.h"
+#include "timers.h"
 #include "assert.h"
 #include "trace.h"
 #include "pinconfig.h"
-#include "global.h"
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[led_net]"
 
+/* patterns are played in steps of 100ms, bit n is led status of step n */
+#define LED_STEP_TIME       (100 / portTICK_PERIOD_MS)
 typedef struct
 {
-    const char *name;
-    led_action action;
+    uint32_t bits;
+    uint8_t steps;
+}led_pattern;
+
+static const led_pattern led_patterns[] =
+{
+    /* on */
+    {0x01, 1},
+    /* off */
+    {0x00, 1},
+    /* flash, 300ms on and 300ms off */
+    {0x07, 6},
+    /* double blink, two 100ms blinks in one second */
+    {0x05, 10},
+};
+
+/* error code blinks 200ms on and 200ms off, then pauses 1.2s */
+#define LED_CODE_BLINK      (0x03)
+#define LED_CODE_BLINK_STEPS (4)
+#define LED_CODE_PAUSE_STEPS (12)
+#define LED_ACTION_CODE     (0xff)
+
+/* command is applied in timer task, so led status needs no lock */
+#define LED_CMD(led, action, code)  (((uint32_t)(led) << 16) | \
+                                     ((uint32_t)(action) << 8) | (code))
+#define LED_CMD_WAIT        (10 / portTICK_PERIOD_MS)
+
+typedef struct
+{
+    pin_id id;
+    led_pattern pattern;
+    uint8_t step;
 }led_status;
 
-static led_status leds[] = 
+static led_status leds[LED_ID_COUNT] =
 {
-    {"LED_ERROR", off},
-    {"LED_NET", off},
-    {"LED_MQTT", off}
+    {PIN_LED_ERROR},
+    {PIN_LED_NET},
+    {PIN_LED_MQTT},
 };
 
+static TimerHandle_t xLedTimer = NULL;
+static bool led_timer_on = FALSE;
+
 /**
- * @brief led control task
- * @param pvParameters - task parameters
+ * @brief led pattern timer, stops itself when no led is blinking
+ * @param xTimer - timer handle
  */
-static void vLed(void *pvParameters)
+static void vLedTimer(TimerHandle_t xTimer)
 {
-    for (;;)
+    bool blinking = FALSE;
+    led_status *led = leds;
+
+    for (int i = 0; i < LED_ID_COUNT; ++i, ++led)
     {
-        for (int i = 0; i < sizeof(leds) / sizeof(leds[0]); ++i)
+        if (led->pattern.steps > 1)
         {
-            switch (leds[i].action)
+            if (++led->step >= led->pattern.steps)
             {
-            case on:
-                pin_set(leds[i].name);
-                break;
-            case off:
-                pin_reset(leds[i].name);
-                break;
-            case flash:
-                pin_toggle(leds[i].name);
-                break;
-            default:
-                break;
+                led->step = 0;
             }
-            
+            pin_write(led->id,
+                      0 != (led->pattern.bits & (1ul << led->step)));
+            blinking = TRUE;
         }
-        vTaskDelay(300 / portTICK_PERIOD_MS);
+    }
+
+    if (!blinking && (pdPASS == xTimerStop(xTimer, 0)))
+    {
+        led_timer_on = FALSE;
     }
 }
 
+/**
+ * @brief apply led command in timer task
+ * @param pvParameter1 - not used
+ * @param ulParameter2 - led command
+ */
+static void led_apply(void *pvParameter1, uint32_t ulParameter2)
+{
+    led_status *led = &leds[(ulParameter2 >> 16) & 0xff];
+    uint8_t action = (ulParameter2 >> 8) & 0xff;
+    uint8_t code = ulParameter2 & 0xff;
+    led_pattern pattern;
+
+    if (LED_ACTION_CODE == action)
+    {
+        pattern.bits = 0;
+        for (int i = 0; i < code; ++i)
+        {
+            pattern.bits |= (LED_CODE_BLINK << (i * LED_CODE_BLINK_STEPS));
+        }
+        pattern.steps = code * LED_CODE_BLINK_STEPS + LED_CODE_PAUSE_STEPS;
+    }
+    else
+    {
+        pattern = led_patterns[action];
+    }
+
+    /* same pattern keeps its phase */
+    if ((pattern.bits == led->pattern.bits) &&
+        (pattern.steps == led->pattern.steps))
+    {
+        return ;
+    }
+
+    led->pattern = pattern;
+    led->step = 0;
+    pin_write(led->id, 0 != (pattern.bits & 0x01));
+    if ((pattern.steps > 1) && !led_timer_on &&
+        (pdPASS == xTimerStart(xLedTimer, 0)))
+    {
+        led_timer_on = TRUE;
+    }
+}
 
 /**
  * @brief initialize net led
@@ -67,29 +141,41 @@ static void vLed(void *pvParameters)
 void led_net_init(void)
 {
     TRACE("initialize net led...\r\n");
-    for (int i = 0; i < sizeof(leds) / sizeof(leds[0]); ++i)
+    for (int i = 0; i < LED_ID_COUNT; ++i)
     {
-        pin_reset(leds[i].name);
+        pin_reset(leds[i].id);
+        leds[i].pattern = led_patterns[off];
+        leds[i].step = 0;
     }
-    
-    xTaskCreate(vLed, "led", LED_STACK_SIZE, NULL, LED_PRIORITY, NULL);
+
+    xLedTimer = xTimerCreate("led", LED_STEP_TIME, pdTRUE, NULL, vLedTimer);
+    assert_param(NULL != xLedTimer);
 }
 
 /**
  * @brief set led action
- * @param name - led name
+ * @param led - led id
  * @param action - led action
  */
-void led_net_set_action(const char *name, led_action action)
+void led_net_set_action(led_id led, led_action action)
 {
-    assert_param(NULL != name);
-    assert_param(action <= flash);
-    for (int i = 0; i < sizeof(leds) / sizeof(leds[0]); ++i)
-    {
-        if (0 == strcmp(leds[i].name, name))
-        {
-            TRACE("set led(%s) action: %d\r\n", name, action);
-            leds[i].action = action;
-        }
-    }
+    assert_param(led < LED_ID_COUNT);
+    assert_param(action <= double_blink);
+    xTimerPendFunctionCall(led_apply, NULL, LED_CMD(led, action, 0),
+                           LED_CMD_WAIT);
+}
+
+/**
+ * @brief blink error code on led
+ * @param led - led id
+ * @param code - error code, 1 to LED_CODE_MAX
+ */
+void led_net_set_code(led_id led, uint8_t code)
+{
+    assert_param(led < LED_ID_COUNT);
+    assert_param((code > 0) && (code <= LED_CODE_MAX));
+    TRACE("led(%d) error code: %d\r\n", led, code);
+    xTimerPendFunctionCall(led_apply, NULL,
+                           LED_CMD(led, LED_ACTION_CODE, code), LED_CMD_WAIT);
 }
+
@@ -12,15 +12,30 @@
 
 BEGIN_DECLS
 
+typedef enum
+{
+    LED_ID_ERROR,
+    LED_ID_NET,
+    LED_ID_MQTT,
+    LED_ID_COUNT,
+}led_id;
+
 typedef enum
 {
     on,
     off,
-    flash
+    flash,
+    double_blink,
 }led_action;
 
+/* error codes blinked by led, 1 to LED_CODE_MAX blinks and a pause */
+#define LED_CODE_NETWORK    (1)
+#define LED_CODE_SELFTEST   (2)
+#define LED_CODE_MAX        (5)
+
 void led_net_init(void);
-void led_net_set_action(const char *name, led_action action);
+void led_net_set_action(led_id led, led_action action);
+void led_net_set_code(led_id led, uint8_t code);
 
 END_DECLS
 
@@ -7,6 +7,8 @@
 */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "timers.h"
+#include "assert.h"
 #include "global.h"
 #include "trace.h"
 #include "serial.h"
@@ -17,30 +19,19 @@
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[license]"
 
-uint32_t g_count = 0;
+/* license expires one day after startup */
+#define LICENSE_TIME    (24 * 3600 * 1000 / portTICK_PERIOD_MS)
 
 /**
- * @brief license check task
- * @param pvParameter - task parameter
+ * @brief license expired timer
+ * @param xTimer - timer handle
  */
-static void vLicense(void *pvParameters)
+static void vLicense(TimerHandle_t xTimer)
 {
-    for (;;)
-    {
-        g_count++;
-        if (g_count >= 3600 * 24)
-        {
-            /* license expired */
-            /* shutdown network task */
-            esp8266_shutdown();
-            m26_shutdown();
-            TRACE("license expired!\r\n");
-            break;
-        }
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-    }
-
-    vTaskDelete(NULL);
+    /* shutdown network task */
+    esp8266_shutdown();
+    m26_shutdown();
+    TRACE("license expired!\r\n");
 }
 
 /**
@@ -49,8 +40,10 @@ static void vLicense(void *pvParameters)
 void license_init(void)
 {
     TRACE("initialise license system...\r\n");
-    xTaskCreate(vLicense, "license", LICENSE_STACK_SIZE, NULL, 
-                LICENSE_PRIORITY, NULL);
+    TimerHandle_t xLicense = xTimerCreate("license", LICENSE_TIME, pdFALSE,
+                                          NULL, vLicense);
+    assert_param(NULL != xLicense);
+    xTimerStart(xLicense, 0);
 }
 
 
@@ -13,6 +13,7 @@
 #include "m26.h"
 #include "serial.h"
 #include "global.h"
+#include "watchdog.h"
 #include "trace.h"
 #include "pinconfig.h"
 #include "dbgserial.h"
@@ -27,6 +28,9 @@
 static m26_driver g_driver;
 
 TaskHandle_t task_m26 = NULL;
+/* parser is idle at most this time between lines */
+#define RESPONSE_WDG_DEADLINE  (10000 / portTICK_PERIOD_MS)
+static uint8_t m26_wdg = WATCHDOG_NONE;
 
 /* esp8266 work in block mode */
 static struct
@@ -429,9 +433,11 @@ static void vM26Response(void *pvParameters)
     uint16_t tcp_size = 0;
     char data;
     TickType_t xDelay = 50 / portTICK_PERIOD_MS;
+    m26_wdg = watchdog_register("M26Response", RESPONSE_WDG_DEADLINE);
     for (;;)
     {
-        if (serial_getchar(pserial, &data, portMAX_DELAY))
+        watchdog_checkin(m26_wdg);
+        if (serial_getchar(pserial, &data, WATCHDOG_CHECKIN_TIME))
         {
             g_curmode = mode_at;
             tcp_size = 0;
@@ -503,11 +509,11 @@ static void vM26Response(void *pvParameters)
 bool m26_init(void)
 {
     TRACE("initialize m26...\r\n");
-    pin_reset("GPRS_PWR");
+    pin_reset(PIN_GPRS_PWR);
     vTaskDelay(500 / portTICK_PERIOD_MS);
-    pin_set("GPRS_PWR");
+    pin_set(PIN_GPRS_PWR);
     vTaskDelay(3000 / portTICK_PERIOD_MS);
-    pin_reset("GPRS_PWR");
+    pin_reset(PIN_GPRS_PWR);
     
     g_serial = serial_request(COM3);
     if (NULL == g_serial)
@@ -753,6 +759,7 @@ void m26_shutdown(void)
 {
     if (NULL != task_m26)
     {
+        watchdog_unregister(m26_wdg);
         vTaskDelete(task_m26);
         task_m26 = NULL;
     }
@@ -6,18 +6,55 @@
 * See the COPYING file for the terms of usage and distribution.
 */
 #include "mode.h"
+#include "trace.h"
 #include "pinconfig.h"
+#include "flash.h"
 
-static uint8_t g_mode_net = MODE_NET_WIFI;
-static uint8_t g_mode_work = MODE_WORK_NORMAL;
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[mode]"
+
+/* keep alive range accepted by server */
+#define MODE_KEEPALIVE_MIN   (5)
+#define MODE_KEEPALIVE_MAX   (600)
+
+static const mode_config mode_default = 
+{
+    MODE_NET_WIFI, MODE_WORK_NORMAL, MODE_LED_IR, 10, 8
+};
+
+/* mode saved in flash, and mode running now. network and work mode only
+   change at start */
+static mode_config mode_saved;
+static mode_config mode_active;
+
+/**
+ * @brief apply dip switches, switch in on position overrides saved mode
+ * @param config - saved mode, updated to mode to run
+ */
+static void mode_override(mode_config *config)
+{
+    if (is_pinset(PIN_SWITCH1))
+    {
+        config->net = MODE_NET_GPRS;
+    }
+
+    if (is_pinset(PIN_SWITCH2))
+    {
+        config->work = MODE_WORK_TEST;
+    }
+}
 
 /**
  * @brief initizlize mode configuration
  */
 void mode_init(void)
 {
-    g_mode_net = (uint8_t)is_pinset("SWITCH1");
-    g_mode_work = (uint8_t)is_pinset("SWITCH2");
+    if (!flash_get_mode(&mode_saved))
+    {
+        mode_saved = mode_default;
+    }
+    mode_active = mode_saved;
+    mode_override(&mode_active);
 }
 
 /**
@@ -26,7 +63,7 @@ void mode_init(void)
  */
 uint8_t mode_net(void)
 {
-    return g_mode_net;
+    return mode_active.net;
 }
 
 /**
@@ -35,5 +72,119 @@ uint8_t mode_net(void)
  */
 uint8_t mode_work(void)
 {
-    return g_mode_work;
-}
\ No newline at end of file
+    return mode_active.work;
+}
+
+/**
+ * @brief get motor led policy
+ * @return led policy
+ */
+uint8_t mode_led(void)
+{
+    return mode_active.led;
+}
+
+/**
+ * @brief get time motor leds stay on after human leaved
+ * @return hold time(s)
+ */
+uint8_t mode_ir_hold(void)
+{
+    return mode_active.ir_hold;
+}
+
+/**
+ * @brief get mqtt keep alive
+ * @return keep alive(s)
+ */
+uint16_t mode_keepalive(void)
+{
+    return mode_active.keepalive;
+}
+
+/**
+ * @brief get saved mode, network and work mode may wait for next start
+ * @param config - saved mode
+ */
+void mode_get(mode_config *config)
+{
+    *config = mode_saved;
+}
+
+/**
+ * @brief check if all fields of mode are in range
+ * @param config - mode to check
+ * @return TRUE if mode is valid
+ */
+bool mode_valid(const mode_config *config)
+{
+    return ((config->net <= MODE_NET_GPRS) && 
+            (config->work <= MODE_WORK_TEST) &&
+            (config->led <= MODE_LED_OFF) && (config->ir_hold > 0) &&
+            (config->keepalive >= MODE_KEEPALIVE_MIN) && 
+            (config->keepalive <= MODE_KEEPALIVE_MAX));
+}
+
+/**
+ * @brief save mode, led policy and keep alive are applied now. network and
+ *        work mode are applied at next start, caller restarts subsystems
+ *        of changed fields
+ * @param config - new mode, invalid fields are ignored
+ * @return changed fields
+ */
+uint8_t mode_set(const mode_config *config)
+{
+    mode_config mode = mode_saved;
+    uint8_t changed = 0;
+
+    if ((config->net <= MODE_NET_GPRS) && (config->net != mode.net))
+    {
+        mode.net = config->net;
+        changed |= MODE_CHANGED_NET;
+    }
+
+    if ((config->work <= MODE_WORK_TEST) && (config->work != mode.work))
+    {
+        mode.work = config->work;
+        changed |= MODE_CHANGED_WORK;
+    }
+
+    if ((config->led <= MODE_LED_OFF) && (config->ir_hold > 0) &&
+        ((config->led != mode.led) || (config->ir_hold != mode.ir_hold)))
+    {
+        mode.led = config->led;
+        mode.ir_hold = config->ir_hold;
+        mode_active.led = mode.led;
+        mode_active.ir_hold = mode.ir_hold;
+        changed |= MODE_CHANGED_LED;
+    }
+
+    if ((config->keepalive >= MODE_KEEPALIVE_MIN) && 
+        (config->keepalive <= MODE_KEEPALIVE_MAX) &&
+        (config->keepalive != mode.keepalive))
+    {
+        mode.keepalive = config->keepalive;
+        mode_active.keepalive = mode.keepalive;
+        changed |= MODE_CHANGED_ALIVE;
+    }
+
+    if (0 != changed)
+    {
+        TRACE("mode changed: 0x%02x\r\n", changed);
+        mode_saved = mode;
+        flash_set_mode(&mode_saved);
+    }
+
+    return changed;
+}
+
+/**
+ * @brief check if saved network or work mode waits for next start
+ * @return TRUE if mode to run differs
+ */
+bool mode_pending(void)
+{
+    mode_config mode = mode_saved;
+    mode_override(&mode);
+    return ((mode.net != mode_active.net) || (mode.work != mode_active.work));
+}
@@ -16,11 +16,40 @@ BEGIN_DECLS
 #define MODE_NET_GPRS        1
 #define MODE_WORK_NORMAL     0
 #define MODE_WORK_TEST       1
+/* motor leds follow ir presence, stay on or stay off */
+#define MODE_LED_IR          0
+#define MODE_LED_ON          1
+#define MODE_LED_OFF         2
+
+/* operating mode saved in flash configure */
+typedef struct
+{
+    uint8_t net;
+    uint8_t work;
+    uint8_t led;
+    /* time motor leds stay on after human leaved(s) */
+    uint8_t ir_hold;
+    /* mqtt keep alive(s) */
+    uint16_t keepalive;
+}mode_config;
+
+/* fields changed by mode_set */
+#define MODE_CHANGED_NET     0x01
+#define MODE_CHANGED_WORK    0x02
+#define MODE_CHANGED_LED     0x04
+#define MODE_CHANGED_ALIVE   0x08
 
 void mode_init(void);
 uint8_t mode_net(void);
 uint8_t mode_work(void);
+uint8_t mode_led(void);
+uint8_t mode_ir_hold(void);
+uint16_t mode_keepalive(void);
+void mode_get(mode_config *config);
+bool mode_valid(const mode_config *config);
+uint8_t mode_set(const mode_config *config);
+bool mode_pending(void);
 
 END_DECLS
 
-#endif
\ No newline at end of file
+#endif
@@ -7,16 +7,15 @@
 */
 #include "modeswitch.h"
 #include "FreeRTOS.h"
-#include "queue.h"
 #include "task.h"
+#include "timers.h"
 #include "assert.h"
 #include "trace.h"
 #include "global.h"
 #include "pinconfig.h"
-#include "mqtt.h"
-#include "wifi.h"
+#include "stm32f10x_cfg.h"
 #include "flash.h"
-#include "simple_http.h"
+#include "health.h"
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[mode]"
@@ -27,36 +26,151 @@
 
 uint8_t g_cur_mode = MODE_SAT;
 
-#define SWITCH_COUNT    (5)
+#define MODE_PIN              PIN_MODE_SET
 
+/* input is stable for this time after last edge */
+#define MODE_DEBOUNCE_TIME    (20 / portTICK_PERIOD_MS)
+/* press duration of gestures, presses between short and long are ignored */
+#define MODE_SHORT_MAX        (1000 / portTICK_PERIOD_MS)
+#define MODE_LONG_MIN         (3000 / portTICK_PERIOD_MS)
+#define MODE_VERY_LONG_MIN    (10000 / portTICK_PERIOD_MS)
+/* reset after trace is sent */
+#define MODE_RESET_DELAY      (1000 / portTICK_PERIOD_MS)
+
+static uint8_t mode_line = 0;
+static TimerHandle_t xModeDebounce = NULL;
+static TimerHandle_t xModeReset = NULL;
+
+/* button state, only changed in timer task. gestures are handled in flash
+   task, handlers may block on flash */
+static bool mode_pressed = FALSE;
+static TickType_t mode_press_tick = 0;
+static modeswitch_cb mode_handlers[MODE_GESTURE_COUNT];
 
 /**
- * @brief monitor button
+ * mode button interrupt handler
  */
-static void vModeMonitor(void *pvParameters)
+void EXTI9_5_IRQHandler(void)
 {
-    uint8_t count = 0;
-    for (;;)
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    EXTI_ClrPending(mode_line);
+    xTimerResetFromISR(xModeDebounce, &xHigherPriorityTaskWoken);
+    /* check if there is any higher priority task need to wakeup */
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief commit configure and reset system in flash task
+ * @param arg - unused
+ */
+static void mode_reset(uint32_t arg)
+{
+    flash_sync();
+    SCB_SystemReset();
+}
+
+/**
+ * @brief reset delay elapsed
+ * @param xTimer - timer handle
+ */
+static void vModeReset(TimerHandle_t xTimer)
+{
+    /* work queue is full, try again after reset delay */
+    if (!flash_defer(mode_reset, 0))
     {
-        if (is_pinset("MODE_SET"))
+        xTimerReset(xTimer, 0);
+    }
+}
+
+/**
+ * @brief erase network configure and restart in ap mode, mode is kept
+ */
+static void mode_provision(void)
+{
+    if (MODE_AP == g_cur_mode)
+    {
+        TRACE("already in ap mode\r\n");
+        return ;
+    }
+
+    TRACE("enter ap provisioning\r\n");
+    flash_restore();
+    modeswitch_restart();
+}
+
+/**
+ * @brief erase configure including mode and statistics and restart
+ */
+static void mode_factory_reset(void)
+{
+    TRACE("factory reset\r\n");
+    flash_clear();
+    health_clear();
+    modeswitch_restart();
+}
+
+/**
+ * @brief dispatch gesture to attached handler in flash task
+ * @param gesture - button gesture
+ */
+static void mode_dispatch(uint32_t gesture)
+{
+    TRACE("gesture: %d\r\n", gesture);
+    if (NULL != mode_handlers[gesture])
+    {
+        mode_handlers[gesture]();
+    }
+}
+
+/**
+ * @brief queue gesture to flash task
+ * @param gesture - button gesture
+ */
+static void mode_detected(mode_gesture gesture)
+{
+    if (!flash_defer(mode_dispatch, gesture))
+    {
+        TRACE("drop gesture: %d\r\n", gesture);
+    }
+}
+
+/**
+ * @brief input is stable after edges, measure press duration
+ * @param xTimer - timer handle
+ */
+static void vModeDebounce(TimerHandle_t xTimer)
+{
+    TickType_t held = 0;
+
+    /* input is low when button is pressed */
+    if (!is_pinset(MODE_PIN))
+    {
+        if (!mode_pressed)
         {
-            count = 0;
+            mode_pressed = TRUE;
+            mode_press_tick = xTaskGetTickCount();
         }
-        else
+    }
+    else if (mode_pressed)
+    {
+        mode_pressed = FALSE;
+        held = xTaskGetTickCount() - mode_press_tick;
+        if (held <= MODE_SHORT_MAX)
+        {
+            mode_detected(MODE_GESTURE_SHORT);
+        }
+        else if (held >= MODE_VERY_LONG_MIN)
+        {
+            mode_detected(MODE_GESTURE_VERY_LONG);
+        }
+        else if (held >= MODE_LONG_MIN)
         {
-            count ++;
+            mode_detected(MODE_GESTURE_LONG);
         }
-        
-        if (count > SWITCH_COUNT)
+        else
         {
-            if (MODE_AP != g_cur_mode)
-            {
-                flash_restore();
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
-                SCB_SystemReset();
-            }
+            TRACE("ignore press of %dms\r\n", held * portTICK_PERIOD_MS);
         }
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
     }
 }
 
@@ -73,11 +187,44 @@ void modeswitch_init(void)
     {
         g_cur_mode = MODE_SAT;
     }
-    xTaskCreate(vModeMonitor, "ModeMonitor", MODESWITCH_STACK_SIZE, 
-                NULL, MODESWITCH_PRIORITY, NULL);
-}
 
+    mode_handlers[MODE_GESTURE_LONG] = mode_provision;
+    mode_handlers[MODE_GESTURE_VERY_LONG] = mode_factory_reset;
+    xModeDebounce = xTimerCreate("modedeb", MODE_DEBOUNCE_TIME, pdFALSE, NULL,
+                                 vModeDebounce);
+    xModeReset = xTimerCreate("modereset", MODE_RESET_DELAY, pdFALSE, NULL,
+                              vModeReset);
+    assert_param((NULL != xModeDebounce) && (NULL != xModeReset));
 
+    mode_line = pin_num(MODE_PIN);
+    EXTI_ClrPending(mode_line);
+    GPIO_EXTIConfig(pin_group(MODE_PIN), mode_line);
+    EXTI_SetTrigger(mode_line, 
+                    (Trigger_Edge)(Trigger_Rising | Trigger_Falling));
+    NVIC_Config nvicConfig = {EXTI9_5_IRQChannel, EXTI9_5_PRIORITY, 0, TRUE};
+    NVIC_Init(&nvicConfig);
+    EXTI_EnableLine_INT(mode_line, TRUE);
 
+    /* button may be held already */
+    xTimerStart(xModeDebounce, 0);
+}
 
+/**
+ * @brief attach handler to gesture, replaces default handler
+ * @param gesture - button gesture
+ * @param cb - gesture handler, NULL to ignore gesture
+ */
+void modeswitch_attach(mode_gesture gesture, modeswitch_cb cb)
+{
+    assert_param(gesture < MODE_GESTURE_COUNT);
+    mode_handlers[gesture] = cb;
+}
 
+/**
+ * @brief restart system after reset delay, configure is committed before
+ *        reset. it does not block
+ */
+void modeswitch_restart(void)
+{
+    xTimerStart(xModeReset, 0);
+}
@@ -12,8 +12,25 @@
 
 BEGIN_DECLS
 
+/* mode button gestures, decided by press duration */
+typedef enum
+{
+    /* released within 1s, report status */
+    MODE_GESTURE_SHORT,
+    /* held 3s to 10s, enter ap provisioning */
+    MODE_GESTURE_LONG,
+    /* held over 10s, factory reset */
+    MODE_GESTURE_VERY_LONG,
+    MODE_GESTURE_COUNT,
+}mode_gesture;
+
+/* called in flash task when gesture is recognized, may write flash */
+typedef void (*modeswitch_cb)(void);
+
 void modeswitch_init(void);
+void modeswitch_attach(mode_gesture gesture, modeswitch_cb cb);
+void modeswitch_restart(void);
 
 END_DECLS
 
-#endif
\ No newline at end of file
+#endif
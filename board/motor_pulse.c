@@ -0,0 +1,440 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "motor_pulse.h"
+#include "task.h"
+#include "semphr.h"
+#include "assert.h"
+#include "trace.h"
+#include "global.h"
+#include "cabinet.h"
+#include "stm32f10x_cfg.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[motor_pulse]"
+
+/* TIM2 clock is 72MHz, counter runs at 1MHz and overflows are counted to
+   extend time to 32 bits */
+#define MOTOR_PULSE_TIMER       TIM2
+#define MOTOR_PULSE_PRESCALER   (72 - 1)
+#define MOTOR_PULSE_EVENT       TIM_CHANNEL1
+#define MOTOR_PULSE_NEVER       (0xffffffff)
+/* extra wait time before job is treated as lost(ms) */
+#define MOTOR_PULSE_SLACK       (50)
+
+#ifdef CABINET_ROW_PWM
+/* soft start and soft stop ramp, row level changes every step */
+#define MOTOR_PULSE_RAMP        TIM_CHANNEL2
+#define MOTOR_PULSE_RAMP_STEP   (1000)
+#define MOTOR_PULSE_RAMP_LEVEL  (10)
+#define MOTOR_PULSE_RAMP_TIME   (CABINET_LEVEL_FULL / MOTOR_PULSE_RAMP_LEVEL)
+#endif
+
+/* motor interrupts share one priority, so state below is never preempted */
+static motor_pulse_job *pulse_job = NULL;
+/* next motor to stop */
+static uint8_t pulse_next = 0;
+static uint32_t pulse_deadline = 0;
+static bool pulse_detected = FALSE;
+static volatile uint16_t pulse_high = 0;
+static TickType_t pulse_guard = 0;
+static xSemaphoreHandle xPulseDone = NULL;
+
+#ifdef CABINET_ROW_PWM
+static uint8_t pulse_level = CABINET_LEVEL_FULL;
+/* 1 ramp up, -1 ramp down, 0 no ramp */
+static int8_t pulse_ramp_dir = 0;
+#endif
+
+/**
+ * @brief get time since job started
+ * @return job time(us)
+ */
+static uint32_t pulse_now(void)
+{
+    uint16_t high = pulse_high;
+    uint16_t low = TIM_GetCounter(MOTOR_PULSE_TIMER);
+
+    /* counter overflowed but update interrupt is not handled yet */
+    if (TIM_IsFlagOn(MOTOR_PULSE_TIMER, TIM_FLAG_UPDATE) && (low < 0x8000))
+    {
+        high ++;
+    }
+
+    return (((uint32_t)high << 16) | low);
+}
+
+/**
+ * @brief switch one matrix line of motor
+ * @param num - motor number
+ * @param by_row - row line or column line
+ * @param on - line status
+ */
+static __INLINE void pulse_line(uint8_t num, bool by_row, bool on)
+{
+    if (by_row)
+    {
+        cabinet_row(cabinet_slots[num].row, on);
+    }
+    else
+    {
+        cabinet_col(cabinet_slots[num].col, on);
+    }
+}
+
+/**
+ * @brief arm compare event of next deadline, deadlines beyond current 
+ *        counter period are armed by overflow interrupt
+ */
+static void pulse_arm(void)
+{
+    if ((pulse_deadline >> 16) == pulse_high)
+    {
+        TIM_SetCompare(MOTOR_PULSE_TIMER, MOTOR_PULSE_EVENT, 
+                       (uint16_t)pulse_deadline);
+        TIM_ClrFlag(MOTOR_PULSE_TIMER, TIM_FLAG_CC1);
+        TIM_EnableInt(MOTOR_PULSE_TIMER, TIM_IT_CC1, TRUE);
+    }
+    else
+    {
+        TIM_EnableInt(MOTOR_PULSE_TIMER, TIM_IT_CC1, FALSE);
+    }
+}
+
+/**
+ * @brief finish current job, stop all lines and notify task
+ * @param pxHigherPriorityTaskWoken - task woken flag
+ */
+static void pulse_finish(portBASE_TYPE *pxHigherPriorityTaskWoken)
+{
+    uint32_t now = pulse_now();
+    motor_pulse_job *job = pulse_job;
+
+    for (; pulse_next < job->count; ++pulse_next)
+    {
+        pulse_line(job->slots[pulse_next], !job->by_row, FALSE);
+        job->run[pulse_next] = now;
+    }
+    pulse_line(job->slots[0], job->by_row, FALSE);
+
+    TIM_Enable(MOTOR_PULSE_TIMER, FALSE);
+    TIM_EnableInt(MOTOR_PULSE_TIMER, TIM_IT_CC1, FALSE);
+#ifdef CABINET_ROW_PWM
+    TIM_EnableInt(MOTOR_PULSE_TIMER, TIM_IT_CC2, FALSE);
+    pulse_ramp_dir = 0;
+    pulse_level = CABINET_LEVEL_FULL;
+    cabinet_row_level(pulse_level);
+#endif
+    pulse_job = NULL;
+    xSemaphoreGiveFromISR(xPulseDone, pxHigherPriorityTaskWoken);
+}
+
+#ifdef CABINET_ROW_PWM
+/**
+ * @brief start row level ramp
+ * @param dir - 1 ramp up, -1 ramp down
+ */
+static void pulse_ramp_start(int8_t dir)
+{
+    pulse_ramp_dir = dir;
+    TIM_SetCompare(MOTOR_PULSE_TIMER, MOTOR_PULSE_RAMP, 
+                   TIM_GetCounter(MOTOR_PULSE_TIMER) + MOTOR_PULSE_RAMP_STEP);
+    TIM_ClrFlag(MOTOR_PULSE_TIMER, TIM_FLAG_CC2);
+    TIM_EnableInt(MOTOR_PULSE_TIMER, TIM_IT_CC2, TRUE);
+}
+
+/**
+ * @brief change row level one step
+ * @param pxHigherPriorityTaskWoken - task woken flag
+ */
+static void pulse_ramp(portBASE_TYPE *pxHigherPriorityTaskWoken)
+{
+    if (pulse_ramp_dir > 0)
+    {
+        pulse_level = MIN(pulse_level + MOTOR_PULSE_RAMP_LEVEL, 
+                          CABINET_LEVEL_FULL);
+    }
+    else if (pulse_ramp_dir < 0)
+    {
+        pulse_level = (pulse_level > MOTOR_PULSE_RAMP_LEVEL) ? 
+                      (pulse_level - MOTOR_PULSE_RAMP_LEVEL) : 0;
+    }
+    cabinet_row_level(pulse_level);
+
+    if ((pulse_ramp_dir < 0) && (0 == pulse_level))
+    {
+        pulse_line(pulse_job->slots[0], !pulse_job->by_row, FALSE);
+        pulse_next = 1;
+        pulse_finish(pxHigherPriorityTaskWoken);
+    }
+    else if ((pulse_ramp_dir > 0) && (CABINET_LEVEL_FULL == pulse_level))
+    {
+        pulse_ramp_dir = 0;
+        TIM_EnableInt(MOTOR_PULSE_TIMER, TIM_IT_CC2, FALSE);
+    }
+    else
+    {
+        TIM_SetCompare(MOTOR_PULSE_TIMER, MOTOR_PULSE_RAMP, 
+                       TIM_GetCounter(MOTOR_PULSE_TIMER) + 
+                       MOTOR_PULSE_RAMP_STEP);
+    }
+}
+#endif
+
+/**
+ * @brief stop next motor at its deadline
+ * @param pxHigherPriorityTaskWoken - task woken flag
+ */
+static void pulse_expire(portBASE_TYPE *pxHigherPriorityTaskWoken)
+{
+    motor_pulse_job *job = pulse_job;
+
+#ifdef CABINET_ROW_PWM
+    if (1 == job->count)
+    {
+        /* single motor slows down before stop */
+        job->run[0] = pulse_deadline;
+        pulse_deadline = MOTOR_PULSE_NEVER;
+        pulse_ramp_start(-1);
+        return ;
+    }
+#endif
+
+    job->run[pulse_next] = pulse_deadline;
+    pulse_line(job->slots[pulse_next], !job->by_row, FALSE);
+    if (++pulse_next == job->count)
+    {
+        pulse_finish(pxHigherPriorityTaskWoken);
+        return ;
+    }
+
+    pulse_deadline = job->stop[pulse_next];
+    if (NULL != job->stopped)
+    {
+        job->stopped(job->count - pulse_next);
+    }
+}
+
+/**
+ * @brief handle deadlines reached by now and arm next one
+ * @param pxHigherPriorityTaskWoken - task woken flag
+ */
+static void pulse_service(portBASE_TYPE *pxHigherPriorityTaskWoken)
+{
+    while (NULL != pulse_job)
+    {
+        if (pulse_now() < pulse_deadline)
+        {
+            pulse_arm();
+            /* compare value may be passed while arming */
+            if (pulse_now() < pulse_deadline)
+            {
+                return ;
+            }
+        }
+        pulse_expire(pxHigherPriorityTaskWoken);
+    }
+}
+
+/**
+ * motor pulse timer interrupt handler
+ */
+void TIM2_IRQHandler(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+    if (TIM_IsFlagOn(MOTOR_PULSE_TIMER, TIM_FLAG_UPDATE))
+    {
+        TIM_ClrFlag(MOTOR_PULSE_TIMER, TIM_FLAG_UPDATE);
+        pulse_high ++;
+    }
+
+    if (TIM_IsFlagOn(MOTOR_PULSE_TIMER, TIM_FLAG_CC1))
+    {
+        TIM_ClrFlag(MOTOR_PULSE_TIMER, TIM_FLAG_CC1);
+    }
+
+#ifdef CABINET_ROW_PWM
+    if (TIM_IsFlagOn(MOTOR_PULSE_TIMER, TIM_FLAG_CC2))
+    {
+        TIM_ClrFlag(MOTOR_PULSE_TIMER, TIM_FLAG_CC2);
+        if ((NULL != pulse_job) && (0 != pulse_ramp_dir))
+        {
+            pulse_ramp(&xHigherPriorityTaskWoken);
+        }
+    }
+#endif
+
+    pulse_service(&xHigherPriorityTaskWoken);
+    /* check if there is any higher priority task need to wakeup */
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief initialize motor pulse timer
+ */
+void motor_pulse_init(void)
+{
+    TRACE("initialize motor pulse timer...\r\n");
+    xPulseDone = xSemaphoreCreateBinary();
+    
+    RCC_APB1PeriphReset(RCC_APB1_RESET_TIM2, TRUE);
+    RCC_APB1PeriphReset(RCC_APB1_RESET_TIM2, FALSE);
+    RCC_APB1PeripClockEnable(RCC_APB1_ENABLE_TIM2, TRUE);
+
+    TIM_SetCounterMode(MOTOR_PULSE_TIMER, TIM_COUNTER_UP);
+    TIM_SetPrescaler(MOTOR_PULSE_TIMER, MOTOR_PULSE_PRESCALER);
+    TIM_SetAutoReload(MOTOR_PULSE_TIMER, 0xffff);
+    TIM_EnableUpdateOnlyOverflow(MOTOR_PULSE_TIMER, TRUE);
+    /* load prescaler */
+    TIM_GenerateUpdate(MOTOR_PULSE_TIMER);
+    TIM_SetOutputCompareMode(MOTOR_PULSE_TIMER, MOTOR_PULSE_EVENT, 
+                             TIM_OC_FROZEN, FALSE);
+#ifdef CABINET_ROW_PWM
+    TIM_SetOutputCompareMode(MOTOR_PULSE_TIMER, MOTOR_PULSE_RAMP, 
+                             TIM_OC_FROZEN, FALSE);
+#endif
+    TIM_ClrFlag(MOTOR_PULSE_TIMER, TIM_FLAG_UPDATE);
+    TIM_EnableInt(MOTOR_PULSE_TIMER, TIM_IT_UPDATE, TRUE);
+
+    NVIC_Config nvicConfig = {TIM2_IRQChannel, MOTOR_TIMER_PRIORITY, 0, TRUE};
+    NVIC_Init(&nvicConfig);
+}
+
+/**
+ * @brief start motors of job, motors are stopped in timer interrupt
+ * @param job - pulse job, must be valid until job finished
+ */
+void motor_pulse_submit(motor_pulse_job *job)
+{
+    uint32_t last = 0;
+    assert_param(NULL != job);
+    assert_param((job->count > 0) && (job->count <= MOTOR_PULSE_MAX));
+    assert_param(NULL == pulse_job);
+
+    job->detect = 0;
+    job->edges = 0;
+    job->aborted = FALSE;
+    last = job->stop[job->count - 1];
+    if (1 == job->count)
+    {
+        last += job->margin;
+    }
+#ifdef CABINET_ROW_PWM
+    last += MOTOR_PULSE_US(MOTOR_PULSE_RAMP_TIME * 2);
+#endif
+    pulse_guard = (last / 1000 + MOTOR_PULSE_SLACK) / portTICK_PERIOD_MS;
+    while (pdTRUE == xSemaphoreTake(xPulseDone, 0));
+
+    taskENTER_CRITICAL();
+    pulse_next = 0;
+    pulse_deadline = job->stop[0];
+    pulse_detected = FALSE;
+    pulse_high = 0;
+    TIM_SetCounter(MOTOR_PULSE_TIMER, 0);
+    TIM_ClrFlag(MOTOR_PULSE_TIMER, TIM_FLAG_UPDATE);
+    pulse_job = job;
+
+#ifdef CABINET_ROW_PWM
+    pulse_level = 0;
+    cabinet_row_level(pulse_level);
+#endif
+    pulse_line(job->slots[0], job->by_row, TRUE);
+    for (int i = 0; i < job->count; ++i)
+    {
+        pulse_line(job->slots[i], !job->by_row, TRUE);
+    }
+    TIM_Enable(MOTOR_PULSE_TIMER, TRUE);
+#ifdef CABINET_ROW_PWM
+    pulse_ramp_start(1);
+#endif
+    pulse_arm();
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief wait current job finished
+ * @return FALSE if job is lost and stopped by force
+ */
+bool motor_pulse_wait(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+    if (pdTRUE == xSemaphoreTake(xPulseDone, pulse_guard))
+    {
+        return TRUE;
+    }
+
+    TRACE("pulse job lost, stop motors\r\n");
+    taskENTER_CRITICAL();
+    if (NULL != pulse_job)
+    {
+        pulse_job->aborted = TRUE;
+        pulse_finish(&xHigherPriorityTaskWoken);
+    }
+    taskEXIT_CRITICAL();
+    xSemaphoreTake(xPulseDone, 0);
+    return FALSE;
+}
+
+/**
+ * @brief motor detect edge arrived, should be called in detect interrupt
+ * @param pxHigherPriorityTaskWoken - task woken flag
+ */
+void motor_pulse_edge_from_isr(portBASE_TYPE *pxHigherPriorityTaskWoken)
+{
+    uint32_t now = 0;
+    motor_pulse_job *job = pulse_job;
+
+    if (NULL == job)
+    {
+        return ;
+    }
+
+    now = pulse_now();
+    if (now < job->blank)
+    {
+        return ;
+    }
+
+    if (0 == job->edges)
+    {
+        job->detect = now;
+    }
+    if (job->edges < MOTOR_PULSE_MAX)
+    {
+        job->edge[job->edges] = now;
+    }
+    if (job->edges < 0xff)
+    {
+        job->edges ++;
+    }
+
+    /* keep motor running a while after detect edge, so cam can leave 
+       switch */
+    if ((1 == job->count) && (0 != job->margin) && !pulse_detected &&
+        (pulse_deadline != MOTOR_PULSE_NEVER))
+    {
+        pulse_detected = TRUE;
+        pulse_deadline = now + job->margin;
+        pulse_service(pxHigherPriorityTaskWoken);
+    }
+}
+
+/**
+ * @brief stop all motors of current job right now
+ * @param pxHigherPriorityTaskWoken - task woken flag
+ */
+void motor_pulse_abort_from_isr(portBASE_TYPE *pxHigherPriorityTaskWoken)
+{
+    if (NULL != pulse_job)
+    {
+        pulse_job->aborted = TRUE;
+        pulse_finish(pxHigherPriorityTaskWoken);
+    }
+}
+
@@ -0,0 +1,61 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _MOTOR_PULSE_H_
+  #define _MOTOR_PULSE_H_
+
+#include "types.h"
+#include "FreeRTOS.h"
+
+BEGIN_DECLS
+
+/* max motors of one pulse job */
+#define MOTOR_PULSE_MAX    (8)
+
+/* convert milliseconds to pulse time */
+#define MOTOR_PULSE_US(ms)  ((uint32_t)(ms) * 1000ul)
+
+/* called in interrupt after one motor of job stopped */
+typedef void (*motor_pulse_stopped_cb)(uint8_t running);
+
+/* motors run at the same time, they share one matrix line and every motor 
+   is stopped by its own line */
+typedef struct
+{
+    /* motors share row line or column line */
+    bool by_row;
+    uint8_t count;
+    uint8_t slots[MOTOR_PULSE_MAX];
+    /* stop time of every motor(us), must be ascending */
+    uint32_t stop[MOTOR_PULSE_MAX];
+    /* detect edges earlier than blank time are bounce(us) */
+    uint32_t blank;
+    /* single motor job stops at this time after detect edge(us), 0 means 
+       motor runs to stop time */
+    uint32_t margin;
+    motor_pulse_stopped_cb stopped;
+
+    /* job result, valid after job finished */
+    /* run time of every motor(us) */
+    uint32_t run[MOTOR_PULSE_MAX];
+    /* time of first valid detect edge(us) */
+    uint32_t detect;
+    /* time of first MOTOR_PULSE_MAX valid detect edges(us) */
+    uint32_t edge[MOTOR_PULSE_MAX];
+    uint8_t edges;
+    bool aborted;
+}motor_pulse_job;
+
+void motor_pulse_init(void);
+void motor_pulse_submit(motor_pulse_job *job);
+bool motor_pulse_wait(void);
+void motor_pulse_edge_from_isr(portBASE_TYPE *pxHigherPriorityTaskWoken);
+void motor_pulse_abort_from_isr(portBASE_TYPE *pxHigherPriorityTaskWoken);
+
+END_DECLS
+
+#endif /* _MOTOR_PULSE_H_ */
@@ -15,32 +15,92 @@
 #include "global.h"
 #include "stm32f10x_cfg.h"
 #include "wifi.h"
+#include "motorcur.h"
+#include "slot_sensor.h"
+#include "cabinet.h"
+#include "journal.h"
+#include "motor_pulse.h"
+#include "health.h"
+#include "led_motor.h"
+#include "watchdog.h"
 
 
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[motor]"
 
-//#define USE_DETECT
+#define USE_DETECT
+/* current sense needs shunt amplifier on board, see motorcur.c */
+//#define USE_CURRENT_SENSE
 
-#define MOTOR_NUM   10
+#if defined(USE_CURRENT_SENSE) && !defined(USE_DETECT)
+  #error "motor current sense needs motor detect"
+#endif
 
-const char *motor_left[] = {"CON_L1", "CON_L2", "CON_L3", "CON_L4"};
-const char *motor_right[] = {"CON_R1", "CON_R2", "CON_R3", "CON_R4"};
-const char *motor_dect[] = {"CH1_DET", "CH2_DET", "CH3_DET", "CH4_DET",
-"CH5_DET", "CH6_DET", "CH7_DET", "CH8_DET", "CH9_DET", "CH10_DET"};
-#define MOTOR_DET_PIN_NAME  "MOT_DET"
+#define MOTOR_DET_PIN       PIN_MOT_DET
+static const char *motor_result_name[] = {"ok", "detect timeout", "jam", 
+                                          "empty", "interrupted", 
+                                          "rejected"};
 
 /* motor control message queue */
 static xQueueHandle xMotorQueue = NULL;
-#define MOTOR_MSG_NUM      (10)
+#define MOTOR_MSG_NUM      (4)
+
+/* peak current budget of motor power supply(mA) */
+#define MOTOR_PEAK_CURRENT    (1200)
+/* startup peak current of one motor(mA) */
+#define MOTOR_START_CURRENT   (500)
+/* max motors running at the same time */
+#define MOTOR_BATCH_MAX       MIN(MOTOR_PEAK_CURRENT / MOTOR_START_CURRENT, \
+                                  MOTOR_ORDER_MAX)
+#if (MOTOR_PEAK_CURRENT < MOTOR_START_CURRENT)
+  #error "motor peak current budget can not drive one motor"
+#endif
+#if (MOTOR_BATCH_MAX > MOTOR_PULSE_MAX)
+  #error "motor batch exceeds pulse job"
+#endif
+
+/* vend order */
+typedef struct
+{
+    uint16_t id;
+    uint8_t count;
+    uint8_t slots[MOTOR_ORDER_MAX];
+}motor_order;
+
+/* motors run at the same time, they share one matrix line */
+typedef struct
+{
+    bool by_row;
+    uint8_t line;
+    uint8_t count;
+    uint8_t slots[MOTOR_ORDER_MAX];
+}motor_batch;
 
 #ifdef USE_DETECT
-static xSemaphoreHandle xMotorWorking = NULL;
+static uint8_t motor_det_line = 0;
 #endif
 
-#define MOTOR_UP_TIME      (500 / portTICK_PERIOD_MS)
+/* learned run time of every slot(ms), 0 means not learned yet. it is kept
+   in health checkpoint over restarts */
+static uint16_t motor_learned[MOTOR_NUM];
+
+/* max run time when slot run time is not learned(ms) */
+#define MOTOR_UP_TIME      (500)
+/* min detect window when slot run time is learned(ms) */
+#define MOTOR_MIN_WINDOW   (100)
+/* detect edges during motor startup are treated as bounce(ms) */
+#define MOTOR_DET_BLANK    (30)
+/* detect edges closer than this to last edge are bounce(ms) */
+#define MOTOR_DET_DEBOUNCE (10)
+/* keep motor running after detect edge, so cam can leave switch(ms) */
+#define MOTOR_STOP_MARGIN  (20)
+/* fixed run time when detect is not used(ms) */
+#define MOTOR_RUN_TIME     (200)
+#define MOTOR_GAP_TIME     (100 / portTICK_PERIOD_MS)
 #define MOTOR_WAIT_TIME    (600 / portTICK_PERIOD_MS)
+/* one batch with its reports finishes in this time */
+#define MOTOR_WDG_DEADLINE (10000 / portTICK_PERIOD_MS)
 
 #ifdef USE_DETECT
 /**
@@ -49,117 +109,678 @@ static xSemaphoreHandle xMotorWorking = NULL;
 void EXTI3_IRQHandler(void)
 {
     portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-    uint8_t pin_num = 0;
-    get_pininfo(MOTOR_DET_PIN_NAME, NULL, &pin_num);
-    xSemaphoreGiveFromISR(xMotorWorking, &xHigherPriorityTaskWoken);
+    EXTI_ClrPending(motor_det_line);
+    motor_pulse_edge_from_isr(&xHigherPriorityTaskWoken);
     /* check if there is any higher priority task need to wakeup */
     portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
-    EXTI_ClrPending(pin_num);
 }
 #endif
 
+#ifdef USE_CURRENT_SENSE
 /**
- * @brief start motor
- * @param left - left bridge
- * @param right - right bridge
+ * @brief abnormal motor current handler, stop running motors
+ * @param signature - current signature
+ * @param pxHigherPriorityTaskWoken - task woken flag
  */
-static __INLINE void start_motor(uint8_t left, uint8_t right)
+static void motor_cur_fault(uint8_t signature,
+                            portBASE_TYPE *pxHigherPriorityTaskWoken)
 {
-    pin_set(motor_left[left]);
-    pin_set(motor_right[right]);
+    UNUSED(signature);
+    motor_pulse_abort_from_isr(pxHigherPriorityTaskWoken);
 }
 
 /**
- * @brief start motor
- * @param left - left bridge
- * @param right - right bridge
+ * @brief motor of batch stopped, rescale current levels
+ * @param running - motors still running
  */
-static __INLINE void stop_motor(uint8_t left, uint8_t right)
+static void motor_cur_stopped(uint8_t running)
 {
-    pin_reset(motor_left[left]);
-    pin_reset(motor_right[right]);
+    motorcur_scale(running);
 }
+
 /**
- * @brief motor control task
- * @param pvParameter - parameters pass to task
+ * @brief get vend result from current signature
+ * @param signature - current signature
+ * @param detected - detect edge flag
+ * @return vend result
  */
-static void vMotorCtl(void *pvParameters)
+static uint8_t motor_cur_result(uint8_t signature, bool detected)
 {
-    uint8_t num = 0;
-    uint8_t left = 0, right = 0;
-    for (;;)
+    switch (signature)
+    {
+    case MOTOR_CUR_JAM:
+        return MOTOR_VEND_JAM;
+    case MOTOR_CUR_NOLOAD:
+        return MOTOR_VEND_EMPTY;
+    default:
+        return detected ? MOTOR_VEND_OK : MOTOR_VEND_TIMEOUT;
+    }
+}
+#endif
+
+#ifdef USE_DETECT
+/**
+ * @brief get detect window of slot
+ * @param num - motor number
+ * @return detect window(ms)
+ */
+static uint16_t motor_window(uint8_t num)
+{
+    uint16_t window = 0;
+    if (0 == motor_learned[num])
+    {
+        return MOTOR_UP_TIME;
+    }
+
+    /* allow 50% deviation from learned run time */
+    window = motor_learned[num] + (motor_learned[num] >> 1);
+    return CLAMP(window, MOTOR_MIN_WINDOW, MOTOR_UP_TIME);
+}
+
+/**
+ * @brief update learned run time of slot
+ * @param num - motor number
+ * @param time - measured run time(ms)
+ */
+static void motor_learn(uint8_t num, uint16_t time)
+{
+    if (0 == motor_learned[num])
+    {
+        motor_learned[num] = time;
+    }
+    else
+    {
+        motor_learned[num] = (motor_learned[num] * 3 + time) >> 2;
+    }
+    health_learn(num, motor_learned[num]);
+}
+#endif
+
+/**
+ * @brief run one vend cycle
+ * @param num - motor number
+ * @param time - vend run time(ms)
+ * @return vend result
+ */
+static uint8_t motor_vend(uint8_t num, uint16_t *time)
+{
+    uint8_t result = MOTOR_VEND_OK;
+    bool finished = FALSE;
+    motor_pulse_job job;
+
+    job.by_row = TRUE;
+    job.count = 1;
+    job.slots[0] = num;
+    job.stopped = NULL;
+#ifdef USE_DETECT
+    bool detected = FALSE;
+    /* motor stops after detect margin, or at the end of detect window */
+    job.stop[0] = MOTOR_PULSE_US(motor_window(num));
+    job.blank = MOTOR_PULSE_US(MOTOR_DET_BLANK);
+    job.margin = MOTOR_PULSE_US(MOTOR_STOP_MARGIN);
+#ifdef USE_CURRENT_SENSE
+    motorcur_start(1);
+#endif
+    motor_pulse_submit(&job);
+    finished = motor_pulse_wait();
+    detected = (job.edges > 0);
+    *time = (detected ? job.detect : job.run[0]) / 1000;
+
+#ifdef USE_CURRENT_SENSE
+    uint16_t peak = 0, mean = 0;
+    result = motor_cur_result(motorcur_stop(&peak, &mean), detected);
+    TRACE("motor %d: current peak = %dmA, mean = %dmA\r\n", num, peak, 
+          mean);
+#else
+    result = detected ? MOTOR_VEND_OK : MOTOR_VEND_TIMEOUT;
+#endif
+    
+    if (finished && (MOTOR_VEND_OK == result))
+    {
+        motor_learn(num, *time);
+    }
+#else
+    job.stop[0] = MOTOR_PULSE_US(MOTOR_RUN_TIME);
+    job.blank = 0;
+    job.margin = 0;
+    motor_pulse_submit(&job);
+    finished = motor_pulse_wait();
+    *time = job.run[0] / 1000;
+#endif
+
+    /* job lost and stopped by force, run time and edges are not trusted */
+    if (!finished)
+    {
+        result = MOTOR_VEND_INTERRUPTED;
+    }
+
+    return result;
+}
+
+/**
+ * @brief check if slot can run in batch
+ * @param num - motor number
+ * @return TRUE if slot run time is known
+ */
+static __INLINE bool motor_batchable(uint8_t num)
+{
+    return (0 != motor_learned[num]);
+}
+
+/**
+ * @brief collect slots share the same matrix line with first slot
+ * @param order - pending slots
+ * @param by_row - share row line or column line
+ * @param batch - batch to fill
+ */
+static void motor_collect(const motor_order *order, bool by_row,
+                          motor_batch *batch)
+{
+    const cabinet_slot *first = &cabinet_slots[order->slots[0]];
+    const cabinet_slot *slot = NULL;
+    uint16_t used = 0;
+    uint8_t num = 0, line = 0, other = 0;
+    
+    batch->by_row = by_row;
+    batch->line = by_row ? first->row : first->col;
+    batch->count = 0;
+    for (int i = 0; (i < order->count) && (batch->count < MOTOR_BATCH_MAX); 
+         ++i)
     {
-        if (xQueueReceive(xMotorQueue, &num, portMAX_DELAY))
+        num = order->slots[i];
+        slot = &cabinet_slots[num];
+        line = by_row ? slot->row : slot->col;
+        other = by_row ? slot->col : slot->row;
+        /* the other matrix line must be different for every motor */
+        if ((line == batch->line) && motor_batchable(num) &&
+            (0 == (used & (1 << other))))
         {
-            left = (num >> 2);
-            right = num - (left << 2);
-            TRACE("start motor: %d\r\n", num);
-            start_motor(left, right);
-            
+            used |= (1 << other);
+            batch->slots[batch->count++] = num;
+        }
+    }
+}
+
+/**
+ * @brief pack next batch from pending order
+ * @param order - pending slots, packed slots are removed
+ * @param batch - next batch to run
+ */
+static void motor_pack(motor_order *order, motor_batch *batch)
+{
+    motor_batch col_batch;
+    
+    batch->by_row = TRUE;
+    batch->line = cabinet_slots[order->slots[0]].row;
+    batch->count = 1;
+    batch->slots[0] = order->slots[0];
+    if (motor_batchable(order->slots[0]))
+    {
+        /* turning on several row and column lines would drive every 
+           crossing motor, so batch motors must share one line */
+        motor_collect(order, TRUE, batch);
+        motor_collect(order, FALSE, &col_batch);
+        if (col_batch.count > batch->count)
+        {
+            *batch = col_batch;
+        }
+    }
+
+    /* remove packed slots from order */
+    for (int i = 0; i < batch->count; ++i)
+    {
+        for (int j = 0; j < order->count; ++j)
+        {
+            if (order->slots[j] == batch->slots[i])
+            {
+                order->count--;
+                for (; j < order->count; ++j)
+                {
+                    order->slots[j] = order->slots[j + 1];
+                }
+                break;
+            }
+        }
+    }
+}
+
 #ifdef USE_DETECT
-            /* wait motor working */
-            if (pdTRUE == xSemaphoreTake(xMotorWorking, MOTOR_UP_TIME))
+/**
+ * @brief give detect edges of batch to motors. motors share one detect
+ *        line, every edge is given to the running motor without edge whose
+ *        learned run time is nearest, edges closer than debounce time to
+ *        last edge are bounce
+ * @param job - finished pulse job
+ * @param edge - edge time of every motor in job order(us), 0 means no edge
+ */
+static void motor_attribute(const motor_pulse_job *job, uint32_t *edge)
+{
+    uint32_t last = 0, expect = 0, dist = 0, best_dist = 0;
+    int best = 0;
+    uint8_t count = MIN(job->edges, MOTOR_PULSE_MAX);
+
+    for (int i = 0; i < job->count; ++i)
+    {
+        edge[i] = 0;
+    }
+
+    for (int e = 0; e < count; ++e)
+    {
+        if ((e > 0) && 
+            (job->edge[e] - last < MOTOR_PULSE_US(MOTOR_DET_DEBOUNCE)))
+        {
+            continue;
+        }
+        last = job->edge[e];
+
+        best = -1;
+        for (int i = 0; i < job->count; ++i)
+        {
+            if ((0 != edge[i]) || (job->edge[e] > job->run[i]))
+            {
+                continue;
+            }
+            expect = MOTOR_PULSE_US(motor_learned[job->slots[i]]);
+            dist = (job->edge[e] > expect) ? (job->edge[e] - expect) :
+                   (expect - job->edge[e]);
+            if ((best < 0) || (dist < best_dist))
             {
-                TRACE("motor working...\r\n");
-                xSemaphoreGive(xMotorWorking);
+                best = i;
+                best_dist = dist;
             }
-            else
+        }
+
+        if (best >= 0)
+        {
+            edge[best] = job->edge[e];
+        }
+    }
+}
+#endif
+
+/**
+ * @brief run motors share one matrix line at the same time, every motor
+ *        is stopped by its own line after its learned run time
+ * @param batch - motors to run
+ * @param time - vend run time of every motor(ms)
+ * @param result - vend result of every motor
+ */
+static void motor_vend_batch(const motor_batch *batch, uint16_t *time,
+                             uint8_t *result)
+{
+    uint8_t index[MOTOR_ORDER_MAX];
+    uint8_t tmp = 0;
+    bool finished = FALSE;
+    motor_pulse_job job;
+
+    /* stop motors in run time order */
+    for (int i = 0; i < batch->count; ++i)
+    {
+        index[i] = i;
+        for (int j = i; j > 0; --j)
+        {
+            if (motor_learned[batch->slots[index[j]]] >= 
+                motor_learned[batch->slots[index[j - 1]]])
             {
-                TRACE("motor working timeout!\r\n");
+                break;
             }
+            tmp = index[j];
+            index[j] = index[j - 1];
+            index[j - 1] = tmp;
+        }
+    }
+
+    job.by_row = batch->by_row;
+    job.count = batch->count;
+    for (int i = 0; i < batch->count; ++i)
+    {
+        job.slots[i] = batch->slots[index[i]];
+        job.stop[i] = MOTOR_PULSE_US(motor_learned[job.slots[i]] + 
+                                     MOTOR_STOP_MARGIN);
+    }
+    job.blank = MOTOR_PULSE_US(MOTOR_DET_BLANK);
+    job.margin = 0;
+#ifdef USE_CURRENT_SENSE
+    job.stopped = motor_cur_stopped;
+    motorcur_start(batch->count);
 #else
-            vTaskDelay(200 / portTICK_PERIOD_MS);
+    job.stopped = NULL;
 #endif
+    motor_pulse_submit(&job);
+    finished = motor_pulse_wait();
+
+#ifdef USE_CURRENT_SENSE
+    uint16_t peak = 0, mean = 0;
+    uint8_t signature = motorcur_stop(&peak, &mean);
+    TRACE("batch current peak = %dmA, mean = %dmA\r\n", peak, mean);
+#endif
+#ifdef USE_DETECT
+    uint32_t edge[MOTOR_PULSE_MAX];
+    motor_attribute(&job, edge);
+#endif
+
+    for (int i = 0; i < batch->count; ++i)
+    {
+        time[index[i]] = job.run[i] / 1000;
+#ifdef USE_DETECT
+        if (0 != edge[i])
+        {
+            time[index[i]] = edge[i] / 1000;
+        }
+#endif
+
+        if (!finished)
+        {
+            /* job lost and stopped by force, run time and edges are not 
+               trusted */
+            result[index[i]] = MOTOR_VEND_INTERRUPTED;
+        }
+        else
+        {
+#ifdef USE_CURRENT_SENSE
+            /* motor reached its switch, current fault is from other motor */
+            result[index[i]] = (0 != edge[i]) ? MOTOR_VEND_OK :
+                               motor_cur_result(signature, FALSE);
+#elif defined(USE_DETECT)
+            result[index[i]] = (0 != edge[i]) ? MOTOR_VEND_OK : 
+                               MOTOR_VEND_TIMEOUT;
+#else
+            result[index[i]] = MOTOR_VEND_OK;
+#endif
+        }
+    }
+}
+
+/**
+ * @brief motor control task
+ * @param pvParameter - parameters pass to task
+ */
+static void vMotorCtl(void *pvParameters)
+{
+    motor_order order;
+    motor_batch batch;
+    uint16_t time[MOTOR_ORDER_MAX];
+    uint8_t result[MOTOR_ORDER_MAX];
+    TickType_t start = 0;
+    uint8_t wdg = watchdog_register("MotorCtl", MOTOR_WDG_DEADLINE);
+    for (;;)
+    {
+        watchdog_checkin(wdg);
+        if (xQueueReceive(xMotorQueue, &order, WATCHDOG_CHECKIN_TIME))
+        {
+            TRACE("start order %d: %d slots\r\n", order.id, order.count);
+            start = xTaskGetTickCount();
+            while (order.count > 0)
+            {
+                motor_pack(&order, &batch);
+                /* power lost after this point never vends these slots 
+                   again */
+                journal_start(order.id, batch.slots, batch.count);
+                for (int i = 0; i < batch.count; ++i)
+                {
+                    led_motor_highlight(batch.slots[i], TRUE);
+                }
+                if (1 == batch.count)
+                {
+                    result[0] = motor_vend(batch.slots[0], time);
+                }
+                else
+                {
+                    TRACE("run %d motors on %s line %d\r\n", batch.count,
+                          batch.by_row ? "row" : "column", batch.line);
+                    motor_vend_batch(&batch, time, result);
+                }
+                
+                for (int i = 0; i < batch.count; ++i)
+                {
+                    TRACE("motor %d: time = %dms, result = %s\r\n", 
+                          batch.slots[i], time[i], 
+                          motor_result_name[result[i]]);
+                    journal_complete(order.id, batch.slots[i], result[i]);
+                    health_record(batch.slots[i], time[i], result[i]);
+                    led_motor_highlight(batch.slots[i], FALSE);
+                    if (wifi_update_vend_result(batch.slots[i], time[i], 
+                                                result[i]))
+                    {
+                        journal_report(order.id, batch.slots[i]);
+                    }
+                }
+                
+                watchdog_checkin(wdg);
+                if (order.count > 0)
+                {
+                    vTaskDelay(MOTOR_GAP_TIME);
+                }
+            }
             
-            TRACE("stop motor: %d\r\n", num);
-            stop_motor(left, right);
-            wifi_update_motor_status();
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            start = xTaskGetTickCount() - start;
+            TRACE("order finished, time = %dms\r\n", 
+                  start * portTICK_PERIOD_MS);
+            wifi_update_order_result(start * portTICK_PERIOD_MS);
         }
     }
 }
 
 /**
- * @brief initialize motor control
+ * @brief reconcile transactions left by power loss
  */
-void motor_init(void)
+static void motor_reconcile(void)
 {
-    int i = 0;
-    TRACE("initialize motor...\r\n");
-    for (; i < sizeof(motor_left) / sizeof(char *); ++i)
+    journal_entry entries[MOTOR_ORDER_MAX];
+    motor_order order;
+    uint8_t count = 0;
+
+    /* motor may have run, vend again may deliver twice */
+    while ((count = journal_pending(JOURNAL_STARTED, entries, 
+                                    MOTOR_ORDER_MAX)) > 0)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            TRACE("order %d: motor %d interrupted\r\n", entries[i].id, 
+                  entries[i].slot);
+            /* entry stays started, it is reconciled at next boot */
+            if (!journal_complete(entries[i].id, entries[i].slot, 
+                                  MOTOR_VEND_INTERRUPTED))
+            {
+                TRACE("journal write failed, reconcile stopped\r\n");
+                return ;
+            }
+        }
+    }
+
+    /* motor never ran, vend again. orders can not be queued now are resumed
+       after next boot */
+    count = journal_pending(JOURNAL_RECEIVED, entries, MOTOR_ORDER_MAX);
+    while (count > 0)
     {
-        pin_set(motor_left[i]);
-        pin_set(motor_right[i]);
+        order.id = entries[0].id;
+        order.count = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            if (entries[i].id == order.id)
+            {
+                order.slots[order.count++] = entries[i].slot;
+                entries[i--] = entries[--count];
+            }
+        }
+        TRACE("order %d: resume %d slots\r\n", order.id, order.count);
+        if (pdTRUE != xQueueSend(xMotorQueue, &order, 0))
+        {
+            break;
+        }
     }
+}
+
+/**
+ * @brief initialize motor driver, pulse timer and detect interrupt
+ */
+static void motor_hw_init(void)
+{
+    cabinet_init();
     
-    xMotorQueue = xQueueCreate(MOTOR_MSG_NUM, 1);
+    for (int i = 0; i < MOTOR_NUM; ++i)
+    {
 #ifdef USE_DETECT
-    xMotorWorking = xSemaphoreCreateBinary();
+        /* run time learned before restart */
+        motor_learned[i] = health_learned(i);
+#else
+        /* without detect every slot runs the fixed time */
+        motor_learned[i] = MOTOR_RUN_TIME;
 #endif
-    xTaskCreate(vMotorCtl, "MotorCtl", MOTOR_STACK_SIZE, 
-                NULL, MOTOR_PRIORITY, NULL);
+    }
+
+    motor_pulse_init();
     
 #ifdef USE_DETECT
     /* set pin interrupt */
-    uint8_t pin_group = 0, pin_num = 0;
-    get_pininfo(MOTOR_DET_PIN_NAME, &pin_group, &pin_num);
-    EXTI_ClrPending(pin_num);
-    GPIO_EXTIConfig((GPIO_Group)pin_group, pin_num);
-    EXTI_SetTrigger(pin_num, Trigger_Rising);
-    NVIC_Config nvicConfig = {EXTI3_IRQChannel, USART1_PRIORITY, 0, TRUE};
+    motor_det_line = pin_num(MOTOR_DET_PIN);
+    EXTI_ClrPending(motor_det_line);
+    GPIO_EXTIConfig(pin_group(MOTOR_DET_PIN), motor_det_line);
+    EXTI_SetTrigger(motor_det_line, Trigger_Rising);
+    NVIC_Config nvicConfig = {EXTI3_IRQChannel, EXTI3_PRIORITY, 0, TRUE};
     NVIC_Init(&nvicConfig);
-    EXTI_EnableLine_INT(pin_num, TRUE);
+    EXTI_EnableLine_INT(motor_det_line, TRUE);
+#endif
+
+#ifdef USE_CURRENT_SENSE
+    motorcur_init(motor_cur_fault);
 #endif
 }
 
+/**
+ * @brief initialize motor control
+ */
+void motor_init(void)
+{
+    TRACE("initialize motor...\r\n");
+    journal_init();
+    health_init();
+    xMotorQueue = xQueueCreate(MOTOR_MSG_NUM, sizeof(motor_order));
+    motor_reconcile();
+    motor_hw_init();
+    xTaskCreate(vMotorCtl, "MotorCtl", MOTOR_STACK_SIZE, 
+                NULL, MOTOR_PRIORITY, NULL);
+}
+
+/**
+ * @brief initialize motor for self test, orders are not accepted
+ */
+void motor_test_init(void)
+{
+    TRACE("initialize motor test...\r\n");
+    health_init();
+    motor_hw_init();
+}
+
+/**
+ * @brief run one vend cycle in caller task, only used in self test
+ * @param num - motor number
+ * @param time - vend run time(ms)
+ * @return vend result
+ */
+uint8_t motor_test(uint8_t num, uint16_t *time)
+{
+    assert_param(num < MOTOR_NUM);
+    return motor_vend(num, time);
+}
+
 /**
  * @brief start motor
  * @param num - motor number
  */
 void motor_start(uint8_t num)
 {
+    motor_order order;
     assert_param(num < MOTOR_NUM);
-    xQueueSend(xMotorQueue, &num, MOTOR_WAIT_TIME);
+
+    order.id = JOURNAL_NO_ID;
+    order.count = 1;
+    order.slots[0] = num;
+    xQueueSend(xMotorQueue, &order, MOTOR_WAIT_TIME);
+}
+
+/**
+ * @brief report order which is not accepted, motors never ran
+ * @param id - transaction id, JOURNAL_NO_ID if order is not journaled
+ * @param slots - motor numbers
+ * @param count - motor count
+ */
+static void motor_reject(uint16_t id, const uint8_t *slots, uint8_t count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        TRACE("motor %d: result = %s\r\n", slots[i], 
+              motor_result_name[MOTOR_VEND_REJECTED]);
+        journal_complete(id, slots[i], MOTOR_VEND_REJECTED);
+        if (wifi_update_vend_result(slots[i], 0, MOTOR_VEND_REJECTED))
+        {
+            journal_report(id, slots[i]);
+        }
+    }
+}
+
+/**
+ * @brief start vend order, order is journaled and motors are scheduled in
+ *        batches. order not accepted is reported as rejected
+ * @param slots - motor numbers
+ * @param count - motor count
+ * @return TRUE if order is accepted
+ */
+bool motor_start_order(const uint8_t *slots, uint8_t count)
+{
+    motor_order order;
+    bool recorded = FALSE;
+    assert_param(NULL != slots);
+    assert_param((count > 0) && (count <= MOTOR_ORDER_MAX));
+    
+    order.count = count;
+    for (int i = 0; i < count; ++i)
+    {
+        assert_param(slots[i] < MOTOR_NUM);
+        order.slots[i] = slots[i];
+    }
+    
+    /* journaled order must be queued once it is recorded, otherwise it is
+       completed as rejected */
+    recorded = journal_receive(slots, count, &order.id);
+    if (recorded && 
+        (pdTRUE == xQueueSend(xMotorQueue, &order, MOTOR_WAIT_TIME)))
+    {
+        return TRUE;
+    }
+
+    TRACE("order %d rejected\r\n", order.id);
+    motor_reject(order.id, slots, count);
+    return FALSE;
+}
+
+/**
+ * @brief report completed transactions which are not reported yet
+ */
+void motor_report_pending(void)
+{
+    journal_entry entries[MOTOR_ORDER_MAX];
+    uint8_t count = 0;
+
+    while ((count = journal_pending(JOURNAL_COMPLETED, entries, 
+                                    MOTOR_ORDER_MAX)) > 0)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (!wifi_update_vend_result(entries[i].slot, 0, 
+                                         entries[i].result))
+            {
+                return ;
+            }
+
+            /* entry stays completed, it is reported again at next connect */
+            if (!journal_report(entries[i].id, entries[i].slot))
+            {
+                TRACE("journal write failed, report stopped\r\n");
+                return ;
+            }
+        }
+    }
 }
 
 /**
@@ -171,24 +792,15 @@ bool motor_isopen(uint8_t num)
 {
     assert_param(num < MOTOR_NUM);
 
-    return is_pinset(motor_dect[num]);
+    return slot_sensor_isset(num);
 }
 
 /**
  * @brief get motor status
- * @return motor status
+ * @param status - slot bitmap of SLOT_WORDS words
  */
-uint16_t motor_getstatus(void)
+void motor_getstatus(uint32_t *status)
 {
-    uint16_t status = 0xffff;
-    for (int i = 0; i < MOTOR_NUM; ++i)
-    {
-        if (!is_pinset(motor_dect[i]))
-        {
-            status &= ~(1 << i);
-        }
-    }
-
-    return status;
+    slot_sensor_status(status);
 }
 
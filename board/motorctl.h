@@ -9,13 +9,30 @@
   #define _MOTORCTL_H_
 
 #include "types.h"
+#include "cabinet.h"
 
 BEGIN_DECLS
 
+/* max slots in one vend order */
+#define MOTOR_ORDER_MAX    (8)
+
+/* vend result */
+#define MOTOR_VEND_OK            (0)
+#define MOTOR_VEND_TIMEOUT       (1)
+#define MOTOR_VEND_JAM           (2)
+#define MOTOR_VEND_EMPTY         (3)
+#define MOTOR_VEND_INTERRUPTED   (4)
+/* order is not accepted, motor never ran */
+#define MOTOR_VEND_REJECTED      (5)
+
 void motor_init(void);
 void motor_start(uint8_t num);
+bool motor_start_order(const uint8_t *slots, uint8_t count);
+void motor_report_pending(void);
 bool motor_isopen(uint8_t num);
-uint16_t motor_getstatus(void);
+void motor_getstatus(uint32_t *status);
+void motor_test_init(void);
+uint8_t motor_test(uint8_t num, uint16_t *time);
 
 END_DECLS
 
@@ -0,0 +1,255 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "motorcur.h"
+#include "assert.h"
+#include "trace.h"
+#include "global.h"
+#include "stm32f10x_cfg.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[motorcur]"
+
+/* shunt amplifier output of motor driver, boards with current sense route
+   it to PB1(ADC_IN9) instead of CH10_DET */
+#define MOTOR_CUR_GROUP       GPIOB
+#define MOTOR_CUR_PIN         (1)
+#define MOTOR_CUR_CHANNEL     ADC_CHANNEL9
+
+/* shunt resistor(mOhm) and amplifier gain */
+#define MOTOR_CUR_SHUNT       (100)
+#define MOTOR_CUR_GAIN        (10)
+#define MOTOR_CUR_VREF        (3300)
+#define MOTOR_CUR_FULL_SCALE  (4095)
+#define MOTOR_CUR_TO_ADC(ma)  ((((ma) * MOTOR_CUR_SHUNT * MOTOR_CUR_GAIN) / \
+                                1000) * MOTOR_CUR_FULL_SCALE / MOTOR_CUR_VREF)
+#define MOTOR_CUR_TO_MA(adc)  ((((adc) * MOTOR_CUR_VREF) / \
+                                MOTOR_CUR_FULL_SCALE) * 1000 / \
+                               (MOTOR_CUR_SHUNT * MOTOR_CUR_GAIN))
+
+/* stall current of one motor(mA) */
+#define MOTOR_CUR_JAM_MA      (800)
+/* running current of one motor without load(mA) */
+#define MOTOR_CUR_NOLOAD_MA   (60)
+
+/* adc runs continuously at 9MHz with 239.5 cycles sample time(28us), 32
+   conversions are averaged into one sample(about 1ms) */
+#define MOTOR_CUR_OVERSAMPLE_SHIFT  (5)
+#define MOTOR_CUR_OVERSAMPLE        (1 << MOTOR_CUR_OVERSAMPLE_SHIFT)
+/* ewma filter weight 1/4 */
+#define MOTOR_CUR_EWMA_SHIFT        (2)
+/* samples ignored for startup inrush current */
+#define MOTOR_CUR_BLANK             (40)
+/* continuous samples to report signature */
+#define MOTOR_CUR_JAM_SAMPLES       (20)
+#define MOTOR_CUR_NOLOAD_SAMPLES    (80)
+
+static motorcur_fault_cb cur_fault = NULL;
+static volatile uint8_t cur_signature = MOTOR_CUR_NORMAL;
+static volatile uint16_t cur_jam_level = 0;
+static volatile uint16_t cur_noload_level = 0;
+
+/* oversample accumulator */
+static uint32_t cur_acc = 0;
+static uint8_t cur_acc_count = 0;
+/* filtered value scaled by ewma weight */
+static uint32_t cur_filter = 0;
+static uint16_t cur_samples = 0;
+static uint16_t cur_jam_count = 0;
+static uint16_t cur_noload_count = 0;
+static uint16_t cur_peak = 0;
+static uint32_t cur_sum = 0;
+static uint16_t cur_sum_count = 0;
+
+/**
+ * @brief classify one filtered current sample
+ * @param sample - averaged adc value
+ * @return new signature
+ */
+static uint8_t motorcur_classify(uint16_t sample)
+{
+    uint16_t level = 0;
+
+    /* old share is taken out before sample is added, filter settles at
+       sample scaled by ewma weight */
+    cur_filter += sample - (cur_filter >> MOTOR_CUR_EWMA_SHIFT);
+    level = (cur_filter >> MOTOR_CUR_EWMA_SHIFT);
+
+    if (cur_samples < MOTOR_CUR_BLANK)
+    {
+        cur_samples ++;
+        return MOTOR_CUR_NORMAL;
+    }
+
+    if (level > cur_peak)
+    {
+        cur_peak = level;
+    }
+    if (cur_sum_count < 0xffff)
+    {
+        cur_sum += level;
+        cur_sum_count ++;
+    }
+
+    if (level >= cur_jam_level)
+    {
+        if (++cur_jam_count >= MOTOR_CUR_JAM_SAMPLES)
+        {
+            return MOTOR_CUR_JAM;
+        }
+    }
+    else
+    {
+        cur_jam_count = 0;
+    }
+
+    if (level <= cur_noload_level)
+    {
+        if (++cur_noload_count >= MOTOR_CUR_NOLOAD_SAMPLES)
+        {
+            return MOTOR_CUR_NOLOAD;
+        }
+    }
+    else
+    {
+        cur_noload_count = 0;
+    }
+
+    return MOTOR_CUR_NORMAL;
+}
+
+/**
+ * adc conversion complete interrupt handler
+ */
+void ADC_IRQHandler(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    uint8_t signature = MOTOR_CUR_NORMAL;
+
+    /* read data register clears EOC flag */
+    cur_acc += ADC_GetRegularValue(ADC1);
+    if (++cur_acc_count < MOTOR_CUR_OVERSAMPLE)
+    {
+        return ;
+    }
+
+    signature = motorcur_classify(cur_acc >> MOTOR_CUR_OVERSAMPLE_SHIFT);
+    cur_acc = 0;
+    cur_acc_count = 0;
+    if ((MOTOR_CUR_NORMAL != signature) &&
+        (MOTOR_CUR_NORMAL == cur_signature))
+    {
+        cur_signature = signature;
+        if (NULL != cur_fault)
+        {
+            cur_fault(signature, &xHigherPriorityTaskWoken);
+        }
+    }
+
+    /* check if there is any higher priority task need to wakeup */
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief initialize motor current sense
+ * @param fault - abnormal current callback
+ */
+void motorcur_init(motorcur_fault_cb fault)
+{
+    TRACE("initialize motor current sense...\r\n");
+    cur_fault = fault;
+
+    GPIO_Config config = {MOTOR_CUR_PIN, GPIO_Speed_2MHz, GPIO_Mode_AIN};
+    GPIO_Setup(MOTOR_CUR_GROUP, &config);
+
+    RCC_APB2PeriphReset(RCC_APB2_RESET_ADC1, TRUE);
+    RCC_APB2PeriphReset(RCC_APB2_RESET_ADC1, FALSE);
+    RCC_APB2PeripClockEnable(RCC_APB2_ENABLE_ADC1, TRUE);
+
+    ADC_SetDualMode(ADC1, ADC_DUAL_MODE_INDEPENDENT);
+    ADC_SetConvertMode(ADC1, ADC_CONVERT_MODE_CONTINUOUS);
+    ADC_SetDataAlignment(ADC1, ADC_ALIGNMENT_RIGHT);
+    ADC_SetSampleCycle(ADC1, MOTOR_CUR_CHANNEL, ADC_SAMPLE_CYCLE_239_5);
+    ADC_SetRegularSequenceLength(ADC1, 1);
+    ADC_SetRegularChannel(ADC1, 0, MOTOR_CUR_CHANNEL);
+    ADC_SetTriggerMode(ADC1, ADC_CHANNEL_GROUP_REGULAR,
+                       ADC_TRIGGER_REGULAR_ADC1_2_SWSTART);
+    ADC_EnableExternalTriggerOnGroup(ADC1, ADC_CHANNEL_GROUP_REGULAR, TRUE);
+    ADC_Calibration(ADC1);
+    ADC_EnableInt(ADC1, ADC_IT_EOC, TRUE);
+
+    NVIC_Config nvicConfig = {ADC_IRQChannel, ADC_PRIORITY, 0, TRUE};
+    NVIC_Init(&nvicConfig);
+}
+
+/**
+ * @brief set signature levels for motors running at the same time
+ * @param motors - running motor count
+ */
+void motorcur_scale(uint8_t motors)
+{
+    assert_param(motors > 0);
+    cur_jam_level = MIN(MOTOR_CUR_TO_ADC(MOTOR_CUR_JAM_MA) * motors,
+                        MOTOR_CUR_FULL_SCALE - 1);
+    cur_noload_level = MOTOR_CUR_TO_ADC(MOTOR_CUR_NOLOAD_MA) * motors;
+}
+
+/**
+ * @brief start sampling motor current, should be called before motor start
+ * @param motors - running motor count
+ */
+void motorcur_start(uint8_t motors)
+{
+    motorcur_scale(motors);
+    cur_signature = MOTOR_CUR_NORMAL;
+    cur_acc = 0;
+    cur_acc_count = 0;
+    cur_filter = 0;
+    cur_samples = 0;
+    cur_jam_count = 0;
+    cur_noload_count = 0;
+    cur_peak = 0;
+    cur_sum = 0;
+    cur_sum_count = 0;
+
+    ADC_PowerOn(ADC1, TRUE);
+    ADC_InternalTriggerConversion(ADC1, ADC_CHANNEL_GROUP_REGULAR);
+}
+
+/**
+ * @brief get current signature of running motors
+ * @return current signature
+ */
+uint8_t motorcur_signature(void)
+{
+    return cur_signature;
+}
+
+/**
+ * @brief stop sampling motor current
+ * @param peak - peak current(mA)
+ * @param mean - mean current(mA)
+ * @return current signature
+ */
+uint8_t motorcur_stop(uint16_t *peak, uint16_t *mean)
+{
+    ADC_PowerOn(ADC1, FALSE);
+
+    if (NULL != peak)
+    {
+        *peak = MOTOR_CUR_TO_MA((uint32_t)cur_peak);
+    }
+
+    if (NULL != mean)
+    {
+        *mean = (0 == cur_sum_count) ? 0 :
+                MOTOR_CUR_TO_MA(cur_sum / cur_sum_count);
+    }
+
+    return cur_signature;
+}
+
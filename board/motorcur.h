@@ -0,0 +1,33 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _MOTORCUR_H_
+  #define _MOTORCUR_H_
+
+#include "types.h"
+#include "FreeRTOS.h"
+
+BEGIN_DECLS
+
+/* motor current signature */
+#define MOTOR_CUR_NORMAL    (0)
+#define MOTOR_CUR_JAM       (1)
+#define MOTOR_CUR_NOLOAD    (2)
+
+/* called in interrupt when abnormal current is detected */
+typedef void (*motorcur_fault_cb)(uint8_t signature,
+                                  portBASE_TYPE *pxHigherPriorityTaskWoken);
+
+void motorcur_init(motorcur_fault_cb fault);
+void motorcur_start(uint8_t motors);
+void motorcur_scale(uint8_t motors);
+uint8_t motorcur_signature(void);
+uint8_t motorcur_stop(uint16_t *peak, uint16_t *mean);
+
+END_DECLS
+
+#endif /* _MOTORCUR_H_ */
@@ -0,0 +1,603 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <string.h>
+#include "ota.h"
+#include "flash_page.h"
+/* state records share flash lock with other pages */
+#define OTA_PROGRAM(addr, data, len)  flash_page_program(addr, data, len)
+#include "ota_layout.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "assert.h"
+#include "trace.h"
+#include "stm32f10x_cfg.h"
+#include "flash.h"
+#include "crc32.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[ota]"
+
+/* reset after status is sent */
+#define OTA_RESET_DELAY      (2000 / portTICK_PERIOD_MS)
+
+/* views of application while patch is verified, view 0 is flash, view 1
+   is after forward part, view 2 is after reverse part */
+#define OTA_VIEW_FORWARD     (1)
+#define OTA_VIEW_REVERSE     (2)
+#define OTA_NO_RECORD        (0xffff)
+
+/* application image block, see app.icf */
+#pragma segment="APP_IMAGE"
+
+/* download state, only used in mqtt receive task */
+typedef struct
+{
+    bool active;
+    /* bytes of stream to receive and received */
+    uint32_t stream_size;
+    uint32_t received;
+    uint32_t image_size;
+    uint32_t image_crc;
+    uint32_t base_size;
+    uint32_t base_crc;
+    /* first staging page */
+    uint8_t stage;
+    /* bytes of stream written to staging */
+    uint32_t written;
+    /* stream bytes not programmed yet */
+    uint32_t word;
+}ota_download;
+
+/* reads page record of a part byte by byte */
+typedef struct
+{
+    uint8_t page;
+    const uint8_t *next;
+    ota_op op;
+    /* page offset of current operation */
+    uint16_t pos;
+}ota_cursor;
+
+static ota_download ota_dl;
+/* stream offset of record of every page written by forward and reverse
+   part */
+static uint16_t ota_index[OTA_VIEW_REVERSE][OTA_APP_PAGES];
+static ota_cursor ota_cursors[OTA_VIEW_REVERSE];
+static TimerHandle_t xOtaReset = NULL;
+
+/**
+ * @brief get little endian integer
+ * @param data - integer bytes
+ * @return integer
+ */
+static __INLINE uint32_t ota_u32(const uint8_t *data)
+{
+    return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) |
+           ((uint32_t)data[3] << 24);
+}
+
+/**
+ * @brief get pages taken by bytes
+ * @param size - bytes
+ * @return page count
+ */
+static __INLINE uint32_t ota_pages(uint32_t size)
+{
+    return (size + OTA_PAGE_SIZE - 1) / OTA_PAGE_SIZE;
+}
+
+/**
+ * @brief get start of staging
+ * @return staging address
+ */
+static __INLINE const uint8_t *ota_stage(void)
+{
+    return (const uint8_t *)(OTA_APP_ADDR + ota_dl.stage * OTA_PAGE_SIZE);
+}
+
+/**
+ * @brief calculate crc of flash words by hardware
+ * @param addr - start address
+ * @param words - word count
+ * @return crc
+ */
+static __INLINE uint32_t ota_crc(uint32_t addr, uint16_t words)
+{
+    return crc32_words((const uint32_t *)addr, words);
+}
+
+/**
+ * @brief commit configure and reset system in flash task
+ * @param arg - unused
+ */
+static void ota_reset(uint32_t arg)
+{
+    flash_sync();
+    SCB_SystemReset();
+}
+
+/**
+ * @brief reset system to patch image
+ * @param xTimer - timer handle
+ */
+static void vOtaReset(TimerHandle_t xTimer)
+{
+    /* work queue is full, try again after reset delay */
+    if (!flash_defer(ota_reset, 0))
+    {
+        xTimerReset(xTimer, 0);
+    }
+}
+
+/**
+ * @brief write stream byte to staging, page is erased when its first byte
+ *        is written
+ * @param byte - stream byte
+ * @return TRUE if byte is written
+ */
+static bool ota_output(uint8_t byte)
+{
+    uint32_t addr = (uint32_t)ota_stage() + ota_dl.written;
+    uint8_t shift = (ota_dl.written & 0x03) << 3;
+
+    if ((0 == (ota_dl.written % OTA_PAGE_SIZE)) && !flash_page_erase(addr))
+    {
+        return FALSE;
+    }
+
+    ota_dl.word &= ~(0xfful << shift);
+    ota_dl.word |= ((uint32_t)byte << shift);
+    ota_dl.written ++;
+    if (0 == (ota_dl.written & 0x03))
+    {
+        if (!flash_page_program(addr - 3, &ota_dl.word, 4))
+        {
+            return FALSE;
+        }
+        ota_dl.word = 0xffffffff;
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief check base bytes of operation are below staging and not written
+ *        by earlier records of the part
+ * @param index - records of part
+ * @param src - base offset
+ * @param len - base bytes
+ * @return TRUE if base bytes are still in flash when operation runs
+ */
+static bool ota_check_source(const uint16_t *index, uint16_t src,
+                             uint16_t len)
+{
+    if ((uint32_t)src + len > (uint32_t)ota_dl.stage * OTA_PAGE_SIZE)
+    {
+        return FALSE;
+    }
+
+    for (uint32_t page = src / OTA_PAGE_SIZE;
+         page * OTA_PAGE_SIZE < (uint32_t)src + len; ++page)
+    {
+        if (OTA_NO_RECORD != index[page])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief check records of patch part and index pages they write
+ * @param view - view made by part
+ * @param offset - part offset in stream, moved to next part
+ * @return TRUE if part is well formed
+ */
+static bool ota_check_part(uint8_t view, uint32_t *offset)
+{
+    const uint8_t *stage = ota_stage();
+    uint16_t *index = ota_index[view - 1];
+    uint32_t end = 0;
+    uint32_t next = 0;
+    uint8_t page = 0;
+    ota_op op;
+
+    memset(index, 0xff, sizeof(ota_index[0]));
+    for (;;)
+    {
+        if (*offset >= ota_dl.stream_size)
+        {
+            return FALSE;
+        }
+
+        page = stage[*offset];
+        if (OTA_PAGE_END == page)
+        {
+            (*offset) ++;
+            return TRUE;
+        }
+
+        /* every page below staging is written once */
+        end = *offset + OTA_RECORD_HEAD + ota_u16(stage + *offset + 1);
+        if ((end > ota_dl.stream_size) || (page >= ota_dl.stage) ||
+            (OTA_NO_RECORD != index[page]))
+        {
+            return FALSE;
+        }
+
+        next = *offset + OTA_RECORD_HEAD;
+        for (uint16_t pos = 0; pos < OTA_PAGE_SIZE; pos += op.len)
+        {
+            next = ota_op_parse(stage + next, &op) - stage;
+            if ((next > end) || (op.type > OTA_OP_FILL) ||
+                (op.len > OTA_PAGE_SIZE - pos) ||
+                ((op.type <= OTA_OP_ADD) &&
+                 !ota_check_source(index, op.src, op.len)))
+            {
+                return FALSE;
+            }
+        }
+
+        if (next != end)
+        {
+            return FALSE;
+        }
+        index[page] = *offset;
+        *offset = end;
+    }
+}
+
+/**
+ * @brief get byte of application in view, page written by the part of
+ *        view is read from its record, others from lower view. records are
+ *        read by cursor, so sequential bytes are cheap
+ * @param view - view
+ * @param offset - offset from application start
+ * @return byte
+ */
+static uint8_t ota_byte(uint8_t view, uint16_t offset)
+{
+    uint8_t page = offset / OTA_PAGE_SIZE;
+    uint16_t pos = offset % OTA_PAGE_SIZE;
+    uint16_t record = 0;
+    uint8_t base = 0;
+    ota_cursor *cursor = NULL;
+
+    if (0 == view)
+    {
+        return *(const uint8_t *)(OTA_APP_ADDR + offset);
+    }
+
+    record = ota_index[view - 1][page];
+    if (OTA_NO_RECORD == record)
+    {
+        return ota_byte(view - 1, offset);
+    }
+
+    cursor = &ota_cursors[view - 1];
+    if ((cursor->page != page) || (pos < cursor->pos))
+    {
+        cursor->page = page;
+        cursor->next = ota_stage() + record + OTA_RECORD_HEAD;
+        cursor->pos = 0;
+        cursor->op.len = 0;
+    }
+
+    while (pos >= cursor->pos + cursor->op.len)
+    {
+        cursor->pos += cursor->op.len;
+        cursor->next = ota_op_parse(cursor->next, &cursor->op);
+    }
+
+    pos -= cursor->pos;
+    if (cursor->op.type <= OTA_OP_ADD)
+    {
+        base = ota_byte(view - 1, cursor->op.src + pos);
+    }
+
+    return ota_op_byte(&cursor->op, pos, base);
+}
+
+/**
+ * @brief calculate hardware crc of view, words are built from view bytes
+ * @param view - view
+ * @param size - image size
+ * @return crc
+ */
+static uint32_t ota_view_crc(uint8_t view, uint32_t size)
+{
+    uint32_t crc = 0xffffffff;
+    uint32_t word = 0;
+
+    for (uint32_t offset = 0; offset < size; offset += 4)
+    {
+        word = ota_byte(view, offset) |
+               ((uint32_t)ota_byte(view, offset + 1) << 8) |
+               ((uint32_t)ota_byte(view, offset + 2) << 16) |
+               ((uint32_t)ota_byte(view, offset + 3) << 24);
+        crc = crc32_words_update(crc, word);
+    }
+
+    return crc;
+}
+
+/**
+ * @brief check patch in staging like bootloader runs it, forward part must
+ *        make new image and reverse part must make running image again
+ * @return command status
+ */
+static uint8_t ota_verify(void)
+{
+    uint32_t offset = 0;
+
+    if (!ota_check_part(OTA_VIEW_FORWARD, &offset) ||
+        !ota_check_part(OTA_VIEW_REVERSE, &offset) ||
+        (offset != ota_dl.stream_size))
+    {
+        return OTA_ERR_PATCH;
+    }
+
+    for (int i = 0; i < OTA_VIEW_REVERSE; ++i)
+    {
+        ota_cursors[i].page = OTA_PAGE_END;
+    }
+
+    if ((ota_view_crc(OTA_VIEW_FORWARD, ota_dl.image_size) !=
+         ota_dl.image_crc) ||
+        (ota_view_crc(OTA_VIEW_REVERSE, ota_dl.base_size) !=
+         ota_dl.base_crc))
+    {
+        return OTA_ERR_CRC;
+    }
+
+    return OTA_OK;
+}
+
+/**
+ * @brief start update, staging starts after running and new image
+ * @param data - command arguments
+ * @param len - argument length
+ * @return command status
+ */
+static uint8_t ota_begin(const uint8_t *data, uint32_t len)
+{
+    ota_state state;
+    uint32_t image_end = 0;
+
+    memset(&ota_dl, 0, sizeof(ota_dl));
+    if (len < 20)
+    {
+        return OTA_ERR_PARAM;
+    }
+
+    ota_dl.image_size = ota_u32(data);
+    ota_dl.image_crc = ota_u32(data + 4);
+    ota_dl.stream_size = ota_u32(data + 8);
+    ota_dl.base_size = ota_u32(data + 12);
+    ota_dl.base_crc = ota_u32(data + 16);
+    if ((0 == ota_dl.image_size) || (0 == ota_dl.stream_size) ||
+        (ota_dl.image_size > OTA_APP_SIZE) ||
+        (ota_dl.base_size > OTA_APP_SIZE))
+    {
+        return OTA_ERR_PARAM;
+    }
+
+    /* reverse part of last update is needed until trial image is
+       confirmed */
+    ota_scan(&state);
+    if (OTA_PHASE_IDLE != state.phase)
+    {
+        return OTA_ERR_BUSY;
+    }
+
+    if (ota_crc(OTA_APP_ADDR, (ota_dl.base_size + 3) >> 2) !=
+        ota_dl.base_crc)
+    {
+        return OTA_ERR_BASE;
+    }
+
+    image_end = (uint32_t)__sfe("APP_IMAGE") - OTA_APP_ADDR;
+    ota_dl.stage = ota_pages(MAX(image_end, MAX(ota_dl.base_size,
+                                                ota_dl.image_size)));
+    if ((ota_dl.stage >= OTA_APP_PAGES) ||
+        (ota_dl.stream_size >
+         (uint32_t)(OTA_APP_PAGES - ota_dl.stage) * OTA_PAGE_SIZE))
+    {
+        TRACE("stream %d bytes does not fit staging at page %d\r\n",
+              ota_dl.stream_size, ota_dl.stage);
+        return OTA_ERR_SIZE;
+    }
+
+    if (state.tail > 0)
+    {
+        flash_page_erase(OTA_STATE_ADDR);
+    }
+
+    ota_dl.word = 0xffffffff;
+    ota_dl.active = TRUE;
+    TRACE("update started: image %d bytes, stream %d bytes\r\n",
+          ota_dl.image_size, ota_dl.stream_size);
+
+    return OTA_OK;
+}
+
+/**
+ * @brief write stream data
+ * @param data - offset and data
+ * @param len - length
+ * @return command status
+ */
+static uint8_t ota_data(const uint8_t *data, uint32_t len)
+{
+    uint32_t offset = 0;
+
+    if (len < 4)
+    {
+        return OTA_ERR_PARAM;
+    }
+
+    offset = ota_u32(data);
+    data += 4;
+    len -= 4;
+    /* resent data is acknowledged again */
+    if (offset + len <= ota_dl.received)
+    {
+        return OTA_OK;
+    }
+
+    if ((offset != ota_dl.received) ||
+        (offset + len > ota_dl.stream_size))
+    {
+        return OTA_ERR_OFFSET;
+    }
+
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        if (!ota_output(data[i]))
+        {
+            TRACE("staging write failed at %d\r\n", offset + i);
+            ota_dl.active = FALSE;
+            return OTA_ERR_PATCH;
+        }
+    }
+    ota_dl.received += len;
+
+    return OTA_OK;
+}
+
+/**
+ * @brief verify patch and record it for bootloader
+ * @return command status
+ */
+static uint8_t ota_end(void)
+{
+    ota_state state;
+    uint32_t tail = (uint32_t)ota_stage() + (ota_dl.written & ~0x03);
+    uint8_t status = OTA_OK;
+
+    ota_dl.active = FALSE;
+    if (ota_dl.received != ota_dl.stream_size)
+    {
+        TRACE("stream incomplete: %d of %d bytes\r\n", ota_dl.received,
+              ota_dl.stream_size);
+        return OTA_ERR_PATCH;
+    }
+
+    /* tail word is padded with 0xff */
+    if ((0 != (ota_dl.written & 0x03)) &&
+        !flash_page_program(tail, &ota_dl.word, 4))
+    {
+        return OTA_ERR_PATCH;
+    }
+
+    status = ota_verify();
+    if (OTA_OK != status)
+    {
+        TRACE("patch rejected: %d\r\n", status);
+        return status;
+    }
+
+    ota_scan(&state);
+    ota_append(&state, OTA_TAG_SIZE, 0, (ota_dl.image_size + 3) >> 2);
+    ota_append(&state, OTA_TAG_CRC_LOW, 0, ota_dl.image_crc & 0xffff);
+    ota_append(&state, OTA_TAG_CRC_HIGH, 0, ota_dl.image_crc >> 16);
+    ota_append(&state, OTA_TAG_STAGE, 0, ota_dl.stage);
+    ota_append(&state, OTA_TAG_PENDING, 0, 0);
+    TRACE("patch verified, restart to apply\r\n");
+    xTimerStart(xOtaReset, 0);
+
+    return OTA_READY;
+}
+
+/**
+ * @brief initialize update, show state of last update
+ */
+void ota_init(void)
+{
+    ota_state state;
+
+    xOtaReset = xTimerCreate("ota", OTA_RESET_DELAY, pdFALSE, NULL,
+                             vOtaReset);
+    assert_param(NULL != xOtaReset);
+
+    ota_scan(&state);
+    if (OTA_PHASE_TRIAL == state.phase)
+    {
+        TRACE("new image on trial, boot %d of %d\r\n", state.boots,
+              OTA_TRIAL_BOOTS);
+    }
+    else if ((state.tail > 0) &&
+             (OTA_TAG_REVERTED ==
+              ((const ota_record *)OTA_STATE_ADDR)[state.tail - 1].tag))
+    {
+        TRACE("new image failed, reverted\r\n");
+    }
+}
+
+/**
+ * @brief process update command
+ * @param data - command
+ * @param len - command length
+ * @param offset - stream offset expected next
+ * @return command status
+ */
+uint8_t ota_process(const uint8_t *data, uint32_t len, uint32_t *offset)
+{
+    uint8_t status = OTA_OK;
+    assert_param(NULL != offset);
+
+    if (0 == len)
+    {
+        status = OTA_ERR_PARAM;
+    }
+    else if (OTA_CMD_BEGIN == data[0])
+    {
+        status = ota_begin(data + 1, len - 1);
+    }
+    else if (OTA_CMD_ABORT == data[0])
+    {
+        TRACE("update aborted\r\n");
+        ota_dl.active = FALSE;
+    }
+    else if (!ota_dl.active)
+    {
+        status = OTA_ERR_IDLE;
+    }
+    else if (OTA_CMD_DATA == data[0])
+    {
+        status = ota_data(data + 1, len - 1);
+    }
+    else if (OTA_CMD_END == data[0])
+    {
+        status = ota_end();
+    }
+    else
+    {
+        status = OTA_ERR_PARAM;
+    }
+
+    *offset = ota_dl.received;
+    return status;
+}
+
+/**
+ * @brief confirm image on trial works, called when server is connected
+ */
+void ota_confirm(void)
+{
+    ota_state state;
+
+    ota_scan(&state);
+    if (OTA_PHASE_TRIAL == state.phase)
+    {
+        ota_append(&state, OTA_TAG_CONFIRM, 0, 0);
+        TRACE("new image confirmed\r\n");
+    }
+}
@@ -0,0 +1,57 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _OTA_H_
+  #define _OTA_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* update commands, integers are little endian
+   'B' image size(4) image crc(4) stream size(4) base size(4) base crc(4)
+                                    begin, base is the running image
+   'D' offset(4) data               stream data at offset
+   'E'                              end, verify patch and restart
+   'A'                              abort
+   crc is stm32 hardware crc of image padded with 0xff to words, words are
+   read little endian */
+#define OTA_CMD_BEGIN        ('B')
+#define OTA_CMD_DATA         ('D')
+#define OTA_CMD_END          ('E')
+#define OTA_CMD_ABORT        ('A')
+
+/* stream is the patch from base to new image and back, it is stored in
+   pages after both images, see ota_layout.h for its format. a whole image
+   is sent as a patch of data operations, which only fits while images are
+   small */
+
+/* command status */
+#define OTA_OK               (0)
+/* image is verified, system restarts to swap it in */
+#define OTA_READY            (1)
+/* last update is not finished */
+#define OTA_ERR_BUSY         (2)
+#define OTA_ERR_PARAM        (3)
+/* running image is not the base of patch */
+#define OTA_ERR_BASE         (4)
+/* data is not at expected offset, resend from returned offset */
+#define OTA_ERR_OFFSET       (5)
+#define OTA_ERR_PATCH        (6)
+#define OTA_ERR_CRC          (7)
+/* no update is started */
+#define OTA_ERR_IDLE         (8)
+/* stream does not fit pages after images */
+#define OTA_ERR_SIZE         (9)
+
+void ota_init(void);
+uint8_t ota_process(const uint8_t *data, uint32_t len, uint32_t *offset);
+void ota_confirm(void);
+
+END_DECLS
+
+#endif /* _OTA_H_ */
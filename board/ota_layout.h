@@ -0,0 +1,293 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _OTA_LAYOUT_H_
+  #define _OTA_LAYOUT_H_
+
+#include "types.h"
+#include "stm32f10x_cfg.h"
+
+BEGIN_DECLS
+
+/* flash layout shared by bootloader and application, 64K and 1K pages
+   0x8000000  bootloader       4K
+   0x8001000  application     51K, image first, staging in pages after
+                                   running and new image
+   0x800DC00  health           1K, second checkpoint page
+   0x800E000  patch scratch    1K
+   0x800E400  update state     1K
+   0x800E800  configure, reset record, journal and health */
+#define OTA_PAGE_SIZE        (1024)
+#define OTA_BOOT_ADDR        (0x8000000)
+#define OTA_APP_ADDR         (0x8001000)
+#define OTA_APP_PAGES        (51)
+#define OTA_APP_SIZE         (OTA_APP_PAGES * OTA_PAGE_SIZE)
+#define OTA_SCRATCH_ADDR     (0x800E000)
+#define OTA_STATE_ADDR       (0x800E400)
+
+#define OTA_RAM_ADDR         (0x20000000)
+#define OTA_RAM_SIZE         (0x5000)
+
+/* trial image is reverted after this many boots without confirm */
+#define OTA_TRIAL_BOOTS      (3)
+
+/* update state is a log of records appended to state page, page is erased
+   by application when a new update starts. record is programmed as two
+   half words, tag first, so record with erased arg is a broken write */
+typedef struct
+{
+    uint8_t tag;
+    uint8_t page;
+    uint16_t arg;
+}ota_record;
+#define OTA_RECORD_MAX       (OTA_PAGE_SIZE / sizeof(ota_record))
+#define OTA_ARG_ERASED       (0xffff)
+
+/* state records are programmed by driver in bootloader, application 
+   defines this before including this file to go through its flash lock */
+#ifndef OTA_PROGRAM
+  #define OTA_PROGRAM(addr, data, len)  FLASH_Write(addr, (uint8_t *)(data), \
+                                                    len)
+#endif
+
+/* patch in staging is verified, size, crc and stage records are written
+   before pending, so they are complete if pending is */
+#define OTA_TAG_SIZE         (0x01)  /* arg: new image words */
+#define OTA_TAG_CRC_LOW      (0x02)  /* arg: low half of new image crc */
+#define OTA_TAG_CRC_HIGH     (0x03)  /* arg: high half of new image crc */
+#define OTA_TAG_PENDING      (0x04)
+/* step of patch record is done, steps are
+   0: page is built in ram and saved to scratch
+   1: scratch to application */
+#define OTA_TAG_STEP         (0x05)  /* page: record index, arg: step */
+#define OTA_STEP_COUNT       (2)
+/* new image is patched in and runs on trial */
+#define OTA_TAG_TRIAL        (0x06)
+#define OTA_TAG_BOOT         (0x07)
+/* application confirmed new image, update is finished */
+#define OTA_TAG_CONFIRM      (0x08)
+/* trial failed, reverse patch restores old image */
+#define OTA_TAG_REVERT       (0x09)
+#define OTA_TAG_REVERTED     (0x0a)
+#define OTA_TAG_STAGE        (0x0b)  /* arg: first staging page */
+#define OTA_TAG_ERASED       (0xff)
+
+/* staging holds forward part, which turns running image into new image,
+   then reverse part, which turns new image back. part is page records
+   ended by OTA_PAGE_END, record is
+     page(1) size(2) operations(size)
+   page is application page the record writes. operations build the whole
+   page, operation is
+     type(1) length(2) [source(2)] [data]
+   source is offset of base bytes from application start, base is the image
+   part is applied to. integers are little endian. records of a part run in
+   order, every page is written once and a record never reads pages
+   written by earlier records of its part, so base bytes are read from
+   flash as they are */
+#define OTA_PAGE_END         (0xff)
+#define OTA_OP_COPY          (0x00)  /* source: page bytes are base bytes */
+#define OTA_OP_ADD           (0x01)  /* source, data: base bytes plus data */
+#define OTA_OP_DATA          (0x02)  /* data: page bytes */
+#define OTA_OP_FILL          (0x03)  /* byte(1): page bytes are the byte */
+#define OTA_RECORD_HEAD      (3)
+
+typedef struct
+{
+    uint8_t type;
+    uint16_t len;
+    uint16_t src;
+    const uint8_t *data;
+}ota_op;
+
+/* update phase */
+#define OTA_PHASE_IDLE       (0)
+#define OTA_PHASE_PENDING    (1)
+#define OTA_PHASE_TRIAL      (2)
+#define OTA_PHASE_REVERT     (3)
+
+typedef struct
+{
+    uint8_t phase;
+    /* trial boots */
+    uint8_t boots;
+    /* patch steps done in pending or revert phase */
+    uint16_t steps;
+    /* first staging page */
+    uint8_t stage;
+    /* image words and crc */
+    uint16_t words;
+    uint32_t crc;
+    /* index of next free record */
+    uint16_t tail;
+}ota_state;
+
+/**
+ * @brief get little endian half word
+ * @param data - half word bytes
+ * @return half word
+ */
+static __INLINE uint16_t ota_u16(const uint8_t *data)
+{
+    return data[0] | ((uint16_t)data[1] << 8);
+}
+
+/**
+ * @brief parse patch operation
+ * @param data - operation
+ * @param op - parsed operation
+ * @return next operation
+ */
+static __INLINE const uint8_t *ota_op_parse(const uint8_t *data, ota_op *op)
+{
+    op->type = data[0];
+    op->len = ota_u16(data + 1);
+    op->src = 0;
+    data += 3;
+    if ((OTA_OP_COPY == op->type) || (OTA_OP_ADD == op->type))
+    {
+        op->src = ota_u16(data);
+        data += 2;
+    }
+
+    op->data = data;
+    if (OTA_OP_FILL == op->type)
+    {
+        data ++;
+    }
+    else if (OTA_OP_COPY != op->type)
+    {
+        data += op->len;
+    }
+
+    return data;
+}
+
+/**
+ * @brief get page byte built by patch operation
+ * @param op - operation
+ * @param i - byte index in operation
+ * @param base - base byte at operation source plus index
+ * @return page byte
+ */
+static __INLINE uint8_t ota_op_byte(const ota_op *op, uint16_t i,
+                                    uint8_t base)
+{
+    switch (op->type)
+    {
+    case OTA_OP_COPY:
+        return base;
+    case OTA_OP_ADD:
+        return base + op->data[i];
+    case OTA_OP_DATA:
+        return op->data[i];
+    default:
+        return op->data[0];
+    }
+}
+
+/**
+ * @brief replay update state records
+ * @param state - update state
+ */
+static __INLINE void ota_scan(ota_state *state)
+{
+    const ota_record *record = (const ota_record *)OTA_STATE_ADDR;
+    uint16_t i = 0;
+
+    state->phase = OTA_PHASE_IDLE;
+    state->boots = 0;
+    state->steps = 0;
+    state->words = 0;
+    state->crc = 0;
+    state->stage = 0;
+    for (i = 0; i < OTA_RECORD_MAX; ++i, ++record)
+    {
+        if (OTA_TAG_ERASED == record->tag)
+        {
+            break;
+        }
+
+        switch (record->tag)
+        {
+        case OTA_TAG_SIZE:
+            state->words = record->arg;
+            break;
+        case OTA_TAG_CRC_LOW:
+            state->crc = (state->crc & 0xffff0000) | record->arg;
+            break;
+        case OTA_TAG_CRC_HIGH:
+            state->crc = (state->crc & 0xffff) | ((uint32_t)record->arg << 16);
+            break;
+        case OTA_TAG_STAGE:
+            state->stage = record->arg;
+            break;
+        case OTA_TAG_PENDING:
+        case OTA_TAG_REVERT:
+            if (OTA_ARG_ERASED != record->arg)
+            {
+                state->phase = (OTA_TAG_PENDING == record->tag) ?
+                               OTA_PHASE_PENDING : OTA_PHASE_REVERT;
+                state->steps = 0;
+            }
+            break;
+        case OTA_TAG_STEP:
+            if (OTA_ARG_ERASED != record->arg)
+            {
+                state->steps = record->page * OTA_STEP_COUNT +
+                               record->arg + 1;
+            }
+            break;
+        case OTA_TAG_TRIAL:
+            if (OTA_ARG_ERASED != record->arg)
+            {
+                state->phase = OTA_PHASE_TRIAL;
+                state->boots = 0;
+            }
+            break;
+        case OTA_TAG_BOOT:
+            state->boots ++;
+            break;
+        case OTA_TAG_CONFIRM:
+        case OTA_TAG_REVERTED:
+            if (OTA_ARG_ERASED != record->arg)
+            {
+                state->phase = OTA_PHASE_IDLE;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    state->tail = i;
+}
+
+/**
+ * @brief append record to update state page
+ * @param state - update state
+ * @param tag - record tag
+ * @param page - record page
+ * @param arg - record argument
+ * @return TRUE if record is written
+ */
+static __INLINE bool ota_append(ota_state *state, uint8_t tag, uint8_t page,
+                                uint16_t arg)
+{
+    ota_record record = {tag, page, arg};
+    if (state->tail >= OTA_RECORD_MAX)
+    {
+        return FALSE;
+    }
+
+    OTA_PROGRAM(OTA_STATE_ADDR + state->tail * sizeof(ota_record), &record,
+                sizeof(record));
+    state->tail ++;
+    return TRUE;
+}
+
+END_DECLS
+
+#endif /* _OTA_LAYOUT_H_ */
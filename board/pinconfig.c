@@ -5,15 +5,14 @@
 *
 * See the COPYING file for the terms of usage and distribution.
 */
-#include <string.h>
 #include "pinconfig.h"
 #include "stm32f10x_cfg.h"
+#include "cabinet.h"
 
 
 /* pin configure structure */
 typedef struct 
 {
-    char name[16];
     GPIO_Group group;
     GPIO_Config config;
 }PIN_CONFIG;
@@ -34,51 +33,17 @@ typedef struct
 }PIN_CLOCK;
 
 
-/* pin arrays */
-PIN_CONFIG pins[] = 
+/* pin arrays, generated from board pin table */
+static const PIN_CONFIG pins[] = 
 {
-    {"CON_L1", GPIOC, 9, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CON_L2", GPIOC, 8, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CON_L3", GPIOC, 7, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CON_L4", GPIOC, 6, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CON_R1", GPIOB, 12, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CON_R2", GPIOB, 13, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CON_R3", GPIOB, 14, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CON_R4", GPIOB, 15, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"CH1_DET", GPIOA, 0, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH2_DET", GPIOA, 1, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH3_DET", GPIOA, 4, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH4_DET", GPIOA, 5, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH5_DET", GPIOA, 6, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH6_DET", GPIOA, 7, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH7_DET", GPIOC, 4, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH8_DET", GPIOC, 5, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH9_DET", GPIOB, 0, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"CH10_DET", GPIOB, 1, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"MOT_DET", GPIOC, 3, GPIO_Speed_2MHz, GPIO_Mode_IPD},
-    {"DEBUG_TX", GPIOA, 9, GPIO_Speed_50MHz, GPIO_Mode_AF_PP},
-    {"DEBUG_RX", GPIOA, 10, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"WIFI_TX", GPIOA, 2, GPIO_Speed_50MHz, GPIO_Mode_AF_PP},
-    {"WIFI_RX", GPIOA, 3, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"WIFI_RST", GPIOC, 14, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"WIFI_EN", GPIOC, 15, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"GPRS_TX", GPIOB, 10, GPIO_Speed_50MHz, GPIO_Mode_AF_PP},
-    {"GPRS_RX", GPIOB, 11, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"GPRS_PWR", GPIOC, 13, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"LED_ERROR", GPIOB, 3, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"LED_NET", GPIOB, 4, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"LED_MQTT", GPIOB, 5, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"IR_IN", GPIOB, 2, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"SWITCH1", GPIOB, 7, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"SWITCH2", GPIOB, 8, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"MODE_SET", GPIOB, 6, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING},
-    {"LED_DATA", GPIOC, 0, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"LED_ST", GPIOC, 1, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
-    {"LED_SH", GPIOC, 2, GPIO_Speed_2MHz, GPIO_Mode_Out_PP},
+#define PIN_CONFIG_ENTRY(name, group, num, speed, mode) \
+    {group, {num, speed, mode}},
+    PIN_TABLE(PIN_CONFIG_ENTRY)
+#undef PIN_CONFIG_ENTRY
 };
 
 /* clock arrays */
-PIN_CLOCK pin_clocks[] = 
+static const PIN_CLOCK pin_clocks[] = 
 {
     {AHB, RCC_AHB_ENABLE_CRC, RCC_AHB_ENABLE_CRC},
     {APB2, RCC_APB2_RESET_AFIO, RCC_APB2_ENABLE_AFIO},
@@ -90,23 +55,6 @@ PIN_CLOCK pin_clocks[] =
     {APB1, RCC_APB1_RESET_USART3, RCC_APB1_ENABLE_USART3},
 };
 
-/**
- * @brief get pin configuration by name
- * @param name - pin name
- * @return pin configuration
- */
-static const PIN_CONFIG *get_pinconfig(const char *name)
-{
-    uint32_t len = sizeof(pins) / sizeof(PIN_CONFIG);
-    for(uint32_t i = 0; i < len; ++i)
-    {
-        if(strcmp(name, pins[i].name) == 0)
-            return &pins[i];
-    }
-    
-    return NULL;
-}
-
 /**
  * @brief init pins
  */
@@ -146,74 +94,91 @@ void pin_init(void)
 }
 
 /**
- * @brief set pin
- * @param name - pin name
+ * @brief resolve pin to bit-band alias, used when pin is chosen at runtime
+ * @param id - pin id
+ * @param pin - pin handle
  */
-void pin_set(const char *name)
+void pin_resolve(pin_id id, pin_handle *pin)
 {
-    const PIN_CONFIG *config = get_pinconfig(name);
-    assert_param(config != NULL);
-    GPIO_SetPin(config->group, config->config.pin);
+    assert_param(PIN_NONE != id);
+    assert_param(pin != NULL);
+    pin->out = GPIO_OutputBitBand(pin_group(id), pin_num(id));
+    pin->in = GPIO_InputBitBand(pin_group(id), pin_num(id));
 }
 
 /**
- * @brief reset pin
- * @param name - pin name
+ * @brief precompute port masks and shifts of pin bank
+ * @param bank - pin bank
+ * @param pins - pins of bank, pin n is bit n of snapshot
+ * @param count - pin count, 32 at most
  */
-void pin_reset(const char *name)
+void pin_bank_init(pin_bank *bank, const pin_id *pins, uint8_t count)
 {
-    const PIN_CONFIG *config = get_pinconfig(name);
-    assert_param(config != NULL);
-    GPIO_ResetPin(config->group, config->config.pin);
-}
-
-/**
- * @brief toggle pin 
- * @param name - pin name
- */
-void pin_toggle(const char *name)
-{
-    const PIN_CONFIG *config = get_pinconfig(name);
-    assert_param(config != NULL);
-    if (GPIO_ReadPin(config->group, config->config.pin) != 0)
-    {
-        GPIO_ResetPin(config->group, config->config.pin);
-    }
-    else
+    GPIO_Group group = GPIOA;
+    uint8_t port = 0;
+    pin_run *run = NULL;
+    assert_param(NULL != bank);
+    assert_param(count <= 32);
+
+    bank->port_count = 0;
+    bank->run_count = 0;
+    for (uint8_t i = 0; i < count; ++i)
     {
-        GPIO_SetPin(config->group, config->config.pin);
+        group = pin_group(pins[i]);
+        for (port = 0; port < bank->port_count; ++port)
+        {
+            if (bank->ports[port] == group)
+            {
+                break;
+            }
+        }
+
+        if (port == bank->port_count)
+        {
+            assert_param(bank->port_count < PIN_BANK_PORTS);
+            bank->ports[bank->port_count++] = group;
+        }
+
+        /* extend last run if pin and bit both follow it */
+        if ((NULL != run) && (run->port == port) &&
+            (run->shift + run->width == pin_num(pins[i])) &&
+            (run->bit + run->width == i))
+        {
+            run->width ++;
+        }
+        else
+        {
+            assert_param(bank->run_count < PIN_BANK_RUNS);
+            run = &bank->runs[bank->run_count++];
+            run->port = port;
+            run->shift = pin_num(pins[i]);
+            run->width = 1;
+            run->bit = i;
+        }
     }
 }
-/**
- * @brief check if pin is set
- * @param name - pin name
- */
-bool is_pinset(const char *name)
-{
-    const PIN_CONFIG *config = get_pinconfig(name);
-    assert_param(config != NULL);
-    return (GPIO_ReadPin(config->group, config->config.pin) != 0);
-}
 
 /**
- * @brief get pin information
- * @param name - pin name
- * @param group - pin group
- * @param num - pin number
+ * @brief read pin bank, ports are read back to back before packing
+ * @param bank - pin bank
+ * @return snapshot, bit n is level of pin n
  */
-void get_pininfo(const char *name, uint8_t *group, uint8_t *num)
+uint32_t pin_bank_read(const pin_bank *bank)
 {
-    assert_param(name != NULL);
-    const PIN_CONFIG *config = get_pinconfig(name);
-    assert_param(config != NULL);
-    if (NULL != group)
+    uint32_t data[PIN_BANK_PORTS];
+    uint32_t value = 0;
+    const pin_run *run = bank->runs;
+
+    for (uint8_t i = 0; i < bank->port_count; ++i)
     {
-        *group = config->group;
+        data[i] = GPIO_IDR(bank->ports[i]);
     }
 
-    if (NULL != num)
+    for (uint8_t i = 0; i < bank->run_count; ++i, ++run)
     {
-        *num = config->config.pin;
+        value |= ((data[run->port] >> run->shift) & 
+                  ((1ul << run->width) - 1)) << run->bit;
     }
-}
 
+    return value;
+}
@@ -9,15 +9,170 @@
   #define _PINCONFIG_H_
 
 #include "types.h"
+#include "stm32f10x_gpio.h"
+#include "pintable.h"
 
 BEGIN_DECLS
 
+/* pin id holds gpio group and pin number, so pin access needs no lookup */
+#define PIN_ID(group, num)   (((group) << 4) | (num))
+
+typedef enum
+{
+#define PIN_ENUM(name, group, num, speed, mode) \
+    PIN_##name = PIN_ID(group, num),
+    PIN_TABLE(PIN_ENUM)
+#undef PIN_ENUM
+    /* no pin connected */
+    PIN_NONE = 0xff,
+}pin_id;
+
+/* resolved pin, bit-band alias of pin output and input data */
+typedef struct
+{
+    volatile uint32_t *out;
+    volatile uint32_t *in;
+}pin_handle;
+
+/* pins read in one snapshot, one data register read per gpio port. 
+   consecutive pins that map to consecutive snapshot bits make one run */
+#define PIN_BANK_PORTS   (3)
+#define PIN_BANK_RUNS    (8)
+typedef struct
+{
+    /* port index in bank */
+    uint8_t port;
+    /* run is pin shift to shift + width - 1 of port */
+    uint8_t shift;
+    uint8_t width;
+    /* first snapshot bit of run */
+    uint8_t bit;
+}pin_run;
+
+typedef struct
+{
+    uint8_t port_count;
+    uint8_t run_count;
+    GPIO_Group ports[PIN_BANK_PORTS];
+    pin_run runs[PIN_BANK_RUNS];
+}pin_bank;
+
 void pin_init(void);
-void pin_set(const char *name);
-void pin_reset(const char *name);
-void pin_toggle(const char *name);
-bool is_pinset(const char *name);
-void get_pininfo(const char *name, uint8_t *group, uint8_t *num);
+void pin_resolve(pin_id id, pin_handle *pin);
+void pin_bank_init(pin_bank *bank, const pin_id *pins, uint8_t count);
+uint32_t pin_bank_read(const pin_bank *bank);
+
+/**
+ * @brief get gpio group of pin
+ * @param id - pin id
+ * @return gpio group
+ */
+static __INLINE GPIO_Group pin_group(pin_id id)
+{
+    return (GPIO_Group)(id >> 4);
+}
+
+/**
+ * @brief get pin number in gpio group
+ * @param id - pin id
+ * @return pin number
+ */
+static __INLINE uint8_t pin_num(pin_id id)
+{
+    return (uint8_t)(id & 0x0f);
+}
+
+/**
+ * @brief set pin
+ * @param id - pin id
+ */
+static __INLINE void pin_set(pin_id id)
+{
+    GPIO_BSRR(pin_group(id)) = (1ul << pin_num(id));
+}
+
+/**
+ * @brief reset pin
+ * @param id - pin id
+ */
+static __INLINE void pin_reset(pin_id id)
+{
+    GPIO_BRR(pin_group(id)) = (1ul << pin_num(id));
+}
+
+/**
+ * @brief write pin
+ * @param id - pin id
+ * @param set - pin level
+ */
+static __INLINE void pin_write(pin_id id, bool set)
+{
+    if (set)
+    {
+        pin_set(id);
+    }
+    else
+    {
+        pin_reset(id);
+    }
+}
+
+/**
+ * @brief toggle pin
+ * @param id - pin id
+ */
+static __INLINE void pin_toggle(pin_id id)
+{
+    pin_write(id, 0 == (GPIO_ODR(pin_group(id)) & (1ul << pin_num(id))));
+}
+
+/**
+ * @brief check if pin is set
+ * @param id - pin id
+ * @return pin level
+ */
+static __INLINE bool is_pinset(pin_id id)
+{
+    return (0 != (GPIO_IDR(pin_group(id)) & (1ul << pin_num(id))));
+}
+
+/**
+ * @brief set resolved pin
+ * @param pin - pin handle
+ */
+static __INLINE void pin_handle_set(const pin_handle *pin)
+{
+    *pin->out = 1;
+}
+
+/**
+ * @brief reset resolved pin
+ * @param pin - pin handle
+ */
+static __INLINE void pin_handle_reset(const pin_handle *pin)
+{
+    *pin->out = 0;
+}
+
+/**
+ * @brief write resolved pin
+ * @param pin - pin handle
+ * @param set - pin level
+ */
+static __INLINE void pin_handle_write(const pin_handle *pin, bool set)
+{
+    *pin->out = set;
+}
+
+/**
+ * @brief check if resolved pin is set
+ * @param pin - pin handle
+ * @return pin level
+ */
+static __INLINE bool pin_handle_isset(const pin_handle *pin)
+{
+    return (0 != *pin->in);
+}
 
 END_DECLS
 
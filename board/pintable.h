@@ -0,0 +1,88 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _PINTABLE_H_
+  #define _PINTABLE_H_
+
+#include "cabinet.h"
+
+/* board pin description, X(name, group, pin, speed, mode). pin ids, flash
+   configuration table and pin functions are all generated from this table,
+   see pinconfig.h */
+
+#ifdef CABINET_ROW_PWM
+  /* TIM3 full remap channel 4 to 1 */
+  #define PIN_TABLE_ROW(X) \
+    X(CON_L1, GPIOC, 9, GPIO_Speed_10MHz, GPIO_Mode_AF_PP) \
+    X(CON_L2, GPIOC, 8, GPIO_Speed_10MHz, GPIO_Mode_AF_PP) \
+    X(CON_L3, GPIOC, 7, GPIO_Speed_10MHz, GPIO_Mode_AF_PP) \
+    X(CON_L4, GPIOC, 6, GPIO_Speed_10MHz, GPIO_Mode_AF_PP)
+#elif defined(CABINET_DRIVER_GPIO)
+  #define PIN_TABLE_ROW(X) \
+    X(CON_L1, GPIOC, 9, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(CON_L2, GPIOC, 8, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(CON_L3, GPIOC, 7, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(CON_L4, GPIOC, 6, GPIO_Speed_2MHz, GPIO_Mode_Out_PP)
+#else
+  #define PIN_TABLE_ROW(X)
+#endif
+
+#ifdef CABINET_DRIVER_GPIO
+  #define PIN_TABLE_DRIVER(X) \
+    X(CON_R1, GPIOB, 12, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(CON_R2, GPIOB, 13, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(CON_R3, GPIOB, 14, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(CON_R4, GPIOB, 15, GPIO_Speed_2MHz, GPIO_Mode_Out_PP)
+#elif defined(CABINET_DRIVER_SPI)
+  /* motor driver 74hc595 chain shifted by spi2 */
+  #define PIN_TABLE_DRIVER(X) \
+    X(DRV_ST, GPIOB, 12, GPIO_Speed_10MHz, GPIO_Mode_Out_PP) \
+    X(DRV_SH, GPIOB, 13, GPIO_Speed_50MHz, GPIO_Mode_AF_PP) \
+    X(DRV_DATA, GPIOB, 15, GPIO_Speed_50MHz, GPIO_Mode_AF_PP)
+#else
+  /* motor driver 74hc595 chain on spi2 pins */
+  #define PIN_TABLE_DRIVER(X) \
+    X(DRV_ST, GPIOB, 12, GPIO_Speed_10MHz, GPIO_Mode_Out_PP) \
+    X(DRV_SH, GPIOB, 13, GPIO_Speed_10MHz, GPIO_Mode_Out_PP) \
+    X(DRV_DATA, GPIOB, 15, GPIO_Speed_10MHz, GPIO_Mode_Out_PP)
+#endif
+
+#define PIN_TABLE(X) \
+    PIN_TABLE_ROW(X) \
+    PIN_TABLE_DRIVER(X) \
+    X(CH1_DET, GPIOA, 0, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH2_DET, GPIOA, 1, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH3_DET, GPIOA, 4, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH4_DET, GPIOA, 5, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH5_DET, GPIOA, 6, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH6_DET, GPIOA, 7, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH7_DET, GPIOC, 4, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH8_DET, GPIOC, 5, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH9_DET, GPIOB, 0, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(CH10_DET, GPIOB, 1, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(MOT_DET, GPIOC, 3, GPIO_Speed_2MHz, GPIO_Mode_IPD) \
+    X(DEBUG_TX, GPIOA, 9, GPIO_Speed_50MHz, GPIO_Mode_AF_PP) \
+    X(DEBUG_RX, GPIOA, 10, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(WIFI_TX, GPIOA, 2, GPIO_Speed_50MHz, GPIO_Mode_AF_PP) \
+    X(WIFI_RX, GPIOA, 3, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(WIFI_RST, GPIOC, 14, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(WIFI_EN, GPIOC, 15, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(GPRS_TX, GPIOB, 10, GPIO_Speed_50MHz, GPIO_Mode_AF_PP) \
+    X(GPRS_RX, GPIOB, 11, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(GPRS_PWR, GPIOC, 13, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(LED_ERROR, GPIOB, 3, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(LED_NET, GPIOB, 4, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(LED_MQTT, GPIOB, 5, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(IR_IN, GPIOB, 2, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(SWITCH1, GPIOB, 7, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(SWITCH2, GPIOB, 8, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(MODE_SET, GPIOB, 6, GPIO_Speed_2MHz, GPIO_Mode_IN_FLOATING) \
+    X(LED_DATA, GPIOC, 0, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(LED_ST, GPIOC, 1, GPIO_Speed_2MHz, GPIO_Mode_Out_PP) \
+    X(LED_SH, GPIOC, 2, GPIO_Speed_2MHz, GPIO_Mode_Out_PP)
+
+#endif /* _PINTABLE_H_ */
@@ -0,0 +1,68 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "power.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "assert.h"
+#include "trace.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[power]"
+
+/* typical supply current of stm32f103 at 72MHz with peripherals enabled,
+   in run mode and sleep mode(uA) */
+#define POWER_RUN_CURRENT     (36000)
+#define POWER_SLEEP_CURRENT   (14400)
+
+static TickType_t power_window_start = 0;
+static TickType_t power_sleep_start = 0;
+static TickType_t power_slept = 0;
+
+/**
+ * @brief tickless idle starts, called by idle task with scheduler suspended
+ * @param tick - tick count before sleep
+ */
+void power_sleep_begin(uint32_t tick)
+{
+    power_sleep_start = tick;
+}
+
+/**
+ * @brief tickless idle ends, tick count is already corrected
+ * @param tick - tick count after sleep
+ */
+void power_sleep_end(uint32_t tick)
+{
+    power_slept += tick - power_sleep_start;
+}
+
+/**
+ * @brief get power statistics and start a new window
+ * @param stat - power statistics
+ */
+void power_take_stat(power_stat *stat)
+{
+    assert_param(NULL != stat);
+    TickType_t now = 0;
+    TickType_t window = 0;
+    TickType_t slept = 0;
+
+    taskENTER_CRITICAL();
+    now = xTaskGetTickCount();
+    window = MAX(now - power_window_start, 1);
+    slept = MIN(power_slept, window);
+    power_window_start = now;
+    power_slept = 0;
+    taskEXIT_CRITICAL();
+
+    stat->idle = (uint64_t)slept * 100 / window;
+    stat->current = (POWER_SLEEP_CURRENT * (uint64_t)slept +
+                     POWER_RUN_CURRENT * (uint64_t)(window - slept)) /
+                    window / 1000;
+    TRACE("idle = %d%%, current = %dmA\r\n", stat->idle, stat->current);
+}
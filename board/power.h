@@ -0,0 +1,30 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _POWER_H_
+  #define _POWER_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* power statistics since last taken */
+typedef struct
+{
+    /* time slept in tickless idle(percent) */
+    uint8_t idle;
+    /* estimated mcu supply current(mA) */
+    uint16_t current;
+}power_stat;
+
+void power_sleep_begin(uint32_t tick);
+void power_sleep_end(uint32_t tick);
+void power_take_stat(power_stat *stat);
+
+END_DECLS
+
+#endif /* _POWER_H_ */
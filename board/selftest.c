@@ -0,0 +1,313 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "selftest.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "assert.h"
+#include "trace.h"
+#include "dbgserial.h"
+#include "pinconfig.h"
+#include "motorctl.h"
+#include "led_motor.h"
+#include "led_net.h"
+#include "slot_sensor.h"
+#include "crc32.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[selftest]"
+
+/* report line is "step,item,pass,value", step summary uses item "all" 
+   with failed item count and step time(ms) */
+#define SELFTEST_MOTOR    "motor"
+#define SELFTEST_SENSOR   "sensor"
+#define SELFTEST_LED      "led"
+#define SELFTEST_MODEM    "modem"
+#define SELFTEST_CRC      "crc"
+
+/* sensor is sampled during window, level must be stable */
+#define SELFTEST_SENSOR_SAMPLES  (10)
+#define SELFTEST_SENSOR_PERIOD   (10 / portTICK_PERIOD_MS)
+#define SELFTEST_LED_TIME        (50 / portTICK_PERIOD_MS)
+#define SELFTEST_NET_LED_TIME    (200 / portTICK_PERIOD_MS)
+#define SELFTEST_GAP_TIME        (100 / portTICK_PERIOD_MS)
+
+/* step summaries and failed items are kept for network report, room of
+   summaries is reserved */
+#define SELFTEST_RESULT_MAX      (16)
+#define SELFTEST_SUMMARY_MAX     (6)
+typedef struct
+{
+    const char *step;
+    /* item number, SELFTEST_ALL for step summary */
+    uint8_t item;
+    bool pass;
+    uint16_t value;
+}selftest_result;
+#define SELFTEST_ALL             (0xff)
+
+static selftest_result selftest_results[SELFTEST_RESULT_MAX];
+static uint8_t selftest_count = 0;
+static uint8_t selftest_failed = 0;
+
+/**
+ * @brief format one result
+ * @param result - test result
+ * @param buf - output buffer
+ */
+static void selftest_line(const selftest_result *result, char *buf)
+{
+    if (SELFTEST_ALL == result->item)
+    {
+        sprintf(buf, "%s,all,%d,%d", result->step, result->pass, 
+                result->value);
+    }
+    else
+    {
+        sprintf(buf, "%s,%d,%d,%d", result->step, result->item, 
+                result->pass, result->value);
+    }
+}
+
+/**
+ * @brief output result to debug serial, keep it for network report if 
+ *        needed
+ * @param step - test step
+ * @param item - item number
+ * @param pass - item pass flag
+ * @param value - item value
+ */
+static void selftest_add(const char *step, uint8_t item, bool pass, 
+                         uint16_t value)
+{
+    selftest_result result = {step, item, pass, value};
+    char line[32];
+
+    selftest_line(&result, line);
+    strcat(line, "\r\n");
+    dbg_putstring(line, strlen(line));
+
+    if (SELFTEST_ALL == item)
+    {
+        if (selftest_count < SELFTEST_RESULT_MAX)
+        {
+            selftest_results[selftest_count++] = result;
+        }
+    }
+    else if (!pass)
+    {
+        selftest_failed ++;
+        if (selftest_count < SELFTEST_RESULT_MAX - SELFTEST_SUMMARY_MAX)
+        {
+            selftest_results[selftest_count++] = result;
+        }
+    }
+}
+
+/**
+ * @brief add step summary
+ * @param step - test step
+ * @param failed - failed items
+ * @param start - step start tick
+ */
+static void selftest_summary(const char *step, uint8_t failed, 
+                             TickType_t start)
+{
+    selftest_add(step, SELFTEST_ALL, (0 == failed), 
+                 (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+}
+
+/**
+ * @brief run every motor one cycle, value is run time(ms)
+ */
+static void selftest_motor(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    uint8_t failed = 0;
+    uint8_t result = MOTOR_VEND_OK;
+    uint16_t time = 0;
+
+    for (int i = 0; i < MOTOR_NUM; ++i)
+    {
+        result = motor_test(i, &time);
+        if (MOTOR_VEND_OK != result)
+        {
+            failed ++;
+        }
+        selftest_add(SELFTEST_MOTOR, i, (MOTOR_VEND_OK == result), time);
+        vTaskDelay(SELFTEST_GAP_TIME);
+    }
+    selftest_summary(SELFTEST_MOTOR, failed, start);
+}
+
+/**
+ * @brief sample every slot sensor, value is sensor level. floating or 
+ *        broken sensor changes during sample window
+ */
+static void selftest_sensor(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    uint8_t failed = 0;
+    uint8_t highs[MOTOR_NUM];
+    uint32_t status[SLOT_WORDS];
+
+    memset(highs, 0, MOTOR_NUM);
+    for (int n = 0; n < SELFTEST_SENSOR_SAMPLES; ++n)
+    {
+        slot_sensor_sample(status);
+        for (int i = 0; i < MOTOR_NUM; ++i)
+        {
+            if (slot_test(status, i))
+            {
+                highs[i] ++;
+            }
+        }
+        vTaskDelay(SELFTEST_SENSOR_PERIOD);
+    }
+
+    for (int i = 0; i < MOTOR_NUM; ++i)
+    {
+        if (PIN_NONE == cabinet_slots[i].det)
+        {
+            continue;
+        }
+
+        if ((0 != highs[i]) && (SELFTEST_SENSOR_SAMPLES != highs[i]))
+        {
+            failed ++;
+            selftest_add(SELFTEST_SENSOR, i, FALSE, highs[i]);
+        }
+        else
+        {
+            selftest_add(SELFTEST_SENSOR, i, TRUE, (0 != highs[i]));
+        }
+    }
+    selftest_summary(SELFTEST_SENSOR, failed, start);
+}
+
+/**
+ * @brief walk motor led chain and network leds, leds are checked by eyes
+ */
+static void selftest_led(void)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    led_motor_all_off();
+    for (int i = 0; i < MOTOR_NUM; ++i)
+    {
+        led_motor_turn_on(i);
+        vTaskDelay(SELFTEST_LED_TIME);
+        led_motor_turn_off(i);
+    }
+    led_motor_all_on();
+    vTaskDelay(SELFTEST_NET_LED_TIME);
+    led_motor_all_off();
+
+    for (int i = 0; i < LED_ID_COUNT; ++i)
+    {
+        led_net_set_action((led_id)i, on);
+        vTaskDelay(SELFTEST_NET_LED_TIME);
+        led_net_set_action((led_id)i, off);
+    }
+    selftest_summary(SELFTEST_LED, 0, start);
+}
+
+/**
+ * @brief compare software crc, hardware crc of bytes and words and dma fed
+ *        crc, value is time(us per KB). hardware results must match
+ */
+static void selftest_crc(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    crc32_bench_result result;
+
+    crc32_bench(&result);
+    selftest_add(SELFTEST_CRC, 0, TRUE, result.soft);
+    selftest_add(SELFTEST_CRC, 1, result.match, result.bytes);
+    selftest_add(SELFTEST_CRC, 2, result.match, result.words);
+    selftest_add(SELFTEST_CRC, 3, result.match, result.dma);
+    selftest_summary(SELFTEST_CRC, result.match ? 0 : 3, start);
+}
+
+/**
+ * @brief bring up network module, value is startup time(ms)
+ * @param modem - modem startup function
+ */
+static void selftest_modem(selftest_modem_cb modem)
+{
+    TickType_t start = xTaskGetTickCount();
+    bool pass = modem();
+
+    selftest_add(SELFTEST_MODEM, 0, pass, 
+                 (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+    selftest_summary(SELFTEST_MODEM, pass ? 0 : 1, start);
+}
+
+/**
+ * @brief run self test, motors, led and sensors must be initialized
+ * @param modem - modem startup function
+ */
+void selftest_run(selftest_modem_cb modem)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    TRACE("start self test...\r\n");
+    selftest_count = 0;
+    selftest_failed = 0;
+    selftest_sensor();
+    selftest_motor();
+    selftest_led();
+    selftest_crc();
+    if (NULL != modem)
+    {
+        selftest_modem(modem);
+    }
+
+    selftest_add("test", SELFTEST_ALL, (0 == selftest_failed), 
+                 (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+    if (0 == selftest_failed)
+    {
+        led_net_set_action(LED_ID_ERROR, off);
+    }
+    else
+    {
+        led_net_set_code(LED_ID_ERROR, LED_CODE_SELFTEST);
+    }
+}
+
+/**
+ * @brief format kept results as "step,item,pass,value;" entries
+ * @param index - first result to format, updated to next result
+ * @param buf - output buffer
+ * @param len - buffer length
+ * @return formatted result count
+ */
+uint8_t selftest_format(uint8_t *index, char *buf, uint16_t len)
+{
+    char entry[32];
+    uint16_t used = 0;
+    uint8_t count = 0;
+
+    buf[0] = 0x00;
+    for (; *index < selftest_count; ++(*index))
+    {
+        selftest_line(&selftest_results[*index], entry);
+        strcat(entry, ";");
+        if (used + strlen(entry) >= len)
+        {
+            break;
+        }
+        strcpy(buf + used, entry);
+        used += strlen(entry);
+        count ++;
+    }
+
+    return count;
+}
+
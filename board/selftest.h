@@ -0,0 +1,23 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _SELFTEST_H_
+  #define _SELFTEST_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* brings up network module and checks its command loopback */
+typedef bool (*selftest_modem_cb)(void);
+
+void selftest_run(selftest_modem_cb modem);
+uint8_t selftest_format(uint8_t *index, char *buf, uint16_t len);
+
+END_DECLS
+
+#endif /* _SELFTEST_H_ */
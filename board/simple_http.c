@@ -131,6 +131,7 @@ static void vHttpd(void *pvParameters)
     
     vTaskDelay(1000 / portTICK_PERIOD_MS);
     flash_set_ssid_pwd(ssid, pwd);
+    flash_sync();
     vTaskDelay(1000 / portTICK_PERIOD_MS);
     SCB_SystemReset();
     
@@ -0,0 +1,178 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <string.h>
+#include "slot_sensor.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "assert.h"
+#include "trace.h"
+#include "pinconfig.h"
+#include "global.h"
+#include "cabinet.h"
+#include "watchdog.h"
+#include "stm32f10x_cfg.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[slot]"
+
+/* sample period, slot status is accepted after SLOT_DEBOUNCE same samples */
+#define SLOT_SAMPLE_TIME    (10 / portTICK_PERIOD_MS)
+#define SLOT_DEBOUNCE       (3)
+#define SLOT_WDG_DEADLINE   (2000 / portTICK_PERIOD_MS)
+
+/* detect pins are read in one snapshot, bit n is slot slot_det_slot[n] */
+static pin_bank slot_det_bank;
+static uint8_t slot_det_slot[MOTOR_NUM];
+static uint8_t slot_det_count = 0;
+static bool slot_det_ready = FALSE;
+
+static uint32_t slot_history[SLOT_DEBOUNCE][SLOT_WORDS];
+static uint32_t slot_stable[SLOT_WORDS];
+static slot_sensor_cb slot_changed = NULL;
+
+/**
+ * @brief build pin bank of slots with sensor
+ */
+static void slot_setup(void)
+{
+    pin_id pins[MOTOR_NUM];
+
+    slot_det_count = 0;
+    for (int i = 0; i < MOTOR_NUM; ++i)
+    {
+        if (PIN_NONE != cabinet_slots[i].det)
+        {
+            pins[slot_det_count] = (pin_id)cabinet_slots[i].det;
+            slot_det_slot[slot_det_count++] = i;
+        }
+    }
+
+    assert_param(slot_det_count <= 32);
+    pin_bank_init(&slot_det_bank, pins, slot_det_count);
+    slot_det_ready = TRUE;
+}
+
+/**
+ * @brief slot sensor sample task
+ * @param pvParameters - task parameter
+ */
+static void vSlotSensor(void *pvParameters)
+{
+    uint8_t index = 0;
+    bool changed = FALSE;
+    uint32_t set = 0, reset = 0, status = 0;
+    TickType_t wake = xTaskGetTickCount();
+    uint8_t wdg = watchdog_register("SlotSensor", SLOT_WDG_DEADLINE);
+    for (;;)
+    {
+        vTaskDelayUntil(&wake, SLOT_SAMPLE_TIME);
+        watchdog_checkin(wdg);
+        slot_sensor_sample(slot_history[index]);
+        index = (index + 1) % SLOT_DEBOUNCE;
+
+        /* bits stay same in all history samples are stable */
+        changed = FALSE;
+        for (int word = 0; word < SLOT_WORDS; ++word)
+        {
+            set = 0xffffffff;
+            reset = 0;
+            for (int i = 0; i < SLOT_DEBOUNCE; ++i)
+            {
+                set &= slot_history[i][word];
+                reset |= slot_history[i][word];
+            }
+            status = (slot_stable[word] | set) & reset;
+            if (status != slot_stable[word])
+            {
+                TRACE("slot status changed: word %d, 0x%08x -> 0x%08x\r\n", 
+                      word, slot_stable[word], status);
+                slot_stable[word] = status;
+                changed = TRUE;
+            }
+        }
+        
+        if (changed && (NULL != slot_changed))
+        {
+            slot_changed(slot_stable);
+        }
+    }
+}
+
+/**
+ * @brief initialize slot sensor
+ */
+void slot_sensor_init(void)
+{
+    TRACE("initialize slot sensor...\r\n");
+    slot_setup();
+    slot_sensor_sample(slot_stable);
+    for (int i = 0; i < SLOT_DEBOUNCE; ++i)
+    {
+        memcpy(slot_history[i], slot_stable, sizeof(slot_stable));
+    }
+
+    xTaskCreate(vSlotSensor, "SlotSensor", SLOT_SENSOR_STACK_SIZE, 
+                NULL, SLOT_SENSOR_PRIORITY, NULL);
+}
+
+/**
+ * @brief attach slot status changed callback
+ * @param cb - callback function
+ */
+void slot_sensor_attach(slot_sensor_cb cb)
+{
+    slot_changed = cb;
+}
+
+/**
+ * @brief get debounced slot status, bit set means slot is open
+ * @param status - slot bitmap of SLOT_WORDS words
+ */
+void slot_sensor_status(uint32_t *status)
+{
+    assert_param(NULL != status);
+    taskENTER_CRITICAL();
+    memcpy(status, slot_stable, sizeof(slot_stable));
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief check if slot is open
+ * @param num - slot number
+ * @return open status
+ */
+bool slot_sensor_isset(uint8_t num)
+{
+    assert_param(num < MOTOR_NUM);
+    return slot_test(slot_stable, num);
+}
+
+/**
+ * @brief read raw status of all detect pins in one snapshot, used without
+ *        sample task in self test
+ * @param status - slot bitmap of SLOT_WORDS words
+ */
+void slot_sensor_sample(uint32_t *status)
+{
+    uint32_t data = 0;
+    assert_param(NULL != status);
+    if (!slot_det_ready)
+    {
+        slot_setup();
+    }
+
+    data = pin_bank_read(&slot_det_bank);
+    memset(status, 0, SLOT_WORDS * sizeof(uint32_t));
+    for (int i = 0; i < slot_det_count; ++i)
+    {
+        if (0 != (data & (1ul << i)))
+        {
+            slot_set(status, slot_det_slot[i]);
+        }
+    }
+}
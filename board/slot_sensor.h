@@ -0,0 +1,27 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _SLOT_SENSOR_H_
+  #define _SLOT_SENSOR_H_
+
+#include "types.h"
+
+BEGIN_DECLS
+
+/* called in sensor task when debounced slot status changed */
+typedef void (*slot_sensor_cb)(const uint32_t *status);
+
+void slot_sensor_init(void);
+void slot_sensor_attach(slot_sensor_cb cb);
+void slot_sensor_status(uint32_t *status);
+bool slot_sensor_isset(uint8_t num);
+void slot_sensor_sample(uint32_t *status);
+
+END_DECLS
+
+
+#endif /* _SLOT_SENSOR_H_ */
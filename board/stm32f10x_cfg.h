@@ -27,6 +27,10 @@
 #define _MODULE_I2C
 #define _MODULE_EXTI
 #define _MODULE_SIG
+#define _MODULE_TIM
+#define _MODULE_DMA
+#define _MODULE_IWDG
+#define _MODULE_CRC
 
 /**********************************************************/
 #ifdef _MODULE_CRC
@@ -81,6 +85,18 @@
   #include "stm32f10x_sig.h"
 #endif
 
+#ifdef _MODULE_TIM
+  #include "stm32f10x_tim.h"
+#endif
+
+#ifdef _MODULE_DMA
+  #include "stm32f10x_dma.h"
+#endif
+
+#ifdef _MODULE_IWDG
+  #include "stm32f10x_iwdg.h"
+#endif
+
 
 #endif /* _STM32F10x_CFG_H_ */
 
@@ -0,0 +1,242 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include <string.h>
+#include "watchdog.h"
+#include "task.h"
+#include "event_groups.h"
+#include "assert.h"
+#include "trace.h"
+#include "global.h"
+#include "stm32f10x_cfg.h"
+#include "flash_page.h"
+
+#undef __TRACE_MODULE
+#define __TRACE_MODULE  "[watchdog]"
+
+/* 0x800F000, 1K */
+#define WATCHDOG_ADDR        0x800F000
+
+/* supervisor checks heartbeats and feeds iwdg in this period */
+#define WATCHDOG_PERIOD      (500 / portTICK_PERIOD_MS)
+
+/* lsi is 30KHz to 60KHz, 40KHz / 64 / 2500 is about 4s, no less than 2.6s
+   at fastest lsi */
+#define WATCHDOG_PRESCALER   IWDG_PR_DIV64
+#define WATCHDOG_RELOAD      (2500)
+
+/* one event bit for every supervised task */
+#define WATCHDOG_TASK_MAX    (8)
+#define WATCHDOG_BITS_ALL    ((1ul << WATCHDOG_TASK_MAX) - 1)
+
+typedef struct
+{
+    const char *name;
+    /* 0 if task is unregistered */
+    TickType_t deadline;
+    TickType_t last;
+}watchdog_task;
+
+/* reset reason record, written before iwdg resets system. page is erased
+   on every write, one record a reset never wears it out */
+typedef struct
+{
+    uint16_t magic;
+    /* resets by watchdog since page is erased */
+    uint16_t count;
+    /* seconds since startup */
+    uint32_t uptime;
+    char name[configMAX_TASK_NAME_LEN];
+}watchdog_record;
+#define WATCHDOG_MAGIC       (0x5744)
+
+static watchdog_task watchdog_tasks[WATCHDOG_TASK_MAX];
+static uint8_t watchdog_count = 0;
+static EventGroupHandle_t xWatchdogEvent = NULL;
+/* reset flags of last reset */
+static uint8_t watchdog_reset = 0;
+
+/**
+ * @brief write name of late task to reset reason record
+ * @param task - late task
+ */
+static void watchdog_save(const watchdog_task *task)
+{
+    watchdog_record record;
+
+    FLASH_Read(WATCHDOG_ADDR, (uint8_t *)&record, sizeof(record));
+    if (WATCHDOG_MAGIC != record.magic)
+    {
+        record.count = 0;
+    }
+    record.magic = WATCHDOG_MAGIC;
+    record.count ++;
+    record.uptime = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
+    memset(record.name, 0, sizeof(record.name));
+    strncpy(record.name, task->name, sizeof(record.name) - 1);
+
+    /* late task may hold flash lock, iwdg resets system anyway and record
+       is lost then */
+    flash_page_write(WATCHDOG_ADDR, &record, sizeof(record));
+}
+
+/**
+ * @brief show reason of last reset
+ */
+static void watchdog_show_reset(void)
+{
+    watchdog_record record;
+
+    TRACE("reset flags: 0x%02x\r\n", watchdog_reset);
+    if (0 == (watchdog_reset & RCC_RESET_IWDG))
+    {
+        return ;
+    }
+
+    FLASH_Read(WATCHDOG_ADDR, (uint8_t *)&record, sizeof(record));
+    if (WATCHDOG_MAGIC == record.magic)
+    {
+        record.name[sizeof(record.name) - 1] = 0x00;
+        TRACE("reset by watchdog(%d): task %s late, uptime %ds\r\n",
+              record.count, record.name, record.uptime);
+    }
+    else
+    {
+        /* supervisor itself is stuck */
+        TRACE("reset by watchdog: no record\r\n");
+    }
+}
+
+/**
+ * @brief supervisor task, iwdg is fed only when all registered tasks
+ *        checked in within their deadlines
+ * @param pvParameters - task parameter
+ */
+static void vWatchdog(void *pvParameters)
+{
+    EventBits_t bits = 0;
+    TickType_t now = 0;
+    watchdog_task *late = NULL;
+    bool expired = FALSE;
+
+    watchdog_show_reset();
+
+    IWDG_SetClockPrescaler(WATCHDOG_PRESCALER);
+    IWDG_SetReloadValue(WATCHDOG_RELOAD);
+    IWDG_Feed();
+    IWDG_Startup();
+
+    for (;;)
+    {
+        vTaskDelay(WATCHDOG_PERIOD);
+        bits = xEventGroupClearBits(xWatchdogEvent, WATCHDOG_BITS_ALL);
+        now = xTaskGetTickCount();
+        late = NULL;
+        for (int i = 0; i < watchdog_count; ++i)
+        {
+            if (0 == watchdog_tasks[i].deadline)
+            {
+                continue;
+            }
+
+            if (0 != (bits & (1ul << i)))
+            {
+                watchdog_tasks[i].last = now;
+            }
+            else if ((now - watchdog_tasks[i].last) >
+                     watchdog_tasks[i].deadline)
+            {
+                late = &watchdog_tasks[i];
+            }
+        }
+
+        if (NULL == late)
+        {
+            IWDG_Feed();
+        }
+        else if (!expired)
+        {
+            /* late task may hold trace lock, save record first */
+            expired = TRUE;
+            watchdog_save(late);
+            TRACE("task %s late, wait reset\r\n", late->name);
+        }
+    }
+}
+
+/**
+ * @brief initialize watchdog supervisor, should be called before scheduler
+ *        starts
+ */
+void watchdog_init(void)
+{
+    watchdog_reset = RCC_GetResetFlag();
+    RCC_ClrResetFlag();
+
+    xWatchdogEvent = xEventGroupCreate();
+    assert_param(NULL != xWatchdogEvent);
+    xTaskCreate(vWatchdog, "Watchdog", WATCHDOG_STACK_SIZE, NULL,
+                WATCHDOG_PRIORITY, NULL);
+}
+
+/**
+ * @brief register task to supervisor, task should check in periodically
+ *        after this
+ * @param name - task name saved in reset record
+ * @param deadline - max time between check ins
+ * @return task id, WATCHDOG_NONE if no id is free
+ */
+uint8_t watchdog_register(const char *name, TickType_t deadline)
+{
+    uint8_t id = WATCHDOG_NONE;
+    assert_param(NULL != name);
+    assert_param(deadline > 0);
+
+    taskENTER_CRITICAL();
+    if (watchdog_count < WATCHDOG_TASK_MAX)
+    {
+        id = watchdog_count;
+        watchdog_tasks[id].name = name;
+        watchdog_tasks[id].deadline = deadline;
+        watchdog_tasks[id].last = xTaskGetTickCount();
+        watchdog_count ++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (WATCHDOG_NONE == id)
+    {
+        TRACE("no id for task %s\r\n", name);
+    }
+
+    return id;
+}
+
+/**
+ * @brief stop supervising task, should be called before task is deleted
+ * @param id - task id
+ */
+void watchdog_unregister(uint8_t id)
+{
+    if (id < WATCHDOG_TASK_MAX)
+    {
+        taskENTER_CRITICAL();
+        watchdog_tasks[id].deadline = 0;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/**
+ * @brief report task is alive
+ * @param id - task id
+ */
+void watchdog_checkin(uint8_t id)
+{
+    if (id < WATCHDOG_TASK_MAX)
+    {
+        xEventGroupSetBits(xWatchdogEvent, 1ul << id);
+    }
+}
@@ -0,0 +1,29 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _WATCHDOG_H_
+  #define _WATCHDOG_H_
+
+#include "types.h"
+#include "FreeRTOS.h"
+
+BEGIN_DECLS
+
+/* supervised tasks block at most this time between check ins */
+#define WATCHDOG_CHECKIN_TIME    (1000 / portTICK_PERIOD_MS)
+
+/* task is not supervised */
+#define WATCHDOG_NONE            (0xff)
+
+void watchdog_init(void);
+uint8_t watchdog_register(const char *name, TickType_t deadline);
+void watchdog_unregister(uint8_t id);
+void watchdog_checkin(uint8_t id);
+
+END_DECLS
+
+#endif /* _WATCHDOG_H_ */
@@ -21,11 +21,26 @@
 #include "led_net.h"
 #include "mode.h"
 #include "flash.h"
+#include "flash_page.h"
+#include "slot_sensor.h"
+#include "health.h"
+#include "ir.h"
+#include "power.h"
+#include "selftest.h"
+#include "modeswitch.h"
+#include "watchdog.h"
+#include "ota.h"
 
 #undef __TRACE_MODULE
 #define __TRACE_MODULE  "[wifi]"
 
 #define DEFAULT_TIMEOUT      (3000 / portTICK_PERIOD_MS)
+/* motor health report period */
+#define HEALTH_REPORT_PERIOD (60 * 60 * 1000 / portTICK_PERIOD_MS)
+/* all reports are published in this time */
+#define STATE_WDG_DEADLINE   (20000 / portTICK_PERIOD_MS)
+/* report entries of one message, limited by mqtt message size */
+#define REPORT_LEN           (80)
 
 static char g_ssid[32];
 static char g_pwd[32];
@@ -36,6 +51,16 @@ static char g_pwd[32];
 static uint8_t g_id[25];
 static char topic_control[36];
 static char topic_state[31];
+static char topic_vend[30];
+static char topic_health[32];
+static char topic_occupancy[36];
+static char topic_power[32];
+static char topic_flash[31];
+static char topic_test[30];
+static char topic_config[32];
+static char topic_mode[30];
+static char topic_ota[29];
+static char topic_otastate[34];
 
 /* mqtt information */
 #define MQTT_ID        2
@@ -47,7 +72,18 @@ uint8_t mqtt_status = 0x00;
 
 bool ap_connected = FALSE;
 
-static uint16_t g_motor_num = 0;
+/* vend orders received but not released yet. mqtt packet id is only 
+   unique in one session and is reused after pubcomp, so orders are 
+   deduplicated by packet id only between publish and pubrel */
+#define ORDER_HELD_MAX    (4)
+typedef struct
+{
+    uint16_t id;
+    uint8_t count;
+    uint8_t slots[MOTOR_ORDER_MAX];
+}held_order;
+static held_order g_orders[ORDER_HELD_MAX];
+static uint8_t g_order_count = 0;
 
 #define LED_AP            (1)
 #define LED_MQTT          (2)
@@ -55,6 +91,12 @@ static uint16_t g_motor_num = 0;
 static TaskHandle_t xConnectMqttTask = NULL;
 static TaskHandle_t xHeartTask = NULL; 
 static TaskHandle_t xMotorStateTask = NULL; 
+/* periodic reports are published at next wakeup */
+static volatile bool report_requested = FALSE;
+/* mode received from server, applied in motor state task */
+static mode_config g_mode_request;
+static bool g_restart_request = FALSE;
+static volatile bool mode_requested = FALSE;
 static TaskHandle_t xConnectApTask = NULL; 
 
 #define PWD_RESET_COUNT    10
@@ -67,8 +109,8 @@ static void esp8266_ap_connect(void)
 {
     err_count = 0;
     
-    led_net_set_action("LED_NET", on);
-    led_net_set_action("LED_MQTT", flash);
+    led_net_set_action(LED_ID_NET, on);
+    led_net_set_action(LED_ID_MQTT, flash);
     ap_connected = TRUE;
 }
 
@@ -84,8 +126,8 @@ static void esp8266_ap_disconnect(void)
         flash_restore();
     }
     
-    led_net_set_action("LED_NET", flash);
-    led_net_set_action("LED_MQTT", off);
+    led_net_set_action(LED_ID_NET, flash);
+    led_net_set_action(LED_ID_MQTT, off);
     ap_connected = FALSE;
     mqtt_notify_disconnect();
     mqtt_status = 0x00;
@@ -174,7 +216,7 @@ static void init_m26_driver(void)
  */
 static void vConnectAp(void *pvParameters)
 {
-    led_net_set_action("LED_NET", flash);
+    led_net_set_action(LED_ID_NET, flash);
     for (;;)
     {
         if (FALSE == ap_connected)
@@ -204,7 +246,8 @@ static void vHeart(void *pvParameters)
         {
             mqtt_pingreq();
         }
-        vTaskDelay(9000 / portTICK_PERIOD_MS);
+        /* server allows 1.5 times keep alive */
+        vTaskDelay((mode_keepalive() + 1) * 1000 / portTICK_PERIOD_MS);
     }
 }
 
@@ -229,7 +272,7 @@ static void vConnectMqtt(void *pvParameters)
                 connect_param param;
                 param.flag.flag = 0x02;
                 param.client_id = (const char *)g_id;
-                param.alive_time = 8;
+                param.alive_time = mode_keepalive();
                 mqtt_connect(&param);
                 }
                 break;
@@ -245,33 +288,109 @@ static void vConnectMqtt(void *pvParameters)
 }
 
 /**
- * @brief motor state process task
+ * @brief slot status changed callback
+ * @param status - slot status
+ */
+static void slot_status_changed(const uint32_t *status)
+{
+    UNUSED(status);
+    xTaskNotifyGive(xMotorStateTask);
+}
+
+/**
+ * @brief apply mode received from server, restart only changed subsystems.
+ *        network and work mode run after system restarts
+ */
+static void wifi_apply_mode(void)
+{
+    mode_config config;
+    bool restart = FALSE;
+    uint8_t changed = 0;
+
+    taskENTER_CRITICAL();
+    config = g_mode_request;
+    restart = g_restart_request;
+    taskEXIT_CRITICAL();
+    changed = mode_set(&config);
+    if (0 != (changed & MODE_CHANGED_LED))
+    {
+        ir_apply_mode();
+    }
+
+    wifi_update_mode();
+    if (restart || mode_pending())
+    {
+        /* mode report is sent before reset delay ends */
+        TRACE("restart to apply mode\r\n");
+        modeswitch_restart();
+    }
+    else if (0 != (changed & MODE_CHANGED_ALIVE))
+    {
+        /* connect again with new keep alive */
+        TRACE("restart mqtt session\r\n");
+        mqtt_disconnect();
+        mqtt_status = 0x00;
+    }
+}
+
+/**
+ * @brief mode button short press, publish status and periodic reports now
+ */
+static void status_report_requested(void)
+{
+    report_requested = TRUE;
+    xTaskNotifyGive(xMotorStateTask);
+}
+
+/**
+ * @brief motor state process task, publish slot status when it changed or
+ *        mqtt connected, apply mode from server, publish motor health, 
+ *        occupancy, power and flash wear periodically or when requested
  */
 static void vMotorState(void *pvParameters)
 {
-    uint16_t status = 0;
-    uint8_t status_str[11];
-    status_str[10] = 0x00;
+    TickType_t last = xTaskGetTickCount();
+    TickType_t elapse = 0;
+    TickType_t wait = 0;
+    uint8_t wdg = watchdog_register("motorstate", STATE_WDG_DEADLINE);
     for (;;)
     {
-        if (0x03 == mqtt_status)
+        watchdog_checkin(wdg);
+        elapse = xTaskGetTickCount() - last;
+        wait = (elapse >= HEALTH_REPORT_PERIOD) ? 0 :
+               MIN(HEALTH_REPORT_PERIOD - elapse, WATCHDOG_CHECKIN_TIME);
+        if (ulTaskNotifyTake(pdTRUE, wait) > 0)
         {
-            status = motor_getstatus();
-            for (int i = 0; i < 10; ++i)
+            if (mode_requested)
             {
-                if (status & 0x01)
-                {
-                    status_str[i] = '1';
-                }
-                else
+                mode_requested = FALSE;
+                wifi_apply_mode();
+            }
+
+            if (0x03 == mqtt_status)
+            {
+                wifi_update_motor_status();
+                /* vend results completed while offline or before power 
+                   loss */
+                motor_report_pending();
+                if (MODE_WORK_NORMAL != mode_work())
                 {
-                    status_str[i] = '0';
+                    wifi_update_selftest();
                 }
-                status >>= 1;
-            }
-            mqtt_publish(topic_state, (const char *)status_str, 0, 0, 0);
-        }   
-        vTaskDelay(1800000 / portTICK_PERIOD_MS);
+            }   
+        }
+
+        if (report_requested ||
+            ((xTaskGetTickCount() - last) >= HEALTH_REPORT_PERIOD))
+        {
+            report_requested = FALSE;
+            last = xTaskGetTickCount();
+            health_poll();
+            wifi_update_health();
+            wifi_update_occupancy();
+            wifi_update_power();
+            wifi_update_flash();
+        }
     }
 }
 
@@ -282,23 +401,293 @@ static void mqtt_connack_cb(uint8_t status)
 {
     if (MQTT_ERR_OK == status)
     {
-        led_net_set_action("LED_MQTT", on);
+        led_net_set_action(LED_ID_MQTT, on);
         mqtt_status |= 0x02;
+        /* clean session, server keeps no unreleased order of last 
+           session and packet ids start again */
+        g_order_count = 0;
         /* register sn */
         mqtt_publish(TOPIC_REGISTER, (const char *)g_id, 0, 1, 0);
 
         /* subscribe topic */
         mqtt_subscribe(topic_control, 2);
+        mqtt_subscribe(topic_config, 1);
+        mqtt_subscribe(topic_ota, 0);
+
+        /* image on trial reached server */
+        ota_confirm();
+        
+        /* server needs slot status after connected */
+        if (NULL != xMotorStateTask)
+        {
+            xTaskNotifyGive(xMotorStateTask);
+        }
+    }
+}
+
+/**
+ * @brief set field of mode message
+ * @param key - key
+ * @param value - value
+ * @param config - mode to update
+ * @param restart - set if restart is requested
+ * @return FALSE if key is unknown or value does not fit field
+ */
+static bool mode_parse_field(const char *key, uint32_t value,
+                             mode_config *config, bool *restart)
+{
+    uint8_t *field = NULL;
+
+    if (0 == strcmp(key, "net"))
+    {
+        field = &config->net;
+    }
+    else if (0 == strcmp(key, "work"))
+    {
+        field = &config->work;
+    }
+    else if (0 == strcmp(key, "led"))
+    {
+        field = &config->led;
+    }
+    else if (0 == strcmp(key, "hold"))
+    {
+        field = &config->ir_hold;
+    }
+    else if (0 == strcmp(key, "alive"))
+    {
+        if (value > 0xffff)
+        {
+            return FALSE;
+        }
+        config->keepalive = value;
+        return TRUE;
+    }
+    else if (0 == strcmp(key, "restart"))
+    {
+        if (value > 1)
+        {
+            return FALSE;
+        }
+        *restart = (1 == value);
+        return TRUE;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    if (value > 0xff)
+    {
+        return FALSE;
+    }
+    *field = value;
+    return TRUE;
+}
+
+/**
+ * @brief parse mode message, "key=value" pairs separated by ','. keys are
+ *        net, work, led, hold, alive and restart, missing keys keep saved
+ *        values
+ * @param data - message
+ * @param len - message length
+ * @param config - mode to update
+ * @param restart - set if restart is requested by restart=1
+ * @return FALSE if message is malformed or any value is out of range
+ */
+static bool mode_parse(const uint8_t *data, uint32_t len, 
+                       mode_config *config, bool *restart)
+{
+    char key[8];
+    uint8_t key_len = 0;
+    uint32_t value = 0;
+    uint8_t digits = 0;
+    bool in_value = FALSE;
+    char c = 0;
+
+    *restart = FALSE;
+    for (int i = 0; i <= len; ++i)
+    {
+        c = (i < len) ? data[i] : ',';
+        if (',' == c)
+        {
+            if (in_value)
+            {
+                key[key_len] = 0x00;
+                if ((0 == digits) || 
+                    !mode_parse_field(key, value, config, restart))
+                {
+                    return FALSE;
+                }
+            }
+            else if (key_len > 0)
+            {
+                return FALSE;
+            }
+            key_len = 0;
+            value = 0;
+            digits = 0;
+            in_value = FALSE;
+        }
+        else if ('=' == c)
+        {
+            in_value = TRUE;
+        }
+        else if (in_value)
+        {
+            /* 6 digits exceed every field */
+            if ((c < '0') || (c > '9') || (++digits > 6))
+            {
+                return FALSE;
+            }
+            value = value * 10 + (c - '0');
+        }
+        else if (' ' != c)
+        {
+            if (key_len >= sizeof(key) - 1)
+            {
+                return FALSE;
+            }
+            key[key_len++] = c;
+        }
     }
+
+    return mode_valid(config);
+}
+
+/**
+ * @brief report update command status, "status,offset"
+ * @param status - command status
+ * @param offset - stream offset expected next
+ */
+static void ota_report(uint8_t status, uint32_t offset)
+{
+    char content[16];
+    sprintf(content, "%d,%lu", status, (unsigned long)offset);
+    mqtt_publish(topic_otastate, content, 0, 0, 0);
+}
+
+/**
+ * @brief find held order
+ * @param id - mqtt packet id
+ * @return order index, -1 if not found
+ */
+static int order_find(uint16_t id)
+{
+    for (int i = 0; i < g_order_count; ++i)
+    {
+        if (g_orders[i].id == id)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief hold received order until it is released by pubrel
+ * @param order - received order
+ */
+static void order_hold(const held_order *order)
+{
+    int index = order_find(order->id);
+
+    if (index < 0)
+    {
+        if (g_order_count >= ORDER_HELD_MAX)
+        {
+            TRACE("order of packet %d rejected\r\n", order->id);
+            for (int i = 0; i < order->count; ++i)
+            {
+                wifi_update_vend_result(order->slots[i], 0, 
+                                        MOTOR_VEND_REJECTED);
+            }
+            return ;
+        }
+        index = g_order_count++;
+    }
+
+    /* publish sent again replaces held order of same packet */
+    g_orders[index] = *order;
 }
 
 /**
  * @brief publish callback
  */
-static void mqtt_publish_cb(const char *topic, uint8_t *data, uint32_t len)
+static void mqtt_publish_cb(const char *topic, uint8_t *data, uint32_t len,
+                            uint16_t id)
 {
+    uint32_t offset = 0;
+    held_order order;
+    mode_config config;
+    bool restart = FALSE;
     assert_param(len >= 1);
-    g_motor_num = *data - '0';
+    if (0 == strcmp(topic, topic_config))
+    {
+        /* saved mode is changed by motor state task */
+        taskENTER_CRITICAL();
+        mode_get(&config);
+        taskEXIT_CRITICAL();
+        if (!mode_parse(data, len, &config, &restart))
+        {
+            TRACE("invalid mode rejected\r\n");
+            return ;
+        }
+
+        taskENTER_CRITICAL();
+        g_mode_request = config;
+        g_restart_request = restart;
+        mode_requested = TRUE;
+        taskEXIT_CRITICAL();
+        xTaskNotifyGive(xMotorStateTask);
+        return ;
+    }
+
+    if (0 == strcmp(topic, topic_ota))
+    {
+        ota_report(ota_process(data, len, &offset), offset);
+        return ;
+    }
+
+    order.id = id;
+    order.count = 0;
+#if (MOTOR_NUM > 10)
+    /* comma separated decimal slot numbers */
+    uint16_t num = 0;
+    bool digit = FALSE;
+    for (int i = 0; (i <= len) && (order.count < MOTOR_ORDER_MAX); ++i)
+    {
+        if ((i < len) && (data[i] >= '0') && (data[i] <= '9'))
+        {
+            num = num * 10 + (data[i] - '0');
+            digit = TRUE;
+        }
+        else if (digit)
+        {
+            if (num < MOTOR_NUM)
+            {
+                order.slots[order.count++] = num;
+            }
+            num = 0;
+            digit = FALSE;
+        }
+    }
+#else
+    /* one digit for every slot */
+    for (int i = 0; (i < len) && (order.count < MOTOR_ORDER_MAX); ++i)
+    {
+        if ((data[i] >= '0') && (data[i] <= '9'))
+        {
+            order.slots[order.count++] = data[i] - '0';
+        }
+    }
+#endif
+
+    if (order.count > 0)
+    {
+        order_hold(&order);
+    }
 }
 
 /**
@@ -315,8 +704,19 @@ static void mqtt_puback_cb(uint16_t id)
  */
 static void mqtt_pubrel_cb(uint16_t id)
 {
-    assert_param(g_motor_num < 10);
-    motor_start(g_motor_num);
+    held_order order;
+    int index = order_find(id);
+
+    /* pubrel is sent again if pubcomp is lost, order is released once */
+    if (index < 0)
+    {
+        return ;
+    }
+
+    order = g_orders[index];
+    g_orders[index] = g_orders[--g_order_count];
+    /* rejected order is reported by motor control */
+    motor_start_order(order.slots, order.count);
 }
 
 /**
@@ -330,6 +730,8 @@ static void mqtt_suback_cb(uint8_t status, uint16_t id)
         {
             /* try to subscribe again */
             mqtt_subscribe(topic_control, 2);
+            mqtt_subscribe(topic_config, 1);
+            mqtt_subscribe(topic_ota, 0);
         }
     }
 }
@@ -402,7 +804,7 @@ static void init_param(void)
 {
     mqtt_status = 0x00;
     ap_connected = FALSE;
-    g_motor_num = 0;
+    g_order_count = 0;
 }
 
 /**
@@ -410,13 +812,13 @@ static void init_param(void)
  */
 void wifi_update_motor_status(void)
 {
-    uint16_t status = 0;
-    uint8_t status_str[11];
-    status_str[10] = 0x00;
-    status = motor_getstatus();
-    for (int i = 0; i < 10; ++i)
+    uint32_t status[SLOT_WORDS];
+    uint8_t status_str[MOTOR_NUM + 1];
+    status_str[MOTOR_NUM] = 0x00;
+    motor_getstatus(status);
+    for (int i = 0; i < MOTOR_NUM; ++i)
     {
-        if (status & 0x01)
+        if (slot_test(status, i))
         {
             status_str[i] = '1';
         }
@@ -424,11 +826,158 @@ void wifi_update_motor_status(void)
         {
             status_str[i] = '0';
         }
-        status >>= 1;
     }
     mqtt_publish(topic_state, (const char *)status_str, 0, 0, 0);
 }
 
+/**
+ * @brief update vend result
+ * @param num - motor number
+ * @param time - vend run time(ms)
+ * @param result - vend result
+ * @return TRUE if result is published
+ */
+bool wifi_update_vend_result(uint8_t num, uint16_t time, uint8_t result)
+{
+    char content[16];
+    if (0x03 != mqtt_status)
+    {
+        return FALSE;
+    }
+    sprintf(content, "%d,%d,%d", num, time, result);
+    mqtt_publish(topic_vend, content, 0, 0, 0);
+    return TRUE;
+}
+
+/**
+ * @brief update vend order result
+ * @param time - order complete time(ms)
+ */
+void wifi_update_order_result(uint32_t time)
+{
+    char result[20];
+    if (0x03 != mqtt_status)
+    {
+        return ;
+    }
+    sprintf(result, "order,%d", (int)time);
+    mqtt_publish(topic_vend, result, 0, 0, 0);
+}
+
+/**
+ * @brief update motor health statistics of used slots
+ */
+void wifi_update_health(void)
+{
+    char content[REPORT_LEN];
+    uint8_t slot = 0;
+    if (0x03 != mqtt_status)
+    {
+        return ;
+    }
+    
+    while (health_format(&slot, content, REPORT_LEN) > 0)
+    {
+        mqtt_publish(topic_health, content, 0, 0, 0);
+    }
+}
+
+/**
+ * @brief update customer occupancy statistics since last report
+ */
+void wifi_update_occupancy(void)
+{
+    char content[REPORT_LEN];
+    ir_stat stat;
+    if (0x03 != mqtt_status)
+    {
+        return ;
+    }
+
+    ir_take_stat(&stat);
+    sprintf(content, "%d,%d,%d,%d,%d", stat.approaches, stat.rate, 
+            stat.avg_dwell, stat.max_dwell, stat.occupied);
+    mqtt_publish(topic_occupancy, content, 0, 0, 0);
+}
+
+/**
+ * @brief update idle time and estimated current since last report
+ */
+void wifi_update_power(void)
+{
+    char content[REPORT_LEN];
+    power_stat stat;
+    if (0x03 != mqtt_status)
+    {
+        return ;
+    }
+
+    power_take_stat(&stat);
+    sprintf(content, "%d,%d", stat.idle, stat.current);
+    mqtt_publish(topic_power, content, 0, 0, 0);
+}
+
+/**
+ * @brief update configure flash wear and flash timing(us),
+ *        "erases,commits,changes,used,size,erase_last,erase_max,page_last,
+ *        page_max"
+ */
+void wifi_update_flash(void)
+{
+    char content[REPORT_LEN];
+    flash_stat stat;
+    flash_page_stat page;
+    if (0x03 != mqtt_status)
+    {
+        return ;
+    }
+
+    flash_get_stat(&stat);
+    flash_page_get_stat(&page);
+    sprintf(content, "%lu,%d,%d,%d,%d,%d,%d,%d,%d", 
+            (unsigned long)stat.erases, stat.commits, stat.changes, 
+            stat.used, stat.size, page.erase_last, page.erase_max,
+            page.page_last, page.page_max);
+    mqtt_publish(topic_flash, content, 0, 0, 0);
+}
+
+/**
+ * @brief update self test report
+ */
+void wifi_update_selftest(void)
+{
+    char content[REPORT_LEN];
+    uint8_t index = 0;
+    if (0x03 != mqtt_status)
+    {
+        return ;
+    }
+    
+    while (selftest_format(&index, content, REPORT_LEN) > 0)
+    {
+        mqtt_publish(topic_test, content, 0, 0, 0);
+    }
+}
+
+/**
+ * @brief update saved mode, pending is 1 if network or work mode is applied
+ *        at next start
+ */
+void wifi_update_mode(void)
+{
+    char content[REPORT_LEN];
+    mode_config config;
+    if (0x03 != mqtt_status)
+    {
+        return ;
+    }
+
+    mode_get(&config);
+    sprintf(content, "%d,%d,%d,%d,%d,%d", config.net, config.work, 
+            config.led, config.ir_hold, config.keepalive, mode_pending());
+    mqtt_publish(topic_mode, content, 0, 0, 0);
+}
+
 /**
  * @brief init wifi
  * @return init status
@@ -465,9 +1014,22 @@ bool wifi_init(void)
     {
         return FALSE;
     }
+    slot_sensor_attach(slot_status_changed);
+    modeswitch_attach(MODE_GESTURE_SHORT, status_report_requested);
     convert_chipid();
     sprintf(topic_control, "%s/%s", "controller", g_id);
     sprintf(topic_state, "%s/%s", "state", g_id);
+    sprintf(topic_vend, "%s/%s", "vend", g_id);
+    sprintf(topic_health, "%s/%s", "health", g_id);
+    sprintf(topic_occupancy, "%s/%s", "occupancy", g_id);
+    sprintf(topic_power, "%s/%s", "power", g_id);
+    sprintf(topic_flash, "%s/%s", "flash", g_id);
+    sprintf(topic_test, "%s/%s", "test", g_id);
+    sprintf(topic_config, "%s/%s", "config", g_id);
+    sprintf(topic_mode, "%s/%s", "mode", g_id);
+    sprintf(topic_ota, "%s/%s", "ota", g_id);
+    sprintf(topic_otastate, "%s/%s", "otastate", g_id);
+    ota_init();
 
 
     if (MODE_NET_WIFI == mode_net())
@@ -14,6 +14,14 @@ BEGIN_DECLS
 
 bool wifi_init(void);
 void wifi_update_motor_status(void);
+bool wifi_update_vend_result(uint8_t num, uint16_t time, uint8_t result);
+void wifi_update_order_result(uint32_t time);
+void wifi_update_health(void);
+void wifi_update_occupancy(void);
+void wifi_update_power(void);
+void wifi_update_flash(void);
+void wifi_update_selftest(void);
+void wifi_update_mode(void);
 
 END_DECLS
 
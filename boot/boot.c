@@ -0,0 +1,210 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "types.h"
+#include "cm3_core.h"
+#include "stm32f10x_cfg.h"
+#include "ota_layout.h"
+
+/* bootloader runs from reset on hsi, it patches new image into application
+   in place or resumes patching, reverts trial image that failed to confirm,
+   then jumps to application. every patch step is recorded, power loss at
+   any point resumes from the last recorded step */
+
+typedef void (*intfunc)(void);
+typedef union { intfunc __fun; void * __ptr; } intvec_elem;
+
+#pragma language=extended
+#pragma segment="CSTACK"
+
+void __iar_program_start(void);
+
+/**
+ * @brief fault handler, nothing to do but wait
+ */
+static void boot_fault(void)
+{
+    for (;;);
+}
+
+#pragma location = ".intvec"
+const intvec_elem __vector_table[] =
+{
+    { .__ptr = __sfe( "CSTACK" ) },
+    &__iar_program_start,
+    boot_fault,
+    boot_fault,
+    boot_fault,
+    boot_fault,
+    boot_fault,
+};
+
+/* page under construction */
+static uint8_t boot_page[OTA_PAGE_SIZE];
+
+/**
+ * @brief replace page with page
+ * @param dst - destination page
+ * @param src - source page
+ */
+static void boot_copy(uint32_t dst, uint32_t src)
+{
+    FLASH_ErasePage(dst);
+    FLASH_Write(dst, (uint8_t *)src, OTA_PAGE_SIZE);
+}
+
+/**
+ * @brief build page of patch record, base bytes are read from application
+ * @param record - patch record
+ */
+static void boot_build(const uint8_t *record)
+{
+    const uint8_t *data = record + OTA_RECORD_HEAD;
+    const uint8_t *base = NULL;
+    ota_op op;
+
+    for (uint16_t pos = 0; pos < OTA_PAGE_SIZE; pos += op.len)
+    {
+        data = ota_op_parse(data, &op);
+        base = (const uint8_t *)(OTA_APP_ADDR + op.src);
+        for (uint16_t i = 0; i < op.len; ++i)
+        {
+            boot_page[pos + i] = ota_op_byte(&op, i, base[i]);
+        }
+    }
+}
+
+/**
+ * @brief apply patch part to application page by page. page is saved to
+ *        scratch before application page is erased, the record can not be
+ *        built again once a page it reads is erased. patch is verified by
+ *        application before it is pending
+ * @param state - update state
+ * @param part - 0: forward part, 1: reverse part
+ */
+static void boot_patch(ota_state *state, uint8_t part)
+{
+    const uint8_t *record = (const uint8_t *)(OTA_APP_ADDR +
+                                              state->stage * OTA_PAGE_SIZE);
+    uint16_t step = 0;
+
+    for (; part > 0; --part)
+    {
+        while (OTA_PAGE_END != record[0])
+        {
+            record += OTA_RECORD_HEAD + ota_u16(record + 1);
+        }
+        record ++;
+    }
+
+    for (uint8_t index = 0; OTA_PAGE_END != record[0]; ++index)
+    {
+        step = index * OTA_STEP_COUNT;
+        if (state->steps <= step)
+        {
+            boot_build(record);
+            FLASH_ErasePage(OTA_SCRATCH_ADDR);
+            FLASH_Write(OTA_SCRATCH_ADDR, boot_page, OTA_PAGE_SIZE);
+            ota_append(state, OTA_TAG_STEP, index, 0);
+        }
+
+        if (state->steps <= step + 1)
+        {
+            boot_copy(OTA_APP_ADDR + record[0] * OTA_PAGE_SIZE,
+                      OTA_SCRATCH_ADDR);
+            ota_append(state, OTA_TAG_STEP, index, 1);
+        }
+        record += OTA_RECORD_HEAD + ota_u16(record + 1);
+    }
+}
+
+/**
+ * @brief check crc of image in application slot
+ * @param state - update state
+ * @return TRUE if image is intact
+ */
+static bool boot_verify(const ota_state *state)
+{
+    CRC_ResetDR();
+    return (state->crc == CRC_CalBlock((uint32_t *)OTA_APP_ADDR,
+                                       state->words));
+}
+
+/**
+ * @brief start application, stack pointer and vector table come from
+ *        application vector table
+ */
+static void boot_jump(void)
+{
+    const uint32_t *vector = (const uint32_t *)OTA_APP_ADDR;
+    VectTable table = {OTA_APP_ADDR >> 9, CODE};
+
+    /* erased or broken application, nothing to start */
+    if ((vector[0] <= OTA_RAM_ADDR) ||
+        (vector[0] > OTA_RAM_ADDR + OTA_RAM_SIZE) ||
+        (vector[1] < OTA_APP_ADDR) ||
+        (vector[1] >= OTA_APP_ADDR + OTA_APP_SIZE))
+    {
+        boot_fault();
+    }
+
+    SCB_SetVectTableConfig(table);
+    __set_MSP(vector[0]);
+    ((intfunc)vector[1])();
+}
+
+/**
+ * @brief bootloader entry
+ */
+int main(void)
+{
+    ota_state state;
+
+    RCC_AHBPeripClockEnable(RCC_AHB_ENABLE_CRC, TRUE);
+    ota_scan(&state);
+
+    switch (state.phase)
+    {
+    case OTA_PHASE_PENDING:
+        boot_patch(&state, 0);
+        if (boot_verify(&state))
+        {
+            ota_append(&state, OTA_TAG_TRIAL, 0, 0);
+        }
+        else
+        {
+            /* patched image is broken, reverse part restores old image */
+            ota_append(&state, OTA_TAG_REVERT, 0, 0);
+            state.steps = 0;
+            boot_patch(&state, 1);
+            ota_append(&state, OTA_TAG_REVERTED, 0, 0);
+            break;
+        }
+        /* first trial boot */
+        ota_append(&state, OTA_TAG_BOOT, 0, 0);
+        break;
+    case OTA_PHASE_TRIAL:
+        if (state.boots < OTA_TRIAL_BOOTS)
+        {
+            ota_append(&state, OTA_TAG_BOOT, 0, 0);
+            break;
+        }
+        /* new image never confirmed, patch back */
+        ota_append(&state, OTA_TAG_REVERT, 0, 0);
+        state.steps = 0;
+        /* fall through */
+    case OTA_PHASE_REVERT:
+        boot_patch(&state, 1);
+        ota_append(&state, OTA_TAG_REVERTED, 0, 0);
+        break;
+    default:
+        break;
+    }
+
+    boot_jump();
+    return 0;
+}
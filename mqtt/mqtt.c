@@ -18,6 +18,7 @@
 #include "global.h"
 #include "assert.h"
 #include "mode.h"
+#include "watchdog.h"
 
 
 #undef __TRACE_MODULE
@@ -33,6 +34,10 @@ static SemaphoreHandle_t xSendMutex = NULL;
 #define MQTT_MAX_MSG_NUM     (6)
 #define MQTT_MAX_MSG_SIZE    (128)
 
+/* max time between check ins, sending waits for modem response */
+#define MQTT_SEND_DEADLINE   (15000 / portTICK_PERIOD_MS)
+#define MQTT_RECV_DEADLINE   (10000 / portTICK_PERIOD_MS)
+
 typedef struct
 {
     uint8_t size;
@@ -83,11 +88,13 @@ static void mqtt_connack_cb(uint8_t status)
  * @brief connack default process function
  */
 
-static void mqtt_publish_cb(const char *topic, uint8_t *content, uint32_t len)
+static void mqtt_publish_cb(const char *topic, uint8_t *content, uint32_t len,
+                            uint16_t id)
 {
     UNUSED(topic);
     UNUSED(content);
     UNUSED(len);
+    UNUSED(id);
 }
 
 /**
@@ -285,7 +292,9 @@ void process_publish(const uint8_t *data, uint8_t len)
             len -= 2;
         }
 
-        g_driver.publish(topic, (uint8_t *)pdata, len - step - topic_len - 3);
+        /* id is 0 for qos 0 message */
+        g_driver.publish(topic, (uint8_t *)pdata, len - step - topic_len - 3,
+                         id);
         switch(qos)
         {
         case 1:
@@ -347,8 +356,10 @@ void process_pubrel(const uint8_t *data, uint8_t len)
         uint16_t uuid = data[2];
         uuid <<= 8;
         uuid += data[3];
-        mqtt_pubcomp(uuid);
+        /* message must be handled before it is completed, server does not 
+           send it again after pubcomp */
         g_driver.pubrel(uuid);
+        mqtt_pubcomp(uuid);
     }
 }
 
@@ -451,9 +462,11 @@ static __INLINE void mqtt_send_data(const mqtt_msg *msg)
 void vMqttSend(void *pvParameters)
 {
     mqtt_msg msg;
+    uint8_t wdg = watchdog_register("MqttSend", MQTT_SEND_DEADLINE);
     for (;;)
     {
-        if (xQueueReceive(xSendQueue, &msg, portMAX_DELAY))
+        watchdog_checkin(wdg);
+        if (xQueueReceive(xSendQueue, &msg, WATCHDOG_CHECKIN_TIME))
         {
             if (MODE_NET_WIFI == mode_net())
             {
@@ -485,12 +498,18 @@ void vMqttRecv(void *pvParameters)
     uint16_t len;
     int count = sizeof(funcs) / sizeof(funcs[0]);
     uint8_t id = 0;
+    uint8_t wdg = watchdog_register("MqttRecv", MQTT_RECV_DEADLINE);
+    bool received = FALSE;
     for (;;)
     {
+        watchdog_checkin(wdg);
+        received = FALSE;
         if (MODE_NET_WIFI == mode_net())
         {
-            if (ESP_ERR_OK == esp8266_recv(&id, data, &len, portMAX_DELAY))
+            if (ESP_ERR_OK == esp8266_recv(&id, data, &len, 
+                                           WATCHDOG_CHECKIN_TIME))
             {
+                received = TRUE;
                 for (int i = 0; i < count; ++i)
                 {
                     if (funcs[i].type == (data[0] & 0xf0))
@@ -508,8 +527,9 @@ void vMqttRecv(void *pvParameters)
         }
         else
         {
-            if (M26_ERR_OK == m26_recv(data, &len, portMAX_DELAY))
+            if (M26_ERR_OK == m26_recv(data, &len, WATCHDOG_CHECKIN_TIME))
             {
+                received = TRUE;
                 for (int i = 0; i < count; ++i)
                 {
                     if (funcs[i].type == data[0])
@@ -520,8 +540,12 @@ void vMqttRecv(void *pvParameters)
                 }
             }
         }
-         
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+        /* messages of update stream come back to back */
+        if (!received)
+        {
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+        }
     }
 }
 
@@ -543,7 +567,7 @@ bool mqtt_init(void)
         return FALSE;
     }
     
-    xTaskCreate(vMqttRecv, "MqttRecv", MQTT_STACK_SIZE, 
+    xTaskCreate(vMqttRecv, "MqttRecv", MQTT_RECV_STACK_SIZE, 
             NULL, MQTT_PRIORITY, &xMqttHandle);
     xTaskCreate(vMqttSend, "MqttSend", MQTT_STACK_SIZE, 
             NULL, MQTT_PRIORITY, &xMqttHandle);
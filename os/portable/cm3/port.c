@@ -29,6 +29,14 @@
 /* irq start number */
 #define portIRQ_START_NUMBER        		(16)
 
+/* systick is clocked by AHB/8 */
+#define portSYSTICK_CLOCK_HZ                (configSYSTICK_CLOCK_HZ)
+#define portSYSTICK_COUNTS_PER_TICK         (portSYSTICK_CLOCK_HZ / configTICK_RATE_HZ)
+#define portMAX_24_BIT_NUMBER				(0xffffffUL)
+
+/* systick clocks lost while counter is stopped to adjust reload value */
+#define portMISSED_COUNTS_FACTOR			(45UL / 8UL + 1UL)
+
 /* xPSR reset value */
 #define portINITIAL_XPSR					(0x01000000)
 
@@ -42,6 +50,12 @@ variable. */
 static UBaseType_t uxCriticalNesting = 0xaaaaaaaa;
 
 
+#if configUSE_TICKLESS_IDLE == 1
+/* most ticks can be suppressed by one systick period */
+static const uint32_t xMaximumPossibleSuppressedTicks = 
+                      portMAX_24_BIT_NUMBER / portSYSTICK_COUNTS_PER_TICK;
+#endif
+
 /* interface */
 void vPortSetupTimerInterrupt( void );
 void SysTickHandler( void );
@@ -172,13 +186,128 @@ void vPortSetupTimerInterrupt( void )
 {
 	/* Configure SysTick to interrupt at the requested rate. */
     SYSTICK_SetClockSource(SYSTICK_CLOCK_AHB_DIV_EIGHT);
-    SYSTICK_SetTickInterval(1000 / configTICK_RATE_HZ);
+    SYSTICK_SetReload(portSYSTICK_COUNTS_PER_TICK - 1UL);
     SYSTICK_EnableInt(TRUE);
     SYSTICK_ClrCountFlag();
     SYSTICK_EnableCounter(TRUE);
 }
 /*-----------------------------------------------------------*/
 
+#if configUSE_TICKLESS_IDLE == 1
+/**
+ * @brief stop tick interrupt and sleep until next task unblocks or an
+ *        interrupt happens, tick count is corrected after wake up
+ * @param xExpectedIdleTime - ticks until next task unblocks
+ */
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+	uint32_t ulReloadValue, ulCompleteTickPeriods, ulCompletedSysTickDecrements;
+	TickType_t xModifiableIdleTime;
+	bool xTickHappened;
+
+	if( xExpectedIdleTime > xMaximumPossibleSuppressedTicks )
+	{
+		xExpectedIdleTime = xMaximumPossibleSuppressedTicks;
+	}
+
+	/* stop the systick momentarily, counter keeps its value */
+	SYSTICK_EnableCounter(FALSE);
+
+	/* current tick period is partly passed */
+	ulReloadValue = SYSTICK_GetCounter() + 
+	                ( portSYSTICK_COUNTS_PER_TICK * ( xExpectedIdleTime - 1UL ) );
+	if( ulReloadValue > portMISSED_COUNTS_FACTOR )
+	{
+		ulReloadValue -= portMISSED_COUNTS_FACTOR;
+	}
+
+	/* mask all interrupts, pending ones still wake up wfi */
+	__set_PRIMASK();
+	__DSB();
+	__ISB();
+
+	if( eTaskConfirmSleepModeStatus() == eAbortSleep )
+	{
+		/* restart from current count, next period is a whole tick */
+		SYSTICK_SetReload(SYSTICK_GetCounter());
+		SYSTICK_ClrCounter();
+		SYSTICK_EnableCounter(TRUE);
+		SYSTICK_SetReload(portSYSTICK_COUNTS_PER_TICK - 1UL);
+		__reset_PRIMASK();
+	}
+	else
+	{
+		SYSTICK_SetReload(ulReloadValue);
+		SYSTICK_ClrCounter();
+		SYSTICK_EnableCounter(TRUE);
+
+		/* sleep can be skipped by setting idle time to zero */
+		xModifiableIdleTime = xExpectedIdleTime;
+		configPRE_SLEEP_PROCESSING( xModifiableIdleTime );
+		if( xModifiableIdleTime > 0 )
+		{
+			__DSB();
+			__WFI();
+			__ISB();
+		}
+		configPOST_SLEEP_PROCESSING( xExpectedIdleTime );
+
+		/* let the interrupt that woke up the cpu run */
+		__reset_PRIMASK();
+		__DSB();
+		__ISB();
+		__set_PRIMASK();
+		__DSB();
+		__ISB();
+
+		xTickHappened = SYSTICK_StopCounter();
+		if( xTickHappened )
+		{
+			/* tick interrupt already ran and reloaded the counter, finish 
+			this tick period from the remaining count */
+			uint32_t ulCalculatedLoadValue;
+
+			ulCalculatedLoadValue = ( portSYSTICK_COUNTS_PER_TICK - 1UL ) - 
+			                        ( ulReloadValue - SYSTICK_GetCounter() );
+			if( ( ulCalculatedLoadValue < portMISSED_COUNTS_FACTOR ) || 
+			    ( ulCalculatedLoadValue > portSYSTICK_COUNTS_PER_TICK ) )
+			{
+				ulCalculatedLoadValue = ( portSYSTICK_COUNTS_PER_TICK - 1UL );
+			}
+			SYSTICK_SetReload(ulCalculatedLoadValue);
+
+			/* the tick interrupt handler stepped the last tick */
+			ulCompleteTickPeriods = xExpectedIdleTime - 1UL;
+		}
+		else
+		{
+			/* woken by another interrupt, count whole ticks passed */
+			ulCompletedSysTickDecrements = 
+			    ( xExpectedIdleTime * portSYSTICK_COUNTS_PER_TICK ) - 
+			    SYSTICK_GetCounter();
+			ulCompleteTickPeriods = ulCompletedSysTickDecrements / 
+			                        portSYSTICK_COUNTS_PER_TICK;
+			SYSTICK_SetReload(( ( ulCompleteTickPeriods + 1UL ) * 
+			                    portSYSTICK_COUNTS_PER_TICK ) - 
+			                  ulCompletedSysTickDecrements);
+		}
+
+		/* restart systick, reload value of one tick takes effect after
+		the partial period */
+		SYSTICK_ClrCounter();
+		portENTER_CRITICAL();
+		{
+			SYSTICK_EnableCounter(TRUE);
+			vTaskStepTick( ulCompleteTickPeriods );
+			SYSTICK_SetReload(portSYSTICK_COUNTS_PER_TICK - 1UL);
+		}
+		portEXIT_CRITICAL();
+		__reset_PRIMASK();
+	}
+}
+/*-----------------------------------------------------------*/
+#endif /* configUSE_TICKLESS_IDLE */
+
 #if (configASSERT_DEFINED == 1)
 /**
  * @brief validate current running exception priority  
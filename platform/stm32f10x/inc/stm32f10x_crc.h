@@ -15,6 +15,7 @@ void CRC_ResetDR(void);
 uint32_t CRC_Cal(uint32_t data);
 uint32_t CRC_CalBlock(uint32_t *buf, uint32_t len);
 uint32_t CRC_GetDR(void);
+uint32_t CRC_DataAddress(void);
 void CRC_SetIDR(uint8_t data);
 uint8_t CRC_GetIDR(void);
 
@@ -0,0 +1,90 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _STM32F10X_DMA_H_
+  #define _STM32F10X_DMA_H_
+
+#include "types.h"
+
+/* dma channel definition */
+typedef enum
+{
+    DMA1_Channel1,
+    DMA1_Channel2,
+    DMA1_Channel3,
+    DMA1_Channel4,
+    DMA1_Channel5,
+    DMA1_Channel6,
+    DMA1_Channel7,
+    DMA_Channel_Count,
+}DMA_Channel;
+
+/* transfer direction */
+#define DMA_DIR_PERIPH_SRC        (0x00)
+#define DMA_DIR_MEMORY_SRC        (1 << 4)
+#define IS_DMA_DIR_PARAM(DIR)     ((DIR == DMA_DIR_PERIPH_SRC) || \
+                                   (DIR == DMA_DIR_MEMORY_SRC))
+
+/* data size */
+#define DMA_SIZE_8BITS            (0x00)
+#define DMA_SIZE_16BITS           (0x01)
+#define DMA_SIZE_32BITS           (0x02)
+#define IS_DMA_SIZE_PARAM(SIZE)   (SIZE <= DMA_SIZE_32BITS)
+
+/* channel priority */
+#define DMA_PRIORITY_LOW          (0x00 << 12)
+#define DMA_PRIORITY_MEDIUM       (0x01 << 12)
+#define DMA_PRIORITY_HIGH         (0x02 << 12)
+#define DMA_PRIORITY_VERY_HIGH    (0x03 << 12)
+#define IS_DMA_PRIORITY_PARAM(PRIORITY) ((PRIORITY & ~(0x03 << 12)) == 0)
+
+/* interrupt */
+#define DMA_IT_TC         (1 << 1)
+#define DMA_IT_HT         (1 << 2)
+#define DMA_IT_TE         (1 << 3)
+#define IS_DMA_IT_PARAM(IT) ((IT == DMA_IT_TC) || \
+                             (IT == DMA_IT_HT) || \
+                             (IT == DMA_IT_TE))
+
+/* flag, relative to channel */
+#define DMA_FLAG_GL       (1 << 0)
+#define DMA_FLAG_TC       (1 << 1)
+#define DMA_FLAG_HT       (1 << 2)
+#define DMA_FLAG_TE       (1 << 3)
+#define IS_DMA_FLAG_PARAM(FLAG) ((FLAG == DMA_FLAG_GL) || \
+                                 (FLAG == DMA_FLAG_TC) || \
+                                 (FLAG == DMA_FLAG_HT) || \
+                                 (FLAG == DMA_FLAG_TE))
+
+/* dma config structure */
+typedef struct
+{
+    uint32_t direction;
+    bool periphInc;
+    bool memoryInc;
+    uint32_t periphSize;
+    uint32_t memorySize;
+    uint32_t priority;
+    bool circular;
+    bool mem2mem;
+}DMA_Config;
+
+
+/* interface */
+void DMA_Setup(DMA_Channel channel, const DMA_Config *config);
+void DMA_StructInit(DMA_Config *config);
+void DMA_Enable(DMA_Channel channel, bool flag);
+void DMA_SetAddress(DMA_Channel channel, uint32_t periph, uint32_t memory);
+void DMA_SetCount(DMA_Channel channel, uint16_t count);
+uint16_t DMA_GetCount(DMA_Channel channel);
+void DMA_EnableInt(DMA_Channel channel, uint8_t intFlag, bool flag);
+bool DMA_IsFlagOn(DMA_Channel channel, uint8_t flag);
+void DMA_ClrFlag(DMA_Channel channel, uint8_t flag);
+
+
+#endif /* _STM32F10X_DMA_H_ */
+
@@ -31,6 +31,14 @@
                                     (param == FLAH_FLAG_WRPRTERR) || \
                                     (param == FLAH_FLAG_EOP))
 
+/* flash interrupts */
+#define FLASH_IT_ERR          (1 << 10)
+#define FLASH_IT_EOP          (1 << 12)
+
+#define IS_FLASH_IT_PARAM(param) ((0 != (param)) && \
+                                  (0 == ((param) & ~(FLASH_IT_ERR | \
+                                                     FLASH_IT_EOP))))
+
 
 
 
@@ -42,7 +50,11 @@ bool FLASH_IsHalfCycleAccessEnabled(void);
 void FLASH_SetLatency(uint8_t latency);
 bool FLASH_Is_FlagSet(uint8_t flag);
 void FLASH_ClrFlag(uint8_t flag);
+void FLASH_EnableInt(uint32_t it, bool flag);
+void FLASH_StartErasePage(uint32_t addr);
+bool FLASH_FinishErase(void);
 void FLASH_ErasePage(uint32_t addr);
+bool FLASH_Program(uint32_t addr, const uint8_t *data, uint32_t len);
 uint32_t FLASH_Write(uint32_t addr, uint8_t *data, uint32_t len);
 uint32_t FLASH_Read(uint32_t addr, uint8_t *data, uint32_t len);
 
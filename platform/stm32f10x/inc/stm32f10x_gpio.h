@@ -9,6 +9,7 @@
   #define _STM32F10X_GPIO_H_
 
 #include "types.h"
+#include "stm32f10x_map.h"
 
 /* gpio group definition */
 typedef enum
@@ -54,6 +55,15 @@ typedef struct
 
 #define SWJ_JTAG_DISABLE     (2 << 24)
 
+/* pin data registers, ports are 1KB apart, used by inline pin access with
+   constant group */
+#define GPIO_REG(group, offset)  (*(volatile uint32_t *)(GPIOA_BASE + \
+                                  ((uint32_t)(group) << 10) + (offset)))
+#define GPIO_IDR(group)          GPIO_REG(group, 0x08)
+#define GPIO_ODR(group)          GPIO_REG(group, 0x0c)
+#define GPIO_BSRR(group)         GPIO_REG(group, 0x10)
+#define GPIO_BRR(group)          GPIO_REG(group, 0x14)
+
 /* interface */
 void GPIO_Setup(GPIO_Group group, const GPIO_Config *config);
 uint16_t GPIO_ReadDataGroup(GPIO_Group group);
@@ -61,6 +71,8 @@ void GPIO_WriteDataGroup(GPIO_Group group, uint16_t data);
 uint8_t GPIO_ReadPin(GPIO_Group group, uint8_t pin);
 void GPIO_SetPin(GPIO_Group group, uint8_t pin);
 void GPIO_ResetPin(GPIO_Group group, uint8_t pin);
+volatile uint32_t *GPIO_OutputBitBand(GPIO_Group group, uint8_t pin);
+volatile uint32_t *GPIO_InputBitBand(GPIO_Group group, uint8_t pin);
 void GPIO_LockPin(GPIO_Group group, uint8_t pin);
 void GPIO_EXTIConfig(GPIO_Group group, uint8_t pin);
 void GPIO_PinRemap(uint32_t pin, bool flag);
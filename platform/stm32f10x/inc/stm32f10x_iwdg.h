@@ -33,7 +33,7 @@ void IWDG_Startup(void);
 void IWDG_Feed(void);
 void IWDG_SetClockPrescaler(uint8_t div);
 uint8_t IWDG_GetClockPrescaler(void);
-void IWDG_SetReloadValue(uint8_t value);
+void IWDG_SetReloadValue(uint16_t value);
 uint16_t IWDG_GetReloadValue(void);
 
 
@@ -226,6 +226,15 @@
                                    (param == RTC_CLOCK_LSI) || \
                                    (param == RTC_CLOCK_HSE))
 
+/******************************************************/
+/* reset flags */
+#define RCC_RESET_PIN     (0x01)
+#define RCC_RESET_POR     (0x02)
+#define RCC_RESET_SFT     (0x04)
+#define RCC_RESET_IWDG    (0x08)
+#define RCC_RESET_WWDG    (0x10)
+#define RCC_RESET_LPWR    (0x20)
+
 
 
 
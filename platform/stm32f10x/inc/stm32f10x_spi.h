@@ -139,6 +139,7 @@ void SPI_SetCRCNext(SPI_Group group, bool flag);
 void SPI_EnableTxDMA(SPI_Group group, bool flag);
 void SPI_EnableRxDMA(SPI_Group group, bool flag);
 void SPI_WriteData(SPI_Group group, uint16_t data);
+uint32_t SPI_DataAddress(SPI_Group group);
 uint16_t SPI_ReadData(SPI_Group group);
 uint16_t SPI_WriteReadDataSync(SPI_Group group, uint16_t data);
 void SPI_WriteDataSync(SPI_Group group, uint16_t data);
@@ -0,0 +1,113 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#ifndef _STM32F10X_TIM_H_
+  #define _STM32F10X_TIM_H_
+
+#include "types.h"
+
+/* general purpose timer group definition */
+typedef enum
+{
+    TIM2,
+    TIM3,
+    TIM4,
+    TIM_Count,
+}TIM_Group;
+
+/* timer channel */
+#define TIM_CHANNEL1      (0)
+#define TIM_CHANNEL2      (1)
+#define TIM_CHANNEL3      (2)
+#define TIM_CHANNEL4      (3)
+#define IS_TIM_CHANNEL_PARAM(CHANNEL) (CHANNEL <= TIM_CHANNEL4)
+
+/* counter mode */
+#define TIM_COUNTER_UP            (0x00)
+#define TIM_COUNTER_DOWN          (1 << 4)
+#define IS_TIM_COUNTER_PARAM(MODE) ((MODE == TIM_COUNTER_UP) || \
+                                    (MODE == TIM_COUNTER_DOWN))
+
+/* output compare mode */
+#define TIM_OC_FROZEN             (0x00)
+#define TIM_OC_ACTIVE             (0x01)
+#define TIM_OC_INACTIVE           (0x02)
+#define TIM_OC_TOGGLE             (0x03)
+#define TIM_OC_FORCE_INACTIVE     (0x04)
+#define TIM_OC_FORCE_ACTIVE       (0x05)
+#define TIM_OC_PWM1               (0x06)
+#define TIM_OC_PWM2               (0x07)
+#define IS_TIM_OC_PARAM(MODE)     (MODE <= TIM_OC_PWM2)
+
+/* master mode, trigger output */
+#define TIM_TRGO_RESET            (0x00 << 4)
+#define TIM_TRGO_ENABLE           (0x01 << 4)
+#define TIM_TRGO_UPDATE           (0x02 << 4)
+#define TIM_TRGO_OC1              (0x03 << 4)
+#define TIM_TRGO_OC1REF           (0x04 << 4)
+#define TIM_TRGO_OC2REF           (0x05 << 4)
+#define TIM_TRGO_OC3REF           (0x06 << 4)
+#define TIM_TRGO_OC4REF           (0x07 << 4)
+#define IS_TIM_TRGO_PARAM(MODE)   ((MODE & ~(0x07 << 4)) == 0)
+
+/* interrupt */
+#define TIM_IT_UPDATE     (1 << 0)
+#define TIM_IT_CC1        (1 << 1)
+#define TIM_IT_CC2        (1 << 2)
+#define TIM_IT_CC3        (1 << 3)
+#define TIM_IT_CC4        (1 << 4)
+#define TIM_IT_TRIGGER    (1 << 6)
+#define IS_TIM_IT_PARAM(IT) ((IT == TIM_IT_UPDATE) || \
+                             (IT == TIM_IT_CC1) || \
+                             (IT == TIM_IT_CC2) || \
+                             (IT == TIM_IT_CC3) || \
+                             (IT == TIM_IT_CC4) || \
+                             (IT == TIM_IT_TRIGGER))
+
+/* flag */
+#define TIM_FLAG_UPDATE   (1 << 0)
+#define TIM_FLAG_CC1      (1 << 1)
+#define TIM_FLAG_CC2      (1 << 2)
+#define TIM_FLAG_CC3      (1 << 3)
+#define TIM_FLAG_CC4      (1 << 4)
+#define TIM_FLAG_TRIGGER  (1 << 6)
+#define IS_TIM_FLAG_PARAM(FLAG) ((FLAG == TIM_FLAG_UPDATE) || \
+                                 (FLAG == TIM_FLAG_CC1) || \
+                                 (FLAG == TIM_FLAG_CC2) || \
+                                 (FLAG == TIM_FLAG_CC3) || \
+                                 (FLAG == TIM_FLAG_CC4) || \
+                                 (FLAG == TIM_FLAG_TRIGGER))
+
+/* timer remap, use together with SWJ configuration because SWJ bits are 
+   write only */
+#define TIM3_PARTIAL_REMAP     (2 << 10)
+#define TIM3_FULL_REMAP        (3 << 10)
+#define TIM4_REMAP             (1 << 12)
+
+
+/* interface */
+void TIM_Enable(TIM_Group group, bool flag);
+void TIM_SetCounterMode(TIM_Group group, uint16_t mode);
+void TIM_SetPrescaler(TIM_Group group, uint16_t prescaler);
+void TIM_SetAutoReload(TIM_Group group, uint16_t value);
+void TIM_EnableAutoReloadPreload(TIM_Group group, bool flag);
+void TIM_SetCounter(TIM_Group group, uint16_t value);
+uint16_t TIM_GetCounter(TIM_Group group);
+void TIM_EnableOnePulse(TIM_Group group, bool flag);
+void TIM_EnableUpdateOnlyOverflow(TIM_Group group, bool flag);
+void TIM_GenerateUpdate(TIM_Group group);
+void TIM_SetMasterMode(TIM_Group group, uint16_t mode);
+void TIM_SetOutputCompareMode(TIM_Group group, uint8_t channel, 
+                              uint8_t mode, bool preload);
+void TIM_EnableChannel(TIM_Group group, uint8_t channel, bool flag);
+void TIM_SetCompare(TIM_Group group, uint8_t channel, uint16_t value);
+void TIM_EnableInt(TIM_Group group, uint16_t intFlag, bool flag);
+bool TIM_IsFlagOn(TIM_Group group, uint16_t flag);
+void TIM_ClrFlag(TIM_Group group, uint16_t flag);
+
+
+#endif /* _STM32F10X_TIM_H_ */
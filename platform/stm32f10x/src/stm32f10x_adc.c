@@ -296,9 +296,9 @@ void ADC_EnableInt(ADC_Group group, uint32_t intFlag, bool flag)
     ADC_T * const AdcX = ADCx[group];
     
     if(flag)
-        AdcX->CR1 &= ~intFlag;
-    else
         AdcX->CR1 |= intFlag;
+    else
+        AdcX->CR1 &= ~intFlag;
 }
 
 /**
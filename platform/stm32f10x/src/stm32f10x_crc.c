@@ -68,6 +68,16 @@ uint32_t CRC_CalBlock(uint32_t *buf, uint32_t len)
 }
 
 
+/**
+ * @brief get data register address for dma transfer
+ * @return data register address
+ */
+uint32_t CRC_DataAddress(void)
+{
+    return (uint32_t)&CRC->DR;
+}
+
+
 /**
  * @brief get previous crc value
  * @return previour crc value
@@ -0,0 +1,205 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "stm32f10x_dma.h"
+#include "stm32f10x_map.h"
+#include "stm32f10x_cfg.h"
+
+/* dma channel structure */
+typedef struct
+{
+    volatile uint32_t CCR;
+    volatile uint32_t CNDTR;
+    volatile uint32_t CPAR;
+    volatile uint32_t CMAR;
+    uint32_t RESERVED;
+}DMA_Channel_T;
+
+/* dma structure */
+typedef struct
+{
+    volatile uint32_t ISR;
+    volatile uint32_t IFCR;
+    DMA_Channel_T CHANNEL[7];
+}DMA_T;
+
+static DMA_T * const DMAx = (DMA_T *)DMA1_BASE;
+
+/* DMA register bit definition */
+#define CCR_EN              (1 << 0)
+#define CCR_TCIE            (1 << 1)
+#define CCR_HTIE            (1 << 2)
+#define CCR_TEIE            (1 << 3)
+#define CCR_DIR             (1 << 4)
+#define CCR_CIRC            (1 << 5)
+#define CCR_PINC            (1 << 6)
+#define CCR_MINC            (1 << 7)
+#define CCR_PSIZE           (0x03 << 8)
+#define CCR_MSIZE           (0x03 << 10)
+#define CCR_PL              (0x03 << 12)
+#define CCR_MEM2MEM         (1 << 14)
+
+/* interrupt flags of one channel */
+#define ISR_CHANNEL_MASK    (0x0f)
+#define ISR_CHANNEL_SHIFT(channel)  ((channel) << 2)
+
+/**
+ * @brief setup dma channel, channel must be disabled
+ * @param dma channel
+ * @param configure parameters
+ */
+void DMA_Setup(DMA_Channel channel, const DMA_Config *config)
+{
+    assert_param(channel < DMA_Channel_Count);
+    assert_param(IS_DMA_DIR_PARAM(config->direction));
+    assert_param(IS_DMA_SIZE_PARAM(config->periphSize));
+    assert_param(IS_DMA_SIZE_PARAM(config->memorySize));
+    assert_param(IS_DMA_PRIORITY_PARAM(config->priority));
+
+    DMA_Channel_T * const ChannelX = &DMAx->CHANNEL[channel];
+    uint32_t ccr = ChannelX->CCR;
+
+    ccr &= ~(CCR_DIR | CCR_CIRC | CCR_PINC | CCR_MINC | CCR_PSIZE |
+             CCR_MSIZE | CCR_PL | CCR_MEM2MEM);
+    ccr |= config->direction;
+    ccr |= (config->periphSize << 8);
+    ccr |= (config->memorySize << 10);
+    ccr |= config->priority;
+    if(config->periphInc)
+        ccr |= CCR_PINC;
+    if(config->memoryInc)
+        ccr |= CCR_MINC;
+    if(config->circular)
+        ccr |= CCR_CIRC;
+    if(config->mem2mem)
+        ccr |= CCR_MEM2MEM;
+
+    ChannelX->CCR = ccr;
+}
+
+/**
+ * @brief init dma config structure, memory to peripheral byte transfer
+ * @param dma config structure
+ */
+void DMA_StructInit(DMA_Config *config)
+{
+    assert_param(config != NULL);
+    config->direction = DMA_DIR_MEMORY_SRC;
+    config->periphInc = FALSE;
+    config->memoryInc = TRUE;
+    config->periphSize = DMA_SIZE_8BITS;
+    config->memorySize = DMA_SIZE_8BITS;
+    config->priority = DMA_PRIORITY_LOW;
+    config->circular = FALSE;
+    config->mem2mem = FALSE;
+}
+
+/**
+ * @brief enable or disable dma channel
+ * @param dma channel
+ * @param enable or disable flag
+ */
+void DMA_Enable(DMA_Channel channel, bool flag)
+{
+    assert_param(channel < DMA_Channel_Count);
+
+    DMA_Channel_T * const ChannelX = &DMAx->CHANNEL[channel];
+    if(flag)
+        ChannelX->CCR |= CCR_EN;
+    else
+        ChannelX->CCR &= ~CCR_EN;
+}
+
+/**
+ * @brief set transfer address, channel must be disabled
+ * @param dma channel
+ * @param peripheral address
+ * @param memory address
+ */
+void DMA_SetAddress(DMA_Channel channel, uint32_t periph, uint32_t memory)
+{
+    assert_param(channel < DMA_Channel_Count);
+
+    DMA_Channel_T * const ChannelX = &DMAx->CHANNEL[channel];
+    ChannelX->CPAR = periph;
+    ChannelX->CMAR = memory;
+}
+
+/**
+ * @brief set transfer count, channel must be disabled
+ * @param dma channel
+ * @param data count
+ */
+void DMA_SetCount(DMA_Channel channel, uint16_t count)
+{
+    assert_param(channel < DMA_Channel_Count);
+
+    DMA_Channel_T * const ChannelX = &DMAx->CHANNEL[channel];
+    ChannelX->CNDTR = count;
+}
+
+/**
+ * @brief get remaining transfer count
+ * @param dma channel
+ * @return data count not transferred
+ */
+uint16_t DMA_GetCount(DMA_Channel channel)
+{
+    assert_param(channel < DMA_Channel_Count);
+
+    DMA_Channel_T * const ChannelX = &DMAx->CHANNEL[channel];
+    return (uint16_t)ChannelX->CNDTR;
+}
+
+/**
+ * @brief enable or disable dma channel interrupt
+ * @param dma channel
+ * @param interrupt name
+ * @param enable or disable flag
+ */
+void DMA_EnableInt(DMA_Channel channel, uint8_t intFlag, bool flag)
+{
+    assert_param(channel < DMA_Channel_Count);
+    assert_param(IS_DMA_IT_PARAM(intFlag));
+
+    DMA_Channel_T * const ChannelX = &DMAx->CHANNEL[channel];
+    if(flag)
+        ChannelX->CCR |= intFlag;
+    else
+        ChannelX->CCR &= ~intFlag;
+}
+
+/**
+ * @brief check if specified flag of channel is on
+ * @param dma channel
+ * @param flag need to check
+ * @return flag status
+ */
+bool DMA_IsFlagOn(DMA_Channel channel, uint8_t flag)
+{
+    assert_param(channel < DMA_Channel_Count);
+    assert_param(IS_DMA_FLAG_PARAM(flag));
+
+    if((DMAx->ISR & ((uint32_t)flag << ISR_CHANNEL_SHIFT(channel))) != 0)
+        return TRUE;
+    else
+        return FALSE;
+}
+
+/**
+ * @brief clear specified flag of channel
+ * @param dma channel
+ * @param flag need to clear
+ */
+void DMA_ClrFlag(DMA_Channel channel, uint8_t flag)
+{
+    assert_param(channel < DMA_Channel_Count);
+    assert_param((flag & ~ISR_CHANNEL_MASK) == 0);
+
+    DMAx->IFCR = ((uint32_t)flag << ISR_CHANNEL_SHIFT(channel));
+}
+
@@ -40,6 +40,8 @@ FLASH_T *FLASH = (FLASH_T *)FLASH_BASE;
 #define CR_PER    (PERIPH_BB_BASE + CR_OFFSET * 32 + 0x01 * 4)
 #define CR_STRT   (PERIPH_BB_BASE + CR_OFFSET * 32 + 0x06 * 4)
 #define CR_LOCK   (PERIPH_BB_BASE + CR_OFFSET * 32 + 0x07 * 4)
+#define CR_ERRIE  (PERIPH_BB_BASE + CR_OFFSET * 32 + 0x0a * 4)
+#define CR_EOPIE  (PERIPH_BB_BASE + CR_OFFSET * 32 + 0x0c * 4)
 
 
 /* key values */
@@ -58,8 +60,12 @@ FLASH_T *FLASH = (FLASH_T *)FLASH_BASE;
  */
 static void FLASH_Unlock(void)
 {
-    FLASH->KEYR = KEY1;
-    FLASH->KEYR = KEY2;
+    /* key sequence on unlocked fpec locks it up until reset */
+    if (*((volatile uint32_t*)CR_LOCK))
+    {
+        FLASH->KEYR = KEY1;
+        FLASH->KEYR = KEY2;
+    }
 }
 
 /**
@@ -156,14 +162,35 @@ bool FLASH_Is_FlagSet(uint8_t flag)
  */
 void FLASH_ClrFlag(uint8_t flag)
 {
-    FLASH->SR &= ~(flag);
+    /* flags are cleared by writing 1 */
+    FLASH->SR = flag;
 }
 
 /**
- * @brief erase flash page
+ * @brief enable or disable flash interrupt
+ * @param it - FLASH_IT_EOP or FLASH_IT_ERR
+ * @param flag - TRUE: enable, FALSE: disable
+ */
+void FLASH_EnableInt(uint32_t it, bool flag)
+{
+    assert_param(IS_FLASH_IT_PARAM(it));
+    if (it & FLASH_IT_EOP)
+    {
+        *((volatile uint32_t*)CR_EOPIE) = flag ? 0x01 : 0x00;
+    }
+
+    if (it & FLASH_IT_ERR)
+    {
+        *((volatile uint32_t*)CR_ERRIE) = flag ? 0x01 : 0x00;
+    }
+}
+
+/**
+ * @brief start erasing flash page, FLASH_FinishErase should be called
+ *        after busy flag is cleared or eop interrupt comes
  * @param addr - erase address
  */
-void FLASH_ErasePage(uint32_t addr)
+void FLASH_StartErasePage(uint32_t addr)
 {
     FLASH_Unlock();
     FLASH_ClrFlag(FLAH_FLAG_EOP | FLAH_FLAG_WRPRTERR | FLAH_FLAG_PGERR);
@@ -171,10 +198,70 @@ void FLASH_ErasePage(uint32_t addr)
     *((volatile uint32_t*)CR_PER) = 0x01;
     FLASH->AR = addr;
     *((volatile uint32_t*)CR_STRT) = 0x01;
+}
+
+/**
+ * @brief finish page erase
+ * @return TRUE if page is erased without error
+ */
+bool FLASH_FinishErase(void)
+{
+    bool ret = FALSE;
+
     while (FLASH->SR & FLAH_FLAG_BSY); 
+    ret = (0 == (FLASH->SR & FLAH_FLAG_WRPRTERR));
     *((volatile uint32_t*)CR_PER) = 0x00;
+    FLASH_ClrFlag(FLAH_FLAG_EOP);
     
     FLASH_Lock();
+    return ret;
+}
+
+/**
+ * @brief erase flash page
+ * @param addr - erase address
+ */
+void FLASH_ErasePage(uint32_t addr)
+{
+    FLASH_StartErasePage(addr);
+    FLASH_FinishErase();
+}
+
+/**
+ * @brief program data in one sequence and read it back, odd tail byte is
+ *        padded with 0xff
+ * @param addr - start address, half word aligned
+ * @param data - data to write, any alignment
+ * @param len - data length
+ * @return TRUE if data is programmed and verified
+ */
+bool FLASH_Program(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    volatile uint16_t *dst = (volatile uint16_t *)addr;
+    uint16_t half = 0;
+    bool ret = TRUE;
+
+    FLASH_Unlock();
+    FLASH_ClrFlag(FLAH_FLAG_EOP | FLAH_FLAG_WRPRTERR | FLAH_FLAG_PGERR);
+    
+    *((volatile uint32_t*)CR_PG) = 0x01;
+    for (uint32_t i = 0; i < len; i += 2)
+    {
+        half = data[i];
+        half |= (i + 1 < len) ? ((uint16_t)data[i + 1] << 8) : 0xff00;
+        *dst++ = half;
+        while (FLASH->SR & FLAH_FLAG_BSY);
+        if (FLASH->SR & (FLAH_FLAG_PGERR | FLAH_FLAG_WRPRTERR))
+        {
+            ret = FALSE;
+            break;
+        }
+    }
+    *((volatile uint32_t*)CR_PG) = 0x00;
+    
+    FLASH_Lock();
+
+    return ret && (0 == memcmp((const void *)addr, data, len));
 }
 /**
  * @brief write data to flash
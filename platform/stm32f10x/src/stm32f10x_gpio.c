@@ -43,6 +43,11 @@ static GPIO_T * const GPIOx[] = {(GPIO_T *)GPIOA_BASE,
 
 static AFIO_T * const AFIO = (AFIO_T *)AFIO_BASE;
 
+/* bit-band alias of peripheral register bit */
+#define PERIPH_BB(addr, bit) ((volatile uint32_t *)(PERIPH_BB_BASE + \
+                              (((uint32_t)(addr) - PERIPH_BASE) << 5) + \
+                              ((bit) << 2)))
+
 
 
 /**
@@ -138,6 +143,35 @@ uint8_t GPIO_ReadPin(GPIO_Group group, uint8_t pin)
     return (GPIOx[group]->IDR >> pin) & 0x01;
 }
 
+/**
+ * @brief get bit-band alias of pin output data, writing alias changes pin 
+ *        output atomically
+ * @param group: port group
+ * @param pin: pin position
+ * @return output bit alias address
+ */
+volatile uint32_t *GPIO_OutputBitBand(GPIO_Group group, uint8_t pin)
+{
+    assert_param(group < GPIO_Count);
+    assert_param(pin < 16);
+    
+    return PERIPH_BB(&GPIOx[group]->ODR, pin);
+}
+
+/**
+ * @brief get bit-band alias of pin input data
+ * @param group: port group
+ * @param pin: pin position
+ * @return input bit alias address
+ */
+volatile uint32_t *GPIO_InputBitBand(GPIO_Group group, uint8_t pin)
+{
+    assert_param(group < GPIO_Count);
+    assert_param(pin < 16);
+    
+    return PERIPH_BB(&GPIOx[group]->IDR, pin);
+}
+
 /**
  * @brief set pin data
  * @param group: port group
@@ -106,14 +106,14 @@ uint8_t IWDG_GetClockPrescaler(void)
         return 0xff;
     }
 
-    return (IWDG->PR & 0x03);
+    return (IWDG->PR & 0x07);
 }
 
 /**
  * @brief set iwdg count reload value
  * @param value: count reload value
  */
-void IWDG_SetReloadValue(uint8_t value)
+void IWDG_SetReloadValue(uint16_t value)
 {
     uint8_t waitCount = 0;
 	volatile uint8_t i = 0;
@@ -298,6 +298,18 @@ void SPI_WriteData(SPI_Group group, uint16_t data)
     SpiX->DR = data;
 }
 
+/**
+ * @brief get data register address for dma transfer
+ * @param spi group
+ * @return data register address
+ */
+uint32_t SPI_DataAddress(SPI_Group group)
+{
+    assert_param(group < SPI_Count);
+    
+    return (uint32_t)&SPIx[group]->DR;
+}
+
 
 /**
  * @brief write and read data to spi port synchronization
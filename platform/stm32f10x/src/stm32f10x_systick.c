@@ -103,3 +103,54 @@ void SYSTICK_SetTickInterval(uint32_t time)
     
     SYSTICK->LOAD = ((tickClock / 1000 * time) & 0xffffff);
 }
+
+/**
+ * @brief set systick reload value, counter wraps every value + 1 clocks
+ * @param reload value
+ */
+void SYSTICK_SetReload(uint32_t value)
+{
+    assert_param(value <= 0xffffff);
+    SYSTICK->LOAD = value;
+}
+
+/**
+ * @brief get systick reload value
+ * @return reload value
+ */
+uint32_t SYSTICK_GetReload(void)
+{
+    return SYSTICK->LOAD;
+}
+
+/**
+ * @brief get systick current value
+ * @return current value
+ */
+uint32_t SYSTICK_GetCounter(void)
+{
+    return SYSTICK->VAL;
+}
+
+/**
+ * @brief clear systick current value, counter reloads at next clock
+ */
+void SYSTICK_ClrCounter(void)
+{
+    SYSTICK->VAL = 0;
+}
+
+/**
+ * @brief stop systick counter, reading control register clears count flag,
+ *        so flag is returned
+ * @return TRUE: counter reached zero since flag was last read
+ */
+bool SYSTICK_StopCounter(void)
+{
+    uint32_t ctrl = SYSTICK->CTRL;
+    SYSTICK->CTRL = ctrl & ~(CTRL_ENABLE | CTRL_COUNTFLAG);
+    /* counter may reach zero between read and write */
+    ctrl |= SYSTICK->CTRL;
+    
+    return (0 != (ctrl & CTRL_COUNTFLAG));
+}
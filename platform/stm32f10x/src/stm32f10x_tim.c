@@ -0,0 +1,335 @@
+/**
+* This file is part of the vendoring machine project.
+*
+* Copyright 2018, Huang Yang <elious.huang@gmail.com>. All rights reserved.
+*
+* See the COPYING file for the terms of usage and distribution.
+*/
+#include "stm32f10x_tim.h"
+#include "stm32f10x_map.h"
+#include "stm32f10x_cfg.h"
+
+/* general purpose timer structure */
+typedef struct 
+{
+    volatile uint16_t CR1;
+    uint16_t RESERVED0;
+    volatile uint16_t CR2;
+    uint16_t RESERVED1;
+    volatile uint16_t SMCR;
+    uint16_t RESERVED2;
+    volatile uint16_t DIER;
+    uint16_t RESERVED3;
+    volatile uint16_t SR;
+    uint16_t RESERVED4;
+    volatile uint16_t EGR;
+    uint16_t RESERVED5;
+    volatile uint16_t CCMR[2];
+    uint16_t RESERVED6[2];
+    volatile uint16_t CCER;
+    uint16_t RESERVED7;
+    volatile uint16_t CNT;
+    uint16_t RESERVED8;
+    volatile uint16_t PSC;
+    uint16_t RESERVED9;
+    volatile uint16_t ARR;
+    uint16_t RESERVED10[3];
+    volatile uint32_t CCR[4];
+    uint32_t RESERVED11;
+    volatile uint16_t DCR;
+    uint16_t RESERVED12;
+    volatile uint16_t DMAR;
+    uint16_t RESERVED13;
+}TIM_T;
+
+/* TIM group array */
+static TIM_T * const TIMx[] = {(TIM_T *)TIM2_BASE, 
+                               (TIM_T *)TIM3_BASE,
+                               (TIM_T *)TIM4_BASE};
+
+/* TIM register bit definition */
+#define CR1_CEN             (1 << 0)
+#define CR1_URS             (1 << 2)
+#define CR1_OPM             (1 << 3)
+#define CR1_DIR             (1 << 4)
+#define CR1_ARPE            (1 << 7)
+
+#define CR2_MMS             (0x07 << 4)
+
+#define EGR_UG              (1 << 0)
+
+#define CCMR_OCM            (0x07 << 4)
+#define CCMR_OCPE           (1 << 3)
+#define CCMR_CCS            (0x03)
+
+#define CCER_CCE            (1 << 0)
+
+/**
+ * @brief enable or disable timer counter
+ * @param timer group
+ * @param enable or disable flag
+ */
+void TIM_Enable(TIM_Group group, bool flag)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    if(flag)
+        TimX->CR1 |= CR1_CEN;
+    else
+        TimX->CR1 &= ~CR1_CEN;
+}
+
+/**
+ * @brief set counter direction
+ * @param timer group
+ * @param counter mode
+ */
+void TIM_SetCounterMode(TIM_Group group, uint16_t mode)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_COUNTER_PARAM(mode));
+    TIM_T * const TimX = TIMx[group];
+    
+    TimX->CR1 &= ~CR1_DIR;
+    TimX->CR1 |= mode;
+}
+
+/**
+ * @brief set counter clock prescaler, counter clock is fCK_PSC/(prescaler+1)
+ * @note prescaler is loaded at next update event
+ * @param timer group
+ * @param prescaler value
+ */
+void TIM_SetPrescaler(TIM_Group group, uint16_t prescaler)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    TimX->PSC = prescaler;
+}
+
+/**
+ * @brief set auto reload value
+ * @param timer group
+ * @param auto reload value
+ */
+void TIM_SetAutoReload(TIM_Group group, uint16_t value)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    TimX->ARR = value;
+}
+
+/**
+ * @brief enable or disable auto reload preload
+ * @param timer group
+ * @param enable or disable flag
+ */
+void TIM_EnableAutoReloadPreload(TIM_Group group, bool flag)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    if(flag)
+        TimX->CR1 |= CR1_ARPE;
+    else
+        TimX->CR1 &= ~CR1_ARPE;
+}
+
+/**
+ * @brief set counter value
+ * @param timer group
+ * @param counter value
+ */
+void TIM_SetCounter(TIM_Group group, uint16_t value)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    TimX->CNT = value;
+}
+
+/**
+ * @brief get counter value
+ * @param timer group
+ * @return counter value
+ */
+uint16_t TIM_GetCounter(TIM_Group group)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    return TimX->CNT;
+}
+
+/**
+ * @brief enable or disable one pulse mode, counter stops at next update
+ *        event in one pulse mode
+ * @param timer group
+ * @param enable or disable flag
+ */
+void TIM_EnableOnePulse(TIM_Group group, bool flag)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    if(flag)
+        TimX->CR1 |= CR1_OPM;
+    else
+        TimX->CR1 &= ~CR1_OPM;
+}
+
+/**
+ * @brief only counter overflow generates update interrupt, update generated
+ *        by software does not set update flag
+ * @param timer group
+ * @param enable or disable flag
+ */
+void TIM_EnableUpdateOnlyOverflow(TIM_Group group, bool flag)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    if(flag)
+        TimX->CR1 |= CR1_URS;
+    else
+        TimX->CR1 &= ~CR1_URS;
+}
+
+/**
+ * @brief generate update event, reload prescaler and counter
+ * @param timer group
+ */
+void TIM_GenerateUpdate(TIM_Group group)
+{
+    assert_param(group < TIM_Count);
+    TIM_T * const TimX = TIMx[group];
+    
+    TimX->EGR = EGR_UG;
+}
+
+/**
+ * @brief set master mode, select trigger output source
+ * @param timer group
+ * @param master mode
+ */
+void TIM_SetMasterMode(TIM_Group group, uint16_t mode)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_TRGO_PARAM(mode));
+    TIM_T * const TimX = TIMx[group];
+    
+    TimX->CR2 &= ~CR2_MMS;
+    TimX->CR2 |= mode;
+}
+
+/**
+ * @brief set channel output compare mode
+ * @param timer group
+ * @param timer channel
+ * @param output compare mode
+ * @param compare value preload flag
+ */
+void TIM_SetOutputCompareMode(TIM_Group group, uint8_t channel, 
+                              uint8_t mode, bool preload)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_CHANNEL_PARAM(channel));
+    assert_param(IS_TIM_OC_PARAM(mode));
+    TIM_T * const TimX = TIMx[group];
+    
+    uint8_t offset = ((channel & 0x01) << 3);
+    uint16_t ccmr = TimX->CCMR[channel >> 1];
+    ccmr &= ~((CCMR_OCM | CCMR_OCPE | CCMR_CCS) << offset);
+    ccmr |= (((uint16_t)mode << 4) << offset);
+    if(preload)
+        ccmr |= (CCMR_OCPE << offset);
+    TimX->CCMR[channel >> 1] = ccmr;
+}
+
+/**
+ * @brief enable or disable channel output
+ * @param timer group
+ * @param timer channel
+ * @param enable or disable flag
+ */
+void TIM_EnableChannel(TIM_Group group, uint8_t channel, bool flag)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_CHANNEL_PARAM(channel));
+    TIM_T * const TimX = TIMx[group];
+    
+    if(flag)
+        TimX->CCER |= (CCER_CCE << (channel << 2));
+    else
+        TimX->CCER &= ~(CCER_CCE << (channel << 2));
+}
+
+/**
+ * @brief set channel compare value
+ * @param timer group
+ * @param timer channel
+ * @param compare value
+ */
+void TIM_SetCompare(TIM_Group group, uint8_t channel, uint16_t value)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_CHANNEL_PARAM(channel));
+    TIM_T * const TimX = TIMx[group];
+    
+    TimX->CCR[channel] = value;
+}
+
+/**
+ * @brief enable or disable timer interrupt
+ * @param timer group
+ * @param interrupt flag
+ * @param enable or disable flag
+ */
+void TIM_EnableInt(TIM_Group group, uint16_t intFlag, bool flag)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_IT_PARAM(intFlag));
+    TIM_T * const TimX = TIMx[group];
+    
+    if(flag)
+        TimX->DIER |= intFlag;
+    else
+        TimX->DIER &= ~intFlag;
+}
+
+/**
+ * @brief check if specified flag is on
+ * @param timer group
+ * @param flag need to check
+ * @return flag status
+ */
+bool TIM_IsFlagOn(TIM_Group group, uint16_t flag)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_FLAG_PARAM(flag));
+    TIM_T * const TimX = TIMx[group];
+    
+    if((TimX->SR & flag) != 0)
+        return TRUE;
+    else
+        return FALSE;
+}
+
+/**
+ * @brief clear specified flag
+ * @param timer group
+ * @param flag need to clear
+ */
+void TIM_ClrFlag(TIM_Group group, uint16_t flag)
+{
+    assert_param(group < TIM_Count);
+    assert_param(IS_TIM_FLAG_PARAM(flag));
+    TIM_T * const TimX = TIMx[group];
+    
+    /* status bits are cleared by writing 0, writing 1 has no effect */
+    TimX->SR = ~flag;
+}
+